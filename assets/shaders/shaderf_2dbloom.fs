@@ -5,12 +5,21 @@ in vec2 TexCoords;
 out vec4 FragColor;
 
 uniform float intensity = 1.0;
+uniform float radius = 1.0;     // Of the tent filter that upsamples the bloom, in its texels
 uniform sampler2D sceneRaw;
-uniform sampler2D sceneBloom;
+uniform sampler2D sceneBloom;   // Top of the bloom mip chain, at half resolution
 
 void main() {
+    // Tent-filtered, as every level below it was
+    vec2 texel = radius / vec2(textureSize(sceneBloom, 0));
+    vec3 bloomColor = texture(sceneBloom, TexCoords).rgb * 4.0;
+    bloomColor += (texture(sceneBloom, TexCoords + texel * vec2(-1, 0)).rgb + texture(sceneBloom, TexCoords + texel * vec2(1, 0)).rgb) * 2.0;
+    bloomColor += (texture(sceneBloom, TexCoords + texel * vec2(0, -1)).rgb + texture(sceneBloom, TexCoords + texel * vec2(0, 1)).rgb) * 2.0;
+    bloomColor += texture(sceneBloom, TexCoords + texel * vec2(-1, -1)).rgb + texture(sceneBloom, TexCoords + texel * vec2(1, -1)).rgb;
+    bloomColor += texture(sceneBloom, TexCoords + texel * vec2(-1, 1)).rgb + texture(sceneBloom, TexCoords + texel * vec2(1, 1)).rgb;
+    bloomColor /= 16.0;
+
     // Additively blend HDR and bloom color values
     vec3 rawColor = texture(sceneRaw, TexCoords).rgb;
-    vec3 bloomColor = texture(sceneBloom, TexCoords).rgb;
     FragColor = vec4(rawColor + intensity*bloomColor, 1);
 }
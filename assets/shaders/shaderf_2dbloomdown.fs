@@ -0,0 +1,68 @@
+#version 410 core
+
+// shaderf_2dbloomdown.fs
+// Bloom downsample to half the source's size: 13 taps, weighted as five overlapping 2x2 box filters (Jimenez, "Next Generation
+// Post Processing in Call of Duty: Advanced Warfare"). The first level, from the scene, also applies the soft threshold and
+// weights each box by its inverse luminance, so single bright pixels do not flicker.
+
+in vec2 TexCoords;
+out vec4 FragColor;
+
+uniform sampler2D source;
+uniform bool prefilter = false;
+uniform float threshold = 1.0;  // Brightness where bloom reaches full strength
+uniform float knee = 0.5;       // Width of the curve that eases in below it
+
+float Luminance(vec3 c) {
+    return dot(c, vec3(0.2126, 0.7152, 0.0722));
+}
+
+vec3 SoftThreshold(vec3 c) {
+    float brightness = max(c.r, max(c.g, c.b));
+    float k = max(knee, 1e-5);
+    float soft = clamp(brightness - threshold + k, 0.0, 2.0 * k);
+    soft = soft * soft / (4.0 * k);
+    return c * max(soft, brightness - threshold) / max(brightness, 1e-4);
+}
+
+void main() {
+    vec2 texel = 1.0 / vec2(textureSize(source, 0));
+    vec3 a = texture(source, TexCoords + texel * vec2(-2,  2)).rgb;
+    vec3 b = texture(source, TexCoords + texel * vec2( 0,  2)).rgb;
+    vec3 c = texture(source, TexCoords + texel * vec2( 2,  2)).rgb;
+    vec3 d = texture(source, TexCoords + texel * vec2(-2,  0)).rgb;
+    vec3 e = texture(source, TexCoords).rgb;
+    vec3 f = texture(source, TexCoords + texel * vec2( 2,  0)).rgb;
+    vec3 g = texture(source, TexCoords + texel * vec2(-2, -2)).rgb;
+    vec3 h = texture(source, TexCoords + texel * vec2( 0, -2)).rgb;
+    vec3 i = texture(source, TexCoords + texel * vec2( 2, -2)).rgb;
+    vec3 j = texture(source, TexCoords + texel * vec2(-1,  1)).rgb;
+    vec3 k = texture(source, TexCoords + texel * vec2( 1,  1)).rgb;
+    vec3 l = texture(source, TexCoords + texel * vec2(-1, -1)).rgb;
+    vec3 m = texture(source, TexCoords + texel * vec2( 1, -1)).rgb;
+
+    // The center box counts for half, the four corner boxes for an eighth each
+    vec3 boxes[5] = vec3[](
+        (j + k + l + m) * 0.25,
+        (a + b + d + e) * 0.25,
+        (b + c + e + f) * 0.25,
+        (d + e + g + h) * 0.25,
+        (e + f + h + i) * 0.25
+    );
+    float weights[5] = float[](0.5, 0.125, 0.125, 0.125, 0.125);
+
+    vec3 result = vec3(0);
+    if (prefilter) {
+        float total = 0.0;
+        for (int n = 0; n < 5; n++) {
+            float w = weights[n] / (1.0 + Luminance(boxes[n]));
+            result += boxes[n] * w;
+            total += w;
+        }
+        result = SoftThreshold(result / total);
+    } else {
+        for (int n = 0; n < 5; n++)
+            result += boxes[n] * weights[n];
+    }
+    FragColor = vec4(result, 1);
+}
\ No newline at end of file
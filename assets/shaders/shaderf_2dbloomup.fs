@@ -0,0 +1,24 @@
+#version 410 core
+
+// shaderf_2dbloomup.fs
+// Bloom upsample: a 3x3 tent filter over the level below, drawn with additive blending onto the level above
+
+in vec2 TexCoords;
+out vec4 FragColor;
+
+uniform sampler2D source;
+uniform float radius = 1.0;     // In source texels
+
+void main() {
+    vec2 texel = radius / vec2(textureSize(source, 0));
+    vec3 result = texture(source, TexCoords).rgb * 4.0;
+    result += texture(source, TexCoords + texel * vec2(-1,  0)).rgb * 2.0;
+    result += texture(source, TexCoords + texel * vec2( 1,  0)).rgb * 2.0;
+    result += texture(source, TexCoords + texel * vec2( 0, -1)).rgb * 2.0;
+    result += texture(source, TexCoords + texel * vec2( 0,  1)).rgb * 2.0;
+    result += texture(source, TexCoords + texel * vec2(-1, -1)).rgb;
+    result += texture(source, TexCoords + texel * vec2( 1, -1)).rgb;
+    result += texture(source, TexCoords + texel * vec2(-1,  1)).rgb;
+    result += texture(source, TexCoords + texel * vec2( 1,  1)).rgb;
+    FragColor = vec4(result / 16.0, 1);
+}
\ No newline at end of file
@@ -11,6 +11,15 @@ float rgb2luma(vec3 rgb) {
     return sqrt(dot(rgb, vec3(0.299, 0.587, 0.114)));
 }
 
+// With LUMA_IN_ALPHA defined, the pass before stored rgb2luma() in alpha
+float Luma(vec4 color) {
+#ifdef LUMA_IN_ALPHA
+    return color.a;
+#else
+    return rgb2luma(color.rgb);
+#endif
+}
+
 float QUALITY(int i) {
     float values[7] = float[](1.5, 2.0, 2.0, 2.0, 2.0, 4.0, 8.0);
     if (i <= 6) {
@@ -23,13 +32,14 @@ float QUALITY(int i) {
 vec4 fxaa(float EDGE_THRESHOLD_MIN, float EDGE_THRESHOLD_MAX, float SUBPIXEL_QUALITY, int ITERATIONS) {
     vec2 texelStep = 1.0 / textureSize(screenTexture, 0);
 
-    vec3 colorCenter = texture(screenTexture, TexCoords).rgb;
-    float lumaCenter = rgb2luma(colorCenter);
+    vec4 center = texture(screenTexture, TexCoords);
+    vec3 colorCenter = center.rgb;
+    float lumaCenter = Luma(center);
 
-    float lumaDown  = rgb2luma( textureOffset(screenTexture, TexCoords, ivec2(0,-1)).rgb );
-    float lumaUp    = rgb2luma( textureOffset(screenTexture, TexCoords, ivec2(0, 1)).rgb );
-    float lumaLeft  = rgb2luma( textureOffset(screenTexture, TexCoords, ivec2(-1,0)).rgb );
-    float lumaRight = rgb2luma( textureOffset(screenTexture, TexCoords, ivec2(1, 0)).rgb );
+    float lumaDown  = Luma(textureOffset(screenTexture, TexCoords, ivec2(0,-1)));
+    float lumaUp    = Luma(textureOffset(screenTexture, TexCoords, ivec2(0, 1)));
+    float lumaLeft  = Luma(textureOffset(screenTexture, TexCoords, ivec2(-1,0)));
+    float lumaRight = Luma(textureOffset(screenTexture, TexCoords, ivec2(1, 0)));
 
     // (1) Determine whether to perform AA on this pixel
     float lumaMin = min( lumaCenter, min( min(lumaDown,lumaUp),min(lumaLeft,lumaRight) ) );
@@ -42,10 +52,10 @@ vec4 fxaa(float EDGE_THRESHOLD_MIN, float EDGE_THRESHOLD_MAX, float SUBPIXEL_QUA
     }
 
     // (2) Determine edge orientation
-    float lumaDownLeft  = rgb2luma( textureOffset(screenTexture, TexCoords, ivec2(-1,-1)).rgb );
-    float lumaDownRight = rgb2luma( textureOffset(screenTexture, TexCoords, ivec2( 1,-1)).rgb );
-    float lumaUpLeft    = rgb2luma( textureOffset(screenTexture, TexCoords, ivec2(-1, 1)).rgb );
-    float lumaUpRight   = rgb2luma( textureOffset(screenTexture, TexCoords, ivec2( 1, 1)).rgb );
+    float lumaDownLeft  = Luma(textureOffset(screenTexture, TexCoords, ivec2(-1,-1)));
+    float lumaDownRight = Luma(textureOffset(screenTexture, TexCoords, ivec2( 1,-1)));
+    float lumaUpLeft    = Luma(textureOffset(screenTexture, TexCoords, ivec2(-1, 1)));
+    float lumaUpRight   = Luma(textureOffset(screenTexture, TexCoords, ivec2( 1, 1)));
 
     float edgeHorizontal = abs((lumaUpLeft-lumaLeft)-(lumaLeft-lumaDownLeft)) + 2*abs((lumaUp-lumaCenter)-(lumaCenter-lumaDown)) + abs((lumaUpRight-lumaRight)-(lumaRight-lumaDownRight));  // Basically how different the rows of pixels are 
     float edgeVertical   = abs((lumaUpLeft-lumaUp)-(lumaUp-lumaUpRight)) + 2*abs((lumaLeft-lumaCenter)-(lumaCenter-lumaRight)) + abs((lumaDownLeft-lumaDown)-(lumaDown-lumaDownRight));  // Basically how different the columns of pixels are
@@ -86,8 +96,8 @@ vec4 fxaa(float EDGE_THRESHOLD_MIN, float EDGE_THRESHOLD_MAX, float SUBPIXEL_QUA
     vec2 uv1 = currentUv - offset;
     vec2 uv2 = currentUv + offset;
 
-    float lumaEnd1 = rgb2luma( texture(screenTexture, uv1).rgb );
-    float lumaEnd2 = rgb2luma( texture(screenTexture, uv2).rgb );
+    float lumaEnd1 = Luma(texture(screenTexture, uv1));
+    float lumaEnd2 = Luma(texture(screenTexture, uv2));
     lumaEnd1 -= lumaLocalAverage;   // Delta luma 1
     lumaEnd2 -= lumaLocalAverage;   // Delta luma 2
 
@@ -106,11 +116,11 @@ vec4 fxaa(float EDGE_THRESHOLD_MIN, float EDGE_THRESHOLD_MAX, float SUBPIXEL_QUA
     if (!reachedBoth) {
         for (int i = 1; i < ITERATIONS; i++) {  // why not i = 1 to start
             if (!reached1) {
-                lumaEnd1 = rgb2luma( texture(screenTexture, uv1).rgb );
+                lumaEnd1 = Luma(texture(screenTexture, uv1));
                 lumaEnd1 -= lumaLocalAverage;   // Delta luma 1
             }
             if (!reached2) {
-                lumaEnd2 = rgb2luma( texture(screenTexture, uv2).rgb );
+                lumaEnd2 = Luma(texture(screenTexture, uv2));
                 lumaEnd2 -= lumaLocalAverage;   // Delta luma 2
             }
 
@@ -167,5 +177,5 @@ void main() {
     float SUBPIXEL_QUALITY = 0.75;
     int ITERATIONS = 12;
 
-    FragColor = fxaa(EDGE_THRESHOLD_MIN, EDGE_THRESHOLD_MAX, SUBPIXEL_QUALITY, ITERATIONS);
+    FragColor = vec4(fxaa(EDGE_THRESHOLD_MIN, EDGE_THRESHOLD_MAX, SUBPIXEL_QUALITY, ITERATIONS).rgb, 1);
 }
\ No newline at end of file
@@ -0,0 +1,50 @@
+#version 410 core
+
+// shaderf_2dpost.fs
+// Fused post-processing composite: whichever of bloom, exposure tone mapping and FXAA's luma that PostProcessing::Chain
+// enabled, as BLOOM, TONEMAP and LUMA_IN_ALPHA, in one full-screen pass
+
+in vec2 TexCoords;
+out vec4 FragColor;
+
+uniform sampler2D scene;
+
+#ifdef BLOOM
+uniform sampler2D bloom;        // Top of the bloom mip chain, at half resolution
+uniform float bloomIntensity = 1.0;
+uniform float bloomRadius = 1.0;
+
+// 3x3 tent, as the bloom upsample
+vec3 Bloom() {
+    vec2 texel = bloomRadius / vec2(textureSize(bloom, 0));
+    vec3 result = texture(bloom, TexCoords).rgb * 4.0;
+    result += (texture(bloom, TexCoords + texel * vec2(-1, 0)).rgb + texture(bloom, TexCoords + texel * vec2(1, 0)).rgb) * 2.0;
+    result += (texture(bloom, TexCoords + texel * vec2(0, -1)).rgb + texture(bloom, TexCoords + texel * vec2(0, 1)).rgb) * 2.0;
+    result += texture(bloom, TexCoords + texel * vec2(-1, -1)).rgb + texture(bloom, TexCoords + texel * vec2(1, -1)).rgb;
+    result += texture(bloom, TexCoords + texel * vec2(-1, 1)).rgb + texture(bloom, TexCoords + texel * vec2(1, 1)).rgb;
+    return result / 16.0;
+}
+#endif
+
+#ifdef TONEMAP
+uniform float exposure = 1.0;
+const float GAMMA = 2.2;
+#endif
+
+void main() {
+    vec3 color = texture(scene, TexCoords).rgb;
+#ifdef BLOOM
+    color += bloomIntensity * Bloom();
+#endif
+#ifdef TONEMAP
+    // Exposure tone mapping, then gamma correction
+    color = vec3(1) - exp(-color * exposure);
+    color = pow(color, vec3(1.0/GAMMA));
+#endif
+#ifdef LUMA_IN_ALPHA
+    // As FXAA's rgb2luma(), so it reads one channel instead of recomputing it per tap
+    FragColor = vec4(color, sqrt(dot(color, vec3(0.299, 0.587, 0.114))));
+#else
+    FragColor = vec4(color, 1);
+#endif
+}
\ No newline at end of file
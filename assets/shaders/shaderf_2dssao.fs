@@ -3,23 +3,41 @@
 in vec2 TexCoords;
 out float FragColor;
 
-uniform sampler2D gPosition;
-uniform sampler2D gNormal;
-uniform sampler2D noiseTexture; // 16 random vectors on the TB plane
+uniform sampler2D gDepth;
+uniform sampler2D gNormal;      // Octahedral
+uniform sampler2D noiseTexture; // 16 random vectors on the TB plane, tiled over the output's pixels
 
-uniform vec3 samples[64];   // 64 random vectors in the N-facing hemisphere
+// Defined by Renderer::SsaoModule: 8, 16, 32 or 64
+#ifndef KERNEL_SIZE
+#define KERNEL_SIZE 64
+#endif
+layout (std140) uniform SsaoKernel {
+    vec4 samples[KERNEL_SIZE];  // Random vectors in the N-facing hemisphere
+};
 uniform mat4 projection;
+uniform mat4 inv_projection;
 
-const vec2 noiseScale = vec2(1920./4., 1080./4.);
-
-const int KERNEL_SIZE = 64;
 const float RADIUS = 0.5;
 
+vec3 ViewPosFromDepth(vec2 uv) {
+    vec4 clip = vec4(vec3(uv, texture(gDepth, uv).r) * 2.0 - 1.0, 1.0);
+    vec4 view = inv_projection * clip;
+    return view.xyz / view.w;
+}
+
+vec3 OctDecode(vec2 e) {
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
 void main() {
     // Process G-buffer
-    vec4 FragPos = texture(gPosition, TexCoords);
-    vec3 Normal = texture(gNormal, TexCoords).rgb;
-    vec3 RandomVec = texture(noiseTexture, TexCoords * noiseScale).xyz;
+    vec4 FragPos = vec4(ViewPosFromDepth(TexCoords), 1.0);
+    vec3 Normal = OctDecode(texture(gNormal, TexCoords).rg);
+    vec3 RandomVec = texture(noiseTexture, gl_FragCoord.xy / 4.0).xyz;
     
     // Compute TBN matrix
     vec3 T = normalize(RandomVec - dot(RandomVec, Normal) * Normal);    // T = component of RandomVec that is orthogonal to Normal
@@ -31,7 +49,7 @@ void main() {
     for (int i = 0; i < KERNEL_SIZE; i++) {
         // Viewspace sample vector
         // - sample some position in the normal-facing hemisphere of the current fragment
-        vec3 samplePos = TBN * samples[i];
+        vec3 samplePos = TBN * samples[i].xyz;
         samplePos = FragPos.xyz + samplePos * RADIUS;
         // Clip space position of sample
         vec4 offset = projection * vec4(samplePos, 1.0);
@@ -39,7 +57,7 @@ void main() {
         offset.xyz = offset.xyz * 0.5 + 0.5; // Map to [0,1]
         // Occlude fragment if sample is behind its corresponding G-buffer point
         // - compare z-coordinates, not depth values!
-        float actualZ = texture(gPosition, offset.xy).z;
+        float actualZ = ViewPosFromDepth(offset.xy).z;
         float rangeCheck = smoothstep(0.0, 1.0, RADIUS / abs(FragPos.z - actualZ)); // Only apply occlusion if fragment and G-buffer point sampled are within RADIUS of each other 
         float bias = 0.001;
         if (actualZ >= samplePos.z + bias)
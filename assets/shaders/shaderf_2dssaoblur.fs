@@ -1,21 +1,34 @@
 #version 410 core
 
+// shaderf_2dssaoblur.fs
+// Depth-aware blur of the SSAO buffer, drawn at G-buffer resolution so it also upsamples
+
 in vec2 TexCoords;
 out float FragColor;
 
 uniform sampler2D ssaoInput;
+uniform sampler2D gDepth;
+uniform mat4 inv_projection;
+
+float ViewDepth(vec2 uv) {
+    vec4 clip = vec4(vec3(uv, texture(gDepth, uv).r) * 2.0 - 1.0, 1.0);
+    vec4 view = inv_projection * clip;
+    return view.z / view.w;
+}
 
 void main() {
     vec2 texelStep = 1.0 / vec2(textureSize(ssaoInput, 0));
-    // Assuming 4x4 noise texture buffer (16 pixels)
+    float centerDepth = ViewDepth(TexCoords);
+    // 4x4 taps to cancel the 4x4 noise tile, weighted down across depth edges so occlusion does not bleed between surfaces
     float result = 0;
-    float samples_x = 4;  // Match noise texture size
-    float samples_y = 4;  // Match noise texture size
-    for (float x = -(samples_x-1)/2; x <= (samples_x-1)/2; x++) {
-        for (float y = -(samples_y-1)/2; y <= (samples_y-1)/2; y++) {
-            vec2 offset = vec2(x,y) * texelStep;
-            result += texture(ssaoInput, TexCoords + offset).r;
+    float totalWeight = 0;
+    for (float x = -1.5; x <= 1.5; x++) {
+        for (float y = -1.5; y <= 1.5; y++) {
+            vec2 uv = TexCoords + vec2(x,y) * texelStep;
+            float weight = 1.0 / (0.01 + abs(ViewDepth(uv) - centerDepth) / abs(centerDepth));
+            result += weight * texture(ssaoInput, uv).r;
+            totalWeight += weight;
         }
     }
-    FragColor = result / (samples_x * samples_y);
+    FragColor = result / totalWeight;
 }
\ No newline at end of file
@@ -6,10 +6,10 @@
 // Output space: Viewspace
 
 // OUTPUTS
-layout (location = 0) out vec4 gPosition;   // GL_COLOR_ATTACHMENT0 from glDrawBuffers
-layout (location = 1) out vec3 gNormal;     // GL_COLOR_ATTACHMENT1 from glDrawBuffers
-layout (location = 2) out vec4 gAlbedoSpec; // GL_COLOR_ATTACHMENT2 from glDrawBuffers
-layout (location = 3) out vec4 gMetRouOcc;     // GL_COLOR_ATTACHMENT3
+// Position is not stored; readers rebuild it from the depth buffer
+layout (location = 0) out vec2 gNormal;     // GL_COLOR_ATTACHMENT0, octahedral encoding in [0,1] (RG16)
+layout (location = 1) out vec4 gAlbedo;     // GL_COLOR_ATTACHMENT1, linear color written to an sRGB target
+layout (location = 2) out vec4 gMetRouOcc;  // GL_COLOR_ATTACHMENT2
 
 // INPUTS
 in VS_OUT {
@@ -18,6 +18,7 @@ in VS_OUT {
     vec2 TexCoords;
     mat3 TBN;
 } fs_in;
+flat in int MaterialIndex;
 
 // MATERIAL
 uniform struct Material_PBRMetallic {
@@ -28,49 +29,56 @@ uniform struct Material_PBRMetallic {
     sampler2D texture_normal;
     sampler2D texture_height;
     sampler2D texture_occlusion;
-    bool has_texture_albedo;
-    bool has_texture_metallic;
-    bool has_texture_roughness;
-    bool has_texture_normal;
-    bool has_texture_height;
-    bool has_texture_occlusion;
-    // Raw
-    vec3 albedo;
-    float metallic;
-    float roughness;
-
 } material;
+uniform samplerBuffer materialData;    // Per material, see Material::MaterialRecord
+
+// Material::TextureFlags
+const int HAS_ALBEDO = 1;
+const int HAS_METALLIC = 2;
+const int HAS_ROUGHNESS = 4;
+const int HAS_NORMAL = 8;
+const int HAS_HEIGHT = 16;
+const int HAS_OCCLUSION = 32;
+
+vec2 OctEncode(vec3 n);
 
 // ============== MAIN ==============
 void main() {
-    gPosition = fs_in.FragPos;
+    vec4 albedoMetallic = texelFetch(materialData, 2 * MaterialIndex);
+    vec4 roughnessFlags = texelFetch(materialData, 2 * MaterialIndex + 1);
+    vec3 material_albedo = albedoMetallic.rgb;
+    float material_metallic = albedoMetallic.a;
+    float material_roughness = roughnessFlags.r;
+    int flags = int(roughnessFlags.g);
 
-    if (material.has_texture_normal) {
-        gNormal = texture(material.texture_normal, fs_in.TexCoords).rgb;
-        gNormal = gNormal * 2.0 - 1.0;
-        gNormal = normalize(fs_in.TBN * gNormal);
+    vec3 normal;
+    if ((flags & HAS_NORMAL) != 0) {
+        normal = texture(material.texture_normal, fs_in.TexCoords).rgb;
+        normal = normal * 2.0 - 1.0;
+        normal = normalize(fs_in.TBN * normal);
     } else {
-        gNormal = normalize(fs_in.Normal);
+        normal = normalize(fs_in.Normal);
     }
+    gNormal = OctEncode(normal);
 
-    gAlbedoSpec.rgb = material.albedo;
-    if (material.has_texture_albedo) {
-        gAlbedoSpec.rgb += texture(material.texture_albedo, fs_in.TexCoords).rgb;
+    gAlbedo = vec4(material_albedo, 1.0);
+    if ((flags & HAS_ALBEDO) != 0) {
+        gAlbedo.rgb += texture(material.texture_albedo, fs_in.TexCoords).rgb;
     }
 
-    if (material.has_texture_metallic) {
+    if ((flags & HAS_METALLIC) != 0) {
         gMetRouOcc.r = texture(material.texture_metallic, fs_in.TexCoords).b;   // .gltf
     } else {
-        gMetRouOcc.r = material.metallic;
+        gMetRouOcc.r = material_metallic;
     }
 
-    if (material.has_texture_roughness) {
+    if ((flags & HAS_ROUGHNESS) != 0) {
         gMetRouOcc.g = texture(material.texture_roughness, fs_in.TexCoords).g;  // .gltf
     } else {
-        gMetRouOcc.g = material.roughness;
+        gMetRouOcc.g = material_roughness;
     }
 
-    if (material.has_texture_occlusion) {
+    if ((flags & HAS_OCCLUSION) != 0) {
         gMetRouOcc.b = 1.0; // aka, use occlusion texture
         gMetRouOcc.a = texture(material.texture_occlusion, fs_in.TexCoords).r;  // .gltf
     } else {
@@ -80,6 +88,15 @@ void main() {
 }
 // ==================================
 
+// Unit vector to a point of the octahedron unfolded onto a square, mapped to [0,1]
+vec2 OctEncode(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 e = n.xy;
+    if (n.z < 0.0)
+        e = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return e * 0.5 + 0.5;
+}
+
 // To be implemented in lighting pass
     // // Other properties
     // float shininess;
@@ -19,9 +19,11 @@ layout (std140) uniform Camera {  // this is 2 * sizeof(glm::mat4)
     vec3 cam_front;
 };
 struct DirLight_t {
-    vec4 color;
-    vec4 direction; // dir_view.x, dir_view.y, dir_view.z, shadowmap_index
-    mat4 matrix;    
+    vec4 color;             // color.r, color.g, color.b, cascade_count (0 without shadows)
+    vec4 direction;         // dir_view.x, dir_view.y, dir_view.z, unused
+    vec4 cascade_splits;    // View-space distance where each cascade ends
+    mat4 matrices[4];       // Per cascade
+    vec4 tiles[4];          // Per cascade, shadowAtlas tile: offset.x, offset.y, scale, unused
 };
 layout (std140) uniform DirLight {
     float dirlight_count;
@@ -31,22 +33,32 @@ struct PointLight_t {
     vec4 color;
     vec4 attenuation;       // constant, linear, quadratic, radius
     vec4 position;          // pos.x, pos.y, pos.z, shadowmap_cube_farplane
-    vec4 position_world;    // pos_world.x, pos_world.y, pos_world.z, shadowmap_index
+    vec4 position_world;    // pos_world.x, pos_world.y, pos_world.z, shadowAtlas tile scale (0 without shadows)
+    vec4 tiles[3];          // shadowAtlas tile offsets of the cube faces, two per texel, ordered as PointLight::LightspaceMatrices()
 };
 layout (std140) uniform PointLight {
     float pointlight_count;
-    PointLight_t pointlights[32];
 };
 
+// CLUSTERED POINT LIGHTS
+uniform samplerBuffer pointlightData;       // 7 texels per light, laid out as PointLight_t
+uniform usamplerBuffer clusterGrid;         // offset, count into clusterLightIndices
+uniform usamplerBuffer clusterLightIndices;
+uniform int clusterTilesX;
+uniform int clusterTilesY;
+uniform int clusterSlices;
+uniform float clusterDepthScale;
+uniform float clusterDepthBias;
+
 // G-BUFFER
-uniform sampler2D gPosition;
-uniform sampler2D gNormal;
-uniform sampler2D gAlbedoSpec;
+uniform sampler2D gDepth;
+uniform sampler2D gNormal;      // Octahedral
+uniform sampler2D gAlbedo;
 uniform sampler2D gMetRouOcc;
+uniform mat4 inv_projection;
 
 // SHADOW MAPPING
-uniform sampler2DArrayShadow shadowmap_2d_array_shadow;
-uniform samplerCubeArrayShadow shadowmap_cube_array_shadow;
+uniform sampler2DShadow shadowAtlas;     // Every cascade and cube face, each in its own tile
 
 // SSAO
 uniform bool ssao = false;
@@ -63,7 +75,12 @@ vec3 CalcDirLightPBR(vec4 pos, vec3 normal, vec3 albedo, float metallic, float r
 vec3 CalcPointLightPBR(vec4 pos, vec3 normal, vec3 albedo, float metallic, float roughness, vec3 viewDir, float occlusion);
 vec3 CalcIBL(vec3 normal, vec3 albedo, float metallic, float roughness, vec3 viewdir, float occlusion);
 float CalcShadow2D(int lightIndex, vec3 normal, vec4 fragPos);
-float CalcShadowCube(int lightIndex, vec4 fragPos);
+float CalcShadowCube(PointLight_t light, vec4 fragPos);
+PointLight_t FetchPointLight(int lightIndex);
+int CubeFace(vec3 dir);
+vec2 CubeFaceUV(vec3 dir, int face);
+vec3 ViewPosFromDepth(vec2 uv);
+vec3 OctDecode(vec2 e);
 
 float DistributionGGX(vec3 N, vec3 H, float roughness);
 vec3 FresnelSchlick(vec3 H, vec3 V, vec3 F0);
@@ -79,16 +96,19 @@ vec3 sampleOffsetDirections[20] = vec3[]
    vec3( 0,  1,  1), vec3( 0, -1,  1), vec3( 0, -1, -1), vec3( 0,  1, -1)
 );   
 
+// Forward and lookAt up vector of each cube face, as PointLight::LightspaceMatrices() renders them
+const vec3 cubeFaceFront[6] = vec3[](vec3(1,0,0), vec3(-1,0,0), vec3(0,1,0), vec3(0,-1,0), vec3(0,0,1), vec3(0,0,-1));
+const vec3 cubeFaceUp[6] = vec3[](vec3(0,-1,0), vec3(0,-1,0), vec3(0,0,1), vec3(0,0,-1), vec3(0,-1,0), vec3(0,-1,0));
+
 // const float AMBIENT_FACTOR = 1e-3;
 const float PI = 3.14159265359;
 
 // ============== MAIN ==============
 void main() {
     // Process G-buffer
-    vec4 FragPos = texture(gPosition, TexCoords);
-    vec3 Normal = texture(gNormal, TexCoords).rgb;
-    vec3 Albedo = texture(gAlbedoSpec, TexCoords).rgb;
-    float Specular = texture(gAlbedoSpec, TexCoords).a;
+    vec4 FragPos = vec4(ViewPosFromDepth(TexCoords), 1.0);
+    vec3 Normal = OctDecode(texture(gNormal, TexCoords).rg);
+    vec3 Albedo = texture(gAlbedo, TexCoords).rgb;
     
     vec4 MetRouOcc = texture(gMetRouOcc, TexCoords);
     float Metallic = MetRouOcc.r;
@@ -111,6 +131,20 @@ void main() {
 // ==================================
 
 // FUNCTION DEFINITIONS
+vec3 ViewPosFromDepth(vec2 uv) {
+    vec4 clip = vec4(vec3(uv, texture(gDepth, uv).r) * 2.0 - 1.0, 1.0);
+    vec4 view = inv_projection * clip;
+    return view.xyz / view.w;
+}
+
+vec3 OctDecode(vec2 e) {
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
 vec3 CalcDirLightPBR(vec4 pos, vec3 normal, vec3 albedo, float metallic, float roughness, vec3 viewdir, float occlusion) {
     vec3 Lo = vec3(0);
     for (int i = 0; i < dirlight_count; i++) {
@@ -140,7 +174,7 @@ vec3 CalcDirLightPBR(vec4 pos, vec3 normal, vec3 albedo, float metallic, float r
 
         // Shadows
         float shadowFactor = 1.0;
-        if (dirlights[i].direction.w >= 0)
+        if (dirlights[i].color.w > 0)
             shadowFactor -= CalcShadow2D(i, normal, pos);
 
         Lo += shadowFactor * ((diffuse) + (specular)) * Li * max(dot(normal, Wi), 0.0);
@@ -152,16 +186,23 @@ vec3 CalcDirLightPBR(vec4 pos, vec3 normal, vec3 albedo, float metallic, float r
 
 vec3 CalcPointLightPBR(vec4 pos, vec3 normal, vec3 albedo, float metallic, float roughness, vec3 viewdir, float occlusion) {
     vec3 Lo = vec3(0);
-    // Sum over all point lights
-    for (int i = 0; i < pointlight_count; i++) {
+    // Locate this fragment's cluster
+    ivec2 tile = min(ivec2(TexCoords * vec2(clusterTilesX, clusterTilesY)), ivec2(clusterTilesX-1, clusterTilesY-1));
+    int slice = clamp(int(floor(log(-pos.z) * clusterDepthScale - clusterDepthBias)), 0, clusterSlices-1);
+    uvec2 cluster = texelFetch(clusterGrid, tile.x + clusterTilesX * (tile.y + clusterTilesY * slice)).rg;
+
+    // Sum over the point lights affecting this cluster
+    for (uint c = 0u; c < cluster.y; c++) {
+        PointLight_t light = FetchPointLight(int(texelFetch(clusterLightIndices, int(cluster.x + c)).r));
+
         // Light and halfway directions
-        vec3 Wi = normalize(pointlights[i].position.xyz - pos.xyz); // Point-to-light_i
+        vec3 Wi = normalize(light.position.xyz - pos.xyz); // Point-to-light_i
         vec3 H = normalize(viewdir + Wi); // Halfway
 
         // Incoming spectrial radiance from pointlight i
-        float dist = distance(pointlights[i].position.xyz, pos.xyz);
-        float attenuation = 1.0 / ( pointlights[i].attenuation.x + pointlights[i].attenuation.y*dist + pointlights[i].attenuation.z*dist*dist );
-        vec3 Li = pointlights[i].color.rgb * attenuation;   // Radiance
+        float dist = distance(light.position.xyz, pos.xyz);
+        float attenuation = 1.0 / ( light.attenuation.x + light.attenuation.y*dist + light.attenuation.z*dist*dist );
+        vec3 Li = light.color.rgb * attenuation;   // Radiance
 
         // Reflected spectral radiance: Cook-Torrance BRDF
         vec3 F0 = vec3(0.04);
@@ -182,8 +223,8 @@ vec3 CalcPointLightPBR(vec4 pos, vec3 normal, vec3 albedo, float metallic, float
 
         // Shadows
         float shadowFactor = 1.0;
-        if (pointlights[i].position_world.w >= 0)
-            shadowFactor -= CalcShadowCube(i, pos);
+        if (light.position_world.w > 0)
+            shadowFactor -= CalcShadowCube(light, pos);
 
         Lo += shadowFactor * ((diffuse) + (specular)) * Li * max(dot(normal, Wi), 0.0);
     }    
@@ -192,7 +233,15 @@ vec3 CalcPointLightPBR(vec4 pos, vec3 normal, vec3 albedo, float metallic, float
 }
 
 float CalcShadow2D(int lightIndex, vec3 normal, vec4 fragPos) {
-    vec4 fragPosLightSpace = dirlights[lightIndex].matrix * inv_view * fragPos;  // can be vec4(fragPos.xyz,1)
+    // Nearest cascade that reaches this fragment; none past the last one
+    int cascadeCount = int(dirlights[lightIndex].color.w);
+    int cascade = 0;
+    while (cascade < cascadeCount && -fragPos.z > dirlights[lightIndex].cascade_splits[cascade])
+        cascade++;
+    if (cascade == cascadeCount)
+        return 0.0;
+
+    vec4 fragPosLightSpace = dirlights[lightIndex].matrices[cascade] * inv_view * fragPos;  // can be vec4(fragPos.xyz,1)
     vec3 projCoords = fragPosLightSpace.xyz / fragPosLightSpace.w;
     projCoords = projCoords * 0.5 + 0.5;    // Map from [-1,1] to [0,1]
     float currentDepth = projCoords.z;
@@ -202,21 +251,25 @@ float CalcShadow2D(int lightIndex, vec3 normal, vec4 fragPos) {
     float stepsize = 0.5;
     
     float shadow = 0.0;
-    vec2 texelSize = vec2(1.0 / textureSize(shadowmap_2d_array_shadow, 0));
-    int shadowIndex = int(dirlights[lightIndex].direction.w);
+    vec2 texelSize = vec2(1.0 / textureSize(shadowAtlas, 0));
+    vec3 tile = dirlights[lightIndex].tiles[cascade].xyz;
+    vec2 tileCoords = tile.xy + projCoords.xy * tile.z;
+    // Filter taps stay inside the tile, off its neighbors
+    vec2 tileMin = tile.xy + 0.5 * texelSize;
+    vec2 tileMax = tile.xy + tile.z - 0.5 * texelSize;
     float bias = max(0.003*(1.0 - dot(normal, dirlights[lightIndex].direction.xyz)), 0.005);
 
     for (float x = -offset; x <= offset; x += stepsize) {
         for (float y = -offset; y <= offset; y += stepsize) {
-            float result = texture(shadowmap_2d_array_shadow, vec4(projCoords.xy + vec2(x,y) * texelSize, shadowIndex, currentDepth-bias));
+            float result = texture(shadowAtlas, vec3(clamp(tileCoords + vec2(x,y) * texelSize, tileMin, tileMax), currentDepth-bias));
             shadow += 1.0 - result;
         }
     }
     return shadow/(2*offset/stepsize+1)/(2*offset/stepsize+1);
 }
 
-float CalcShadowCube(int lightIndex, vec4 fragPos) {
-    vec3 fragToLight = vec3(inv_view * fragPos) - pointlights[lightIndex].position_world.xyz;
+float CalcShadowCube(PointLight_t light, vec4 fragPos) {
+    vec3 fragToLight = vec3(inv_view * fragPos) - light.position_world.xyz;
     float currentDepth = length(fragToLight);
     float viewDistance = length(vec3(fragPos));
     
@@ -224,17 +277,53 @@ float CalcShadowCube(int lightIndex, vec4 fragPos) {
     float bias = 0.005;
 
     float shadow = 0.0;
-    float farPlane = pointlights[lightIndex].position.w;
+    float farPlane = light.position.w;
     float diskRadius = 0.01 + 0.05 * viewDistance/farPlane; // Sharper shadows when closer, softer shadows when farther
-    int shadowIndex = int(pointlights[lightIndex].position_world.w);
+    float tileScale = light.position_world.w;
+    vec2 texelSize = vec2(1.0 / textureSize(shadowAtlas, 0));
     for (int i = 0; i < 20; i++) {
-        float result = texture(shadowmap_cube_array_shadow, vec4(fragToLight + sampleOffsetDirections[i] * diskRadius, shadowIndex), currentDepth/farPlane - bias);
+        // Each tap looks up the face it points at, which may not be the fragment's own
+        vec3 dir = fragToLight + sampleOffsetDirections[i] * diskRadius;
+        int face = CubeFace(dir);
+        vec4 faceTiles = light.tiles[face / 2];
+        vec2 tileOffset = (face % 2 == 0) ? faceTiles.xy : faceTiles.zw;
+        vec2 tileCoords = clamp(tileOffset + CubeFaceUV(dir, face) * tileScale, tileOffset + 0.5 * texelSize, tileOffset + tileScale - 0.5 * texelSize);
+        float result = texture(shadowAtlas, vec3(tileCoords, currentDepth/farPlane - bias));
         shadow += 1.0 - result;
     }
 
     return shadow/20.0;
 }
 
+PointLight_t FetchPointLight(int lightIndex) {
+    PointLight_t light;
+    light.color = texelFetch(pointlightData, 7*lightIndex);
+    light.attenuation = texelFetch(pointlightData, 7*lightIndex + 1);
+    light.position = texelFetch(pointlightData, 7*lightIndex + 2);
+    light.position_world = texelFetch(pointlightData, 7*lightIndex + 3);
+    for (int i = 0; i < 3; i++)
+        light.tiles[i] = texelFetch(pointlightData, 7*lightIndex + 4 + i);
+    return light;
+}
+
+// Cube face a direction from the light falls on, by its major axis
+int CubeFace(vec3 dir) {
+    vec3 a = abs(dir);
+    if (a.x >= a.y && a.x >= a.z)
+        return dir.x > 0 ? 0 : 1;
+    if (a.y >= a.z)
+        return dir.y > 0 ? 2 : 3;
+    return dir.z > 0 ? 4 : 5;
+}
+
+// Where a direction from the light lands in its face's shadow map, from [0,1]: the face's 90 degree projection
+vec2 CubeFaceUV(vec3 dir, int face) {
+    vec3 front = cubeFaceFront[face];
+    vec3 right = cross(front, cubeFaceUp[face]);
+    vec3 up = cross(right, front);
+    return vec2(dot(dir, right), dot(dir, up)) / dot(dir, front) * 0.5 + 0.5;
+}
+
 // Normal distribution function: Trowbridge-Reitz GGX
 // Description: Estimates microfacets exactly aligned with halfway vector
 // - N: surface normal vector
@@ -0,0 +1,25 @@
+#version 410 core
+
+// shaderv_depth.vs
+// Depth pre-pass vertex shader
+// Details: Must produce bit-identical positions to shaderv_gen.vs, since the geometry pass then tests with GL_EQUAL
+
+layout (location = 0) in vec3 aPos;
+layout (location = 5) in uint aFirstInstance;     // Constant per draw, see Renderer::DrawDataBuffer
+
+layout (std140) uniform Matrices_Vertex {
+    mat4 view;
+    mat4 projection;
+};
+uniform usamplerBuffer instanceDraws;    // Draw ID per instance
+uniform samplerBuffer drawData;
+
+invariant gl_Position;
+
+void main() {
+    int base = int(texelFetch(instanceDraws, int(aFirstInstance) + gl_InstanceID).r) * 8;
+    mat4 model = mat4(texelFetch(drawData, base), texelFetch(drawData, base + 1), texelFetch(drawData, base + 2), texelFetch(drawData, base + 3));
+    // Same expression as shaderv_gen.vs
+    vec4 fragPos = view * model * vec4(aPos, 1.0);
+    gl_Position = projection * fragPos;
+}
\ No newline at end of file
@@ -11,14 +11,15 @@ layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoord;
 layout (location = 3) in vec3 aTangent;
 layout (location = 4) in vec3 aBitangent;
-layout (location = 5) in mat4 aModel;
+layout (location = 5) in uint aFirstInstance;     // Constant per draw, see Renderer::DrawDataBuffer
 
 // TRANSFORMS
 layout (std140) uniform Matrices_Vertex {  // this is 2 * sizeof(glm::mat4)
     mat4 view;
     mat4 projection;
 };
-uniform mat4 model;
+uniform usamplerBuffer instanceDraws;    // Draw ID per instance
+uniform samplerBuffer drawData;    // Per draw: model (4 texels), world normal matrix (3), material index (1)
 
 // OUTPUTS
 out VS_OUT {
@@ -27,13 +28,21 @@ out VS_OUT {
     vec2 TexCoords;
     mat3 TBN;
 } vs_out;
+flat out int MaterialIndex;
+invariant gl_Position;    // Must match shaderv_depth.vs for the depth pre-pass
 
 void main() {
+    // Per-draw data
+    int base = int(texelFetch(instanceDraws, int(aFirstInstance) + gl_InstanceID).r) * 8;
+    mat4 model = mat4(texelFetch(drawData, base), texelFetch(drawData, base + 1), texelFetch(drawData, base + 2), texelFetch(drawData, base + 3));
+    mat3 normalMatrix = mat3(texelFetch(drawData, base + 4).xyz, texelFetch(drawData, base + 5).xyz, texelFetch(drawData, base + 6).xyz);
+    MaterialIndex = int(texelFetch(drawData, base + 7).x);
+
     // Core parameters
     vs_out.FragPos = view * model * vec4(aPos, 1.0);
-    vs_out.Normal = mat3(transpose(inverse(view * model))) * aNormal;    // normal_matrix * aNormal
+    vs_out.Normal = mat3(view) * normalMatrix * aNormal;   // The view matrix is rigid, so its normal matrix is itself
     vs_out.TexCoords = aTexCoord;
-    vec3 N = normalize(vec3(view * model * vec4(aNormal, 0)));
+    vec3 N = normalize(vs_out.Normal);
     vec3 T = normalize(vec3(view * model * vec4(aTangent, 0)));
     // vec3 B = normalize(vec3(view * model * vec4(aBitangent, 0)));
     T = normalize(T - dot(T,N) * N);    // Reorthogonalize T wrt N
@@ -1,11 +1,15 @@
 #version 410 core
 
 layout (location = 0) in vec3 aPos;
+layout (location = 5) in uint aFirstInstance;     // Constant per draw, see Renderer::DrawDataBuffer
 
 uniform mat4 lightSpaceMatrix;
-uniform mat4 model;
+uniform usamplerBuffer instanceDraws;    // Draw ID per instance
+uniform samplerBuffer drawData;
 
 void main() {
+    int base = int(texelFetch(instanceDraws, int(aFirstInstance) + gl_InstanceID).r) * 8;
+    mat4 model = mat4(texelFetch(drawData, base), texelFetch(drawData, base + 1), texelFetch(drawData, base + 2), texelFetch(drawData, base + 3));
     vec4 pos = lightSpaceMatrix * model * vec4(aPos, 1.0);
     gl_Position = pos;
 }
\ No newline at end of file
@@ -1,9 +1,27 @@
 #version 410 core
 
+// shaderv_shadowcube.vs
+// Point light shadow vertex shader. By default outputs worldspace positions for shaderg_shadowcube.gs to draw to all six
+// faces; with PER_FACE defined, draws to the single face given by lightSpaceMatrix.
+
 layout (location = 0) in vec3 aPos;
+layout (location = 5) in uint aFirstInstance;     // Constant per draw, see Renderer::DrawDataBuffer
+
+uniform usamplerBuffer instanceDraws;    // Draw ID per instance
+uniform samplerBuffer drawData;
 
-uniform mat4 model;
+#ifdef PER_FACE
+uniform mat4 lightSpaceMatrix;
+out vec4 FragPos;
+#endif
 
 void main () {
+    int base = int(texelFetch(instanceDraws, int(aFirstInstance) + gl_InstanceID).r) * 8;
+    mat4 model = mat4(texelFetch(drawData, base), texelFetch(drawData, base + 1), texelFetch(drawData, base + 2), texelFetch(drawData, base + 3));
+#ifdef PER_FACE
+    FragPos = model * vec4(aPos, 1);
+    gl_Position = lightSpaceMatrix * FragPos;
+#else
     gl_Position = model * vec4(aPos, 1);
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,122 @@
+#include "scene/bvh.hpp"
+#include "util/bounds.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Times Bvh::Query() against testing every box, for scenes of 1k, 10k and 100k boxes and random camera frustums.
+// CPU only, so it runs headless: `make bvhbench && ./bvhbench`.
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    constexpr float worldSize = 1000.f;
+    constexpr int frustumCount = 64;
+    constexpr int repeats = 8;
+
+    // Small boxes scattered through the world, like props in a level
+    Bounds::AabbArray randomBoxes(std::mt19937& rng, int count) {
+        std::uniform_real_distribution<float> position(-0.5f * worldSize, 0.5f * worldSize);
+        std::uniform_real_distribution<float> size(0.5f, 5.f);
+        Bounds::AabbArray boxes;
+        boxes.Reserve(count);
+        for (int i = 0; i < count; i++) {
+            const glm::vec3 center(position(rng), position(rng), position(rng));
+            const glm::vec3 extents(size(rng), size(rng), size(rng));
+            boxes.PushBack(Bounds::Aabb{center - extents, center + extents});
+        }
+        return boxes;
+    }
+
+    std::vector<Bounds::Frustum> randomFrustums(std::mt19937& rng) {
+        std::uniform_real_distribution<float> position(-0.5f * worldSize, 0.5f * worldSize);
+        std::uniform_real_distribution<float> direction(-1.f, 1.f);
+        const glm::mat4 projection = glm::perspective(glm::radians(60.f), 16.f / 9.f, 0.1f, 0.3f * worldSize);
+        std::vector<Bounds::Frustum> frustums;
+        for (int i = 0; i < frustumCount; i++) {
+            const glm::vec3 eye(position(rng), position(rng), position(rng));
+            const glm::vec3 forward(direction(rng), direction(rng), direction(rng));
+            frustums.emplace_back(projection * glm::lookAt(eye, eye + forward, glm::vec3(0, 1, 0)));
+        }
+        return frustums;
+    }
+
+    // Microseconds per frustum, best of a few runs
+    template <typename F>
+    double time(F query) {
+        double best = 1e30;
+        for (int r = 0; r < repeats; r++) {
+            const Clock::time_point start = Clock::now();
+            for (int f = 0; f < frustumCount; f++)
+                query(f);
+            best = std::min(best, std::chrono::duration<double, std::micro>(Clock::now() - start).count() / frustumCount);
+        }
+        return best;
+    }
+
+}
+
+int main() {
+    std::mt19937 rng(1234);
+    const std::vector<Bounds::Frustum> frustums = randomFrustums(rng);
+    int failures = 0;
+
+    std::clog << std::fixed << std::setprecision(2);
+    std::clog << std::setw(8) << "Boxes" << std::setw(10) << "Visible" << std::setw(14) << "Linear (us)"
+        << std::setw(18) << "Linear SIMD (us)" << std::setw(12) << "BVH (us)" << std::setw(10) << "Speedup" << std::endl;
+    for (int count : {1000, 10000, 100000}) {
+        const Bounds::AabbArray boxes = randomBoxes(rng, count);
+        std::vector<Bounds::Aabb> aabbs(count);
+        for (int i = 0; i < count; i++)
+            aabbs[i] = boxes.At(i);
+        Scene::Bvh bvh;
+        bvh.Build(boxes);
+
+        std::vector<unsigned int> result;
+        size_t visible = 0;
+        const double linear = time([&](int f) {
+            result.clear();
+            for (int i = 0; i < count; i++) {
+                if (frustums[f].Intersects(aabbs[i]))
+                    result.push_back(i);
+            }
+            visible += result.size();
+        });
+        const double linearSimd = time([&](int f) {
+            result.clear();
+            frustums[f].Cull(boxes, 0, boxes.Size(), result);
+        });
+        const double hierarchy = time([&](int f) {
+            result.clear();
+            bvh.Query(frustums[f], result);
+        });
+
+        // Same boxes either way, in a different order
+        std::vector<unsigned int> expected;
+        for (const Bounds::Frustum& frustum : frustums) {
+            expected.clear();
+            result.clear();
+            frustum.Cull(boxes, 0, boxes.Size(), expected);
+            bvh.Query(frustum, result);
+            std::sort(result.begin(), result.end());
+            if (result != expected)
+                failures++;
+        }
+
+        std::clog << std::setw(8) << count << std::setw(10) << visible / (repeats * frustumCount) << std::setw(14) << linear
+            << std::setw(18) << linearSimd << std::setw(12) << hierarchy << std::setw(9) << linear / hierarchy << "x" << std::endl;
+    }
+
+    if (failures > 0) {
+        std::cerr << failures << " BVH queries differ from testing every box" << std::endl;
+        return 1;
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,491 @@
+#include "asset/image.hpp"
+#include "component/all.hpp"
+#include "context/application.hpp"
+#include "core/glstate.hpp"
+#include "material/material.hpp"
+#include "material/texture.hpp"
+#include "renderer/drawdata.hpp"
+#include "renderer/postprocessing.hpp"
+#include "renderer/profiler.hpp"
+#include "renderer/renderer.hpp"
+#include "renderer/renderqueue.hpp"
+#include "renderer/rendertargetpool.hpp"
+#include "scene/scene.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+// Renders Demo 2's scene (metal spheres and cubes in a box of walls, lit by shadowed point lights) built in code, and
+// compares the renderer's options on it. Needs a GL 4.1 context, so it opens a window like the app does:
+// `make renderbench && ./renderbench [section...]`, sections being submit, prepass, ssao, pointshadows, post and pool (all if none are given).
+// Times are medians over the measured frames. GPU times come from the profiler's timer queries; frame times are wall
+// clock up to glFinish, so they include whatever the driver and GPU do with the frame.
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    constexpr int warmupFrames = 5;
+    constexpr int measuredFrames = 20;
+
+    struct Materials {
+        std::shared_ptr<Material::PBRMetallicMaterial> walls;
+        std::array<std::shared_ptr<Material::PBRMetallicMaterial>, 3> metals;
+        std::array<std::shared_ptr<Material::PBRMetallicMaterial>, 4> neons;
+    };
+
+    Materials makeMaterials() {
+        Materials materials;
+        // Maps missing from a checkout are left out rather than failing the run
+        auto texture = [](const std::string& name, Material::TextureType type) -> std::shared_ptr<Core::Tex2D> {
+            const fs::path path("assets/textures/luxury-vinyl-plank-bl/luxury-vinyl-plank_" + name + ".png");
+            if (!fs::exists(path))
+                return nullptr;
+            return std::make_shared<Material::Texture>(std::make_shared<ImageAsset>(path), type, GL_REPEAT, GL_LINEAR_MIPMAP_LINEAR)->tex;
+        };
+        materials.walls = std::make_shared<Material::PBRMetallicMaterial>();
+        materials.walls->albedo = glm::vec3(0);
+        materials.walls->albedoMap = texture("albedo", Material::TextureType::Diffuse);
+        materials.walls->occlusionMap = texture("ao", Material::TextureType::Occlusion);
+        materials.walls->normalMap = texture("normal-ogl", Material::TextureType::Normal);
+        materials.walls->metallicMap = texture("metallic", Material::TextureType::Metalness);
+        materials.walls->roughnessMap = texture("roughness", Material::TextureType::Roughness);
+
+        const glm::vec3 metalColors[] = {glm::vec3(250, 208, 192), glm::vec3(198, 198, 200), glm::vec3(255, 226, 155)};
+        for (size_t i = 0; i < materials.metals.size(); i++) {
+            materials.metals[i] = std::make_shared<Material::PBRMetallicMaterial>();
+            materials.metals[i]->albedo = glm::pow(metalColors[i] / 255.f, glm::vec3(2.2f));
+            materials.metals[i]->metallic = 1.0f;
+            materials.metals[i]->roughness = 0.45f;
+        }
+        const glm::vec3 neonColors[] = {Color::white, Color::cyan, Color::magenta, Color::yellow};
+        for (size_t i = 0; i < materials.neons.size(); i++) {
+            materials.neons[i] = std::make_shared<Material::PBRMetallicMaterial>();
+            materials.neons[i]->albedo = neonColors[i] * 10.f;
+            materials.neons[i]->metallic = 0.0f;
+            materials.neons[i]->roughness = 1.0f;
+        }
+        return materials;
+    }
+
+    struct Field {
+        std::unique_ptr<Scene::Scene> scene;
+        std::shared_ptr<Scene::SceneNode> primitives;   // Parent of the metal primitives
+    };
+
+    // Demo 2's scene, with the same random placement, for any number of primitives and lights
+    Field makeField(const Materials& materials, int primitive_count, int light_count) {
+        Field field;
+        field.scene = std::make_unique<Scene::Scene>();
+        std::default_random_engine eng(3);
+        std::uniform_int_distribution<> shapes(0, 1);
+        std::uniform_int_distribution<> metals(0, materials.metals.size() - 1);
+        const float range = 20.f;
+        std::uniform_real_distribution<float> translation(-range/2, range/2);
+        std::uniform_real_distribution<float> rotation(-90.f, 90.f);
+        std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+        auto shape = [&]() -> std::shared_ptr<Component::Mesh> {
+            if (shapes(eng) == 0)
+                return std::make_shared<Component::Sphere>();
+            return std::make_shared<Component::Cube>();
+        };
+
+        field.primitives = field.scene->EmplaceChild();
+        for (int i = 0; i < primitive_count; i++) {
+            std::shared_ptr<Component::Mesh> mesh = shape();
+            mesh->material = materials.metals[metals(eng)];
+            auto node = field.primitives->EmplaceChild();
+            node->transform.Translate(translation(eng), translation(eng), translation(eng));
+            node->transform.Rotate(rotation(eng), rotation(eng), rotation(eng));
+            node->transform.Scale(scale(eng), scale(eng), scale(eng));
+            node->SetComponent(mesh);
+        }
+        auto lights = field.scene->EmplaceChild();
+        for (int i = 0; i < light_count; i++) {
+            std::shared_ptr<Component::Mesh> mesh = shape();
+            const auto& neon = materials.neons[i % materials.neons.size()];
+            auto node = lights->EmplaceChild();
+            node->transform.Translate(translation(eng), translation(eng), translation(eng));
+            auto light = std::make_shared<Component::PointLight>();
+            light->color = neon->albedo / 10.f;
+            light->intensity = 5.f;
+            light->EnableShadows();
+            node->SetComponent(light);
+            mesh->material = neon;
+            mesh->castShadows = false;
+            auto meshNode = node->EmplaceChild();
+            meshNode->transform.Scale(0.5f);
+            meshNode->SetComponent(mesh);
+        }
+
+        auto walls = field.scene->EmplaceChild();
+        walls->transform.Scale(range);
+        auto wall = std::make_shared<Component::Plane>();
+        wall->material = materials.walls;
+        const std::array<std::pair<glm::vec3, glm::vec3>, 6> placements = {{
+            {{0.5f, 0, 0}, {0, 0, 90}}, {{-0.5f, 0, 0}, {0, 0, -90}}, {{0, 0.5f, 0}, {180, 0, 0}},
+            {{0, -0.5f, 0}, {0, 0, 0}}, {{0, 0, 0.5f}, {-90, 0, 0}}, {{0, 0, -0.5f}, {90, 0, 0}},
+        }};
+        for (const auto& [position, angles] : placements) {
+            auto node = walls->EmplaceChild(wall);
+            node->transform.Translate(position.x, position.y, position.z);
+            node->transform.Rotate(angles.x, angles.y, angles.z);
+        }
+        field.scene->UpdateWorldTransforms();
+        return field;
+    }
+
+    std::unique_ptr<Component::Camera> makeCamera() {
+        auto camera = std::make_unique<Component::Camera>();
+        camera->Translate(-5, 3, -0.25);
+        camera->Rotate(0, -90);
+        return camera;
+    }
+
+    // What Application::display() does around a demo's scene
+    void endFrame() {
+        Renderer::Profiler::Instance().EndFrame();
+        Renderer::RenderTargetPool::Instance().EndFrame();
+        Core::GlState::Instance().EndFrame();
+        Context::Application::Instance().activeWindow->SwapBuffers();
+    }
+
+    double median(std::vector<double> values) {
+        std::sort(values.begin(), values.end());
+        return values[values.size() / 2];
+    }
+
+    struct FrameTimes {
+        double submitMs;    // Until frame() returns
+        double frameMs;     // Until the GL has finished it
+    };
+
+    // Medians over the measured calls of frame(), each finished with glFinish
+    template <typename F>
+    FrameTimes timeFrames(F frame) {
+        std::vector<double> submit, total;
+        for (int i = 0; i < warmupFrames + measuredFrames; i++) {
+            const Clock::time_point start = Clock::now();
+            frame();
+            const Clock::time_point submitted = Clock::now();
+            glFinish();
+            if (i >= warmupFrames) {
+                submit.push_back(std::chrono::duration<double, std::milli>(submitted - start).count());
+                total.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+            }
+        }
+        return {median(submit), median(total)};
+    }
+
+    // Calls frame(), which renders one frame, for the warmup and measured frames, finishing each as the app does, and
+    // returns the median time of the measured ones up to glFinish. The profiler is cleared after the warmup frames, so its
+    // statistics cover the measured ones (and the few extra frames it takes their timer queries to be read back).
+    template <typename F>
+    double renderFrames(F frame) {
+        std::vector<double> times;
+        for (int i = 0; i < warmupFrames + measuredFrames + Renderer::Profiler::queriesPerScope; i++) {
+            if (i == warmupFrames)
+                Renderer::Profiler::Instance().Clear();
+            const Clock::time_point start = Clock::now();
+            frame();
+            glFinish();
+            if (i >= warmupFrames && i < warmupFrames + measuredFrames)
+                times.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+            endFrame();
+        }
+        return median(times);
+    }
+    double renderFrames(Renderer::DeferredRenderer& renderer, Field& field, Component::Camera& camera) {
+        return renderFrames([&]() { renderer.Render(*field.scene, camera); });
+    }
+
+    // Median GPU time of a pass over the measured frames, or -1 if it did not run
+    float gpuMs(const std::string& pass) {
+        const Renderer::Profiler::ScopeStats* stats = Renderer::Profiler::Instance().FindGpu(pass);
+        return stats && stats->samples > 0 ? stats->p50Ms : -1.f;
+    }
+
+    // Median CPU time of a pass over the measured frames, or -1 if it did not run
+    float cpuMs(const std::string& pass) {
+        const Renderer::Profiler::ScopeStats* stats = Renderer::Profiler::Instance().FindCpu(pass);
+        return stats && stats->samples > 0 ? stats->p50Ms : -1.f;
+    }
+
+    // ---- submit: one draw per object against sorted, instanced draws ----
+
+    // The geometry pass's draws of every drawable, without culling or the rest of the frame: each through Mesh::Draw(),
+    // which binds its material and appends an immediate draw record, or queued, sorted and submitted as instanced runs
+    // reading the frame's draw records. Into a small target, so that the cost per draw rather than per pixel is measured.
+    void benchSubmit(const Materials& materials) {
+        constexpr int targetSize = 128;
+        std::clog << "Draw submission: every drawable of Demo 2's field into a " << targetSize << "x" << targetSize << " G-buffer target" << std::endl;
+        std::clog << std::setw(12) << "Primitives" << std::setw(8) << "Draws"
+            << std::setw(30) << "Per object submit/frame (ms)" << std::setw(12) << "Draws/s"
+            << std::setw(26) << "Queued submit/frame (ms)" << std::setw(12) << "Draws/s" << std::setw(8) << "Calls" << std::endl;
+
+        for (int count : {50, 500, 5000}) {
+            Field field = makeField(materials, count, 8);
+            auto camera = makeCamera();
+            // Leaves the frame's uniform blocks bound for the draws below
+            Renderer::DeferredRenderer renderer;
+            renderer.Render(*field.scene, *camera);
+            endFrame();
+
+            Renderer::RenderTargetPool& pool = Renderer::RenderTargetPool::Instance();
+            auto color = pool.Acquire(targetSize, targetSize, GL_RGBA8);
+            auto depth = pool.Acquire(targetSize, targetSize, GL_DEPTH_COMPONENT24);
+            Core::Fbo& target = pool.Framebuffer({color}, depth);
+            auto beginTarget = [&]() {
+                target.Bind();
+                target.SetViewportDims();
+                Core::GlState::Instance().SetEnabled(GL_DEPTH_TEST, true);
+                Core::GlState::Instance().DepthMask(true);
+                target.ClearColor();
+                target.ClearDepth();
+            };
+
+            const std::vector<Scene::Drawable>& drawables = field.scene->Drawables();
+            Renderer::DrawDataBuffer immediate;
+            const FrameTimes perObject = timeFrames([&]() {
+                beginTarget();
+                immediate.BeginImmediate();
+                for (const Scene::Drawable& drawable : drawables)
+                    drawable.mesh->Draw(drawable.worldMatrix);
+            });
+
+            Renderer::DrawDataBuffer drawData;
+            Renderer::RenderQueue queue;
+            std::vector<unsigned int> all(drawables.size());
+            std::iota(all.begin(), all.end(), 0u);
+            const float farPlane = camera->projection[3][2] / (camera->projection[2][2] + 1.f);
+            const FrameTimes queued = timeFrames([&]() {
+                beginTarget();
+                drawData.Clear();
+                for (const Scene::Drawable& drawable : drawables)
+                    drawData.Add(drawable.worldMatrix, Renderer::RenderQueue::MaterialFor(*drawable.mesh));
+                drawData.Upload();
+                drawData.Bind();
+                queue.Clear();
+                queue.Push(*field.scene, all, Renderer::RenderQueue::Pass::Geometry, true, camera->transform.position, farPlane);
+                queue.Sort();
+                queue.Submit(*field.scene);
+            });
+
+            pool.Release(color);
+            pool.Release(depth);
+            endFrame();
+            auto drawsPerSecond = [&](const FrameTimes& times) { return std::to_string(static_cast<long>(drawables.size() / times.frameMs * 1e3)); };
+            std::clog << std::setw(12) << count << std::setw(8) << drawables.size()
+                << std::setw(22) << perObject.submitMs << " / " << std::setw(5) << perObject.frameMs << std::setw(12) << drawsPerSecond(perObject)
+                << std::setw(18) << queued.submitMs << " / " << std::setw(5) << queued.frameMs << std::setw(12) << drawsPerSecond(queued)
+                << std::setw(8) << queue.Stats().draws << std::endl;
+        }
+    }
+
+
+    // ---- prepass: the G-buffer pass with and without a depth prepass ----
+
+    void benchPrepass(const Materials& materials) {
+        const std::shared_ptr<Context::Window> window = Context::Application::Instance().activeWindow;
+        std::clog << "Depth prepass: Demo 2's field, full frames at " << window->Width() << "x" << window->Height() << std::endl;
+        std::clog << std::setw(12) << "Primitives" << std::setw(10) << "Prepass" << std::setw(18) << "Samples passed"
+            << std::setw(16) << "Geometry (ms)" << std::setw(14) << "Frame (ms)" << std::endl;
+        for (int count : {50, 500}) {
+            Field field = makeField(materials, count, 8);
+            auto camera = makeCamera();
+            for (bool prepass : {false, true}) {
+                Renderer::DeferredRenderer renderer;
+                renderer.depthPrepass = prepass;
+                const double frameMs = renderFrames(renderer, field, *camera);
+                std::clog << std::setw(12) << count << std::setw(10) << (prepass ? "on" : "off")
+                    << std::setw(18) << renderer.Stats().geometrySamples << std::setw(16) << gpuMs("Geometry")
+                    << std::setw(14) << frameMs << std::endl;
+            }
+        }
+    }
+
+    // ---- ssao: SSAO resolution against sample count ----
+
+    void benchSsao(const Materials& materials) {
+        const std::shared_ptr<Context::Window> window = Context::Application::Instance().activeWindow;
+        // One light, since only the SSAO pass is of interest
+        Field field = makeField(materials, 50, 1);
+        auto camera = makeCamera();
+        std::clog << "SSAO: median GPU ms of the SSAO pass (including blur and upsampling) at " << window->Width() << "x" << window->Height() << std::endl;
+        std::clog << std::setw(12) << "Resolution";
+        for (int samples : {8, 16, 32, 64})
+            std::clog << std::setw(12) << std::to_string(samples) + " samples";
+        std::clog << std::endl;
+        const std::pair<const char*, Renderer::SsaoModule::Resolution> resolutions[] = {
+            {"Full", Renderer::SsaoModule::Resolution::Full},
+            {"Half", Renderer::SsaoModule::Resolution::Half},
+            {"Quarter", Renderer::SsaoModule::Resolution::Quarter},
+        };
+        for (const auto& [name, resolution] : resolutions) {
+            std::clog << std::setw(12) << name;
+            for (int samples : {8, 16, 32, 64}) {
+                Renderer::DeferredRenderer renderer;
+                renderer.ssaoResolution = resolution;
+                renderer.ssaoSamples = samples;
+                renderFrames(renderer, field, *camera);
+                std::clog << std::setw(12) << gpuMs("SSAO") << std::flush;
+            }
+            std::clog << std::endl;
+        }
+    }
+
+    // ---- pointshadows: cube maps through the geometry shader against per face ----
+
+    void benchPointShadows(const Materials& materials) {
+        std::clog << "Point shadows: Demo 2's field with its primitives moving every frame, so no tile is cached" << std::endl;
+        std::clog << std::setw(8) << "Lights" << std::setw(16) << "Mode" << std::setw(8) << "Tiles"
+            << std::setw(10) << "Drawn" << std::setw(12) << "GPU (ms)" << std::setw(12) << "CPU (ms)" << std::endl;
+        const std::pair<const char*, Renderer::PointShadowModule::CubeMode> modes[] = {
+            {"Geometry shader", Renderer::PointShadowModule::CubeMode::GeometryShader},
+            {"Per face", Renderer::PointShadowModule::CubeMode::PerFace},
+        };
+        for (int lights : {1, 4, 8, 16}) {
+            Field field = makeField(materials, 50, lights);
+            auto camera = makeCamera();
+            for (const auto& [name, mode] : modes) {
+                Renderer::DeferredRenderer renderer;
+                renderer.ssao = false;
+                renderer.pointShadowMode = mode;
+                float step = 0.01f;
+                renderFrames([&]() {
+                    field.primitives->transform.Translate(0, step, 0);
+                    step = -step;
+                    renderer.Render(*field.scene, *camera);
+                });
+                std::clog << std::setw(8) << lights << std::setw(16) << name << std::setw(8) << renderer.Stats().shadowTilesRendered
+                    << std::setw(10) << renderer.Stats().pointShadows.drawn << std::setw(12) << gpuMs("Point shadows")
+                    << std::setw(12) << cpuMs("Point shadows") << std::endl;
+            }
+        }
+    }
+
+    // ---- post: the fused post-processing chain against separate passes ----
+
+    // Bloom, tone mapping and FXAA on the lit frame, through PostProcessing::Chain and through the separate processors the way
+    // the demo used them before it: each into a GL_RGBA32F target, the last blitted to the window
+    void benchPost(const Materials& materials) {
+        const std::shared_ptr<Context::Window> window = Context::Application::Instance().activeWindow;
+        Field field = makeField(materials, 50, 1);
+        auto camera = makeCamera();
+        std::clog << "Post-processing: bloom, tone mapping and FXAA at " << window->Width() << "x" << window->Height() << std::endl;
+        std::clog << std::setw(12) << "Path" << std::setw(12) << "GPU (ms)" << std::setw(28) << "Estimated traffic (MB)" << std::endl;
+
+        PostProcessing::Chain chain;
+        chain.bloomEnabled = true;
+        {
+            Renderer::DeferredRenderer renderer;
+            renderer.ssao = false;
+            renderer.postProcessing = &chain;
+            renderFrames(renderer, field, *camera);
+        }
+        std::clog << std::setw(12) << "Fused" << std::setw(12) << gpuMs("Bloom") + gpuMs("Composite") + gpuMs("FXAA")
+            << std::setw(28) << chain.LastTraffic().fused * 1e-6 << std::endl;
+
+        Renderer::DeferredRenderer renderer;
+        renderer.ssao = false;
+        PostProcessing::Bloom bloom;
+        PostProcessing::Hdr hdr;
+        PostProcessing::Fxaa fxaa;
+        renderFrames([&]() {
+            Core::Fbo* color = renderer.Render(*field.scene, *camera);
+            Renderer::Profiler::Instance().BeginGpu("Separate post");
+            Core::Fbo* output = fxaa.Process(*hdr.Process(*bloom.Process(*color)));
+            output->BlitToDefault(true, false);
+            Renderer::Profiler::Instance().EndGpu();
+        });
+        std::clog << std::setw(12) << "Separate" << std::setw(12) << gpuMs("Separate post")
+            << std::setw(28) << chain.LastTraffic().separate * 1e-6 << std::endl;
+    }
+
+    // ---- pool: render target memory with and without the pool ----
+
+    // The same sequence of frames, changing the options that change which targets a frame asks for, with the pool on and
+    // then off. Sizes are the pool's estimates from each format's texel size.
+    void benchPool(const Materials& materials) {
+        Field field = makeField(materials, 50, 1);
+        auto camera = makeCamera();
+        PostProcessing::Chain chain;
+        const std::function<void(Renderer::DeferredRenderer&)> phases[] = {
+            [&](Renderer::DeferredRenderer& renderer) { renderer.ssaoResolution = Renderer::SsaoModule::Resolution::Half; chain.bloomEnabled = true; },
+            [&](Renderer::DeferredRenderer& renderer) { renderer.ssaoResolution = Renderer::SsaoModule::Resolution::Full; },
+            [&](Renderer::DeferredRenderer& renderer) { renderer.depthPrepass = true; chain.bloomEnabled = false; },
+            [&](Renderer::DeferredRenderer& renderer) { renderer.ssao = false; chain.fxaaEnabled = false; },
+        };
+        constexpr int framesPerPhase = 8;
+        std::clog << "Render targets: " << std::size(phases) << " option changes, " << framesPerPhase << " frames each; sizes estimated" << std::endl;
+        std::clog << std::setw(10) << "Pool" << std::setw(16) << "Peak textures" << std::setw(18) << "Peak size (MB)"
+            << std::setw(12) << "Created" << std::setw(14) << "Frame (ms)" << std::endl;
+
+        Renderer::RenderTargetPool& pool = Renderer::RenderTargetPool::Instance();
+        for (bool pooling : {true, false}) {
+            // Start from an empty pool: without pooling, a frame frees every target it released
+            pool.pooling = false;
+            pool.EndFrame();
+            pool.pooling = pooling;
+
+            Renderer::DeferredRenderer renderer;
+            renderer.ssaoSamples = 32;
+            renderer.postProcessing = &chain;
+            chain.bloomEnabled = chain.fxaaEnabled = true;
+            int peakTextures = 0, created = 0;
+            double peakBytes = 0.0;
+            std::vector<double> times;
+            for (const auto& phase : phases) {
+                phase(renderer);
+                for (int i = 0; i < framesPerPhase; i++) {
+                    const Clock::time_point start = Clock::now();
+                    renderer.Render(*field.scene, *camera);
+                    glFinish();
+                    times.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+                    endFrame();
+                    const Renderer::RenderTargetPool::PoolStats& stats = pool.LastFrame();
+                    peakTextures = std::max(peakTextures, stats.peakTextures);
+                    peakBytes = std::max(peakBytes, stats.peakBytes);
+                    created += stats.created;
+                }
+            }
+            std::clog << std::setw(10) << (pooling ? "on" : "off") << std::setw(16) << peakTextures << std::setw(18) << peakBytes * 1e-6
+                << std::setw(12) << created << std::setw(14) << median(times) << std::endl;
+        }
+        pool.pooling = true;
+    }
+}
+
+int main(int argc, char** argv) {
+    const std::set<std::string> sections(argv + 1, argv + argc);
+    auto run = [&](const std::string& section) { return sections.empty() || sections.count(section) > 0; };
+
+    Context::Application::Instance();
+    std::clog << glGetString(GL_RENDERER) << ", " << glGetString(GL_VERSION) << std::endl;
+    std::clog << std::fixed << std::setprecision(2);
+    const Materials materials = makeMaterials();
+
+    if (run("submit"))
+        benchSubmit(materials);
+    if (run("prepass"))
+        benchPrepass(materials);
+    if (run("ssao"))
+        benchSsao(materials);
+    if (run("pointshadows"))
+        benchPointShadows(materials);
+    if (run("post"))
+        benchPost(materials);
+    if (run("pool"))
+        benchPool(materials);
+    return 0;
+}
\ No newline at end of file
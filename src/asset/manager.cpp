@@ -1,5 +1,7 @@
 #include "asset/manager.hpp"
 
+#include "renderer/profiler.hpp"
+
 #include <iostream>
 #include <memory>
 
@@ -29,8 +31,14 @@ void AssetManager::syncWithDevice(bool sync_cold) {
     for (const auto& [_, info] : assets) {
         if (sync_cold || info.hotReload) {
             if (info.asset->NeedsResync()) {
+                const auto start = std::chrono::steady_clock::now();
                 info.asset->Resync();
+                trace("Reload " + info.asset->GetFile().RelativePath().string(), start);
             }
         }
     }
+}
+
+void AssetManager::trace(const std::string& name, std::chrono::steady_clock::time_point start) {
+    Renderer::Profiler::Instance().TraceEvent(name, "asset", start, Renderer::Profiler::Clock::now());
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 
 #include "util/file.hpp"
 
+#include <chrono>
 #include <iostream>
 #include <filesystem>
 #include <map>
@@ -80,6 +81,8 @@ class AssetManager {
         std::shared_ptr<T> load(bool hot_reload, const Path& path, Args&& ...args);
         
         void syncWithDevice(bool sync_cold = true);
+        // Records a load or reload that began at start in the profiler's trace
+        void trace(const std::string& name, std::chrono::steady_clock::time_point start);
 
 };
 
@@ -129,7 +132,10 @@ std::shared_ptr<T> AssetManager::load(bool hot_reload, const Path& path, Args&&
     if (asset) {
         // std::clog << "Info - Loading an asset that was already loaded!" << std::endl;
     } else {
+        // Loads are the usual cause of a hitch, so they show up in traces
+        const auto start = std::chrono::steady_clock::now();
         asset = std::make_shared<T>(path, std::forward<Args>(args)...);
+        trace("Load " + path.RelativePath().string(), start);
         
         AssetInfo info {
             asset,
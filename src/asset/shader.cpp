@@ -12,18 +12,20 @@ ShaderAsset::ShaderAsset(const Path& path, GLenum shader_type)
 {}
     
 ShaderAsset::~ShaderAsset() {
-    glDeleteShader(handle);
+    for (auto& [defines, handle] : handles)
+        glDeleteShader(handle);
 }
     
-GLuint ShaderAsset::Handle() {
-    if (handle == -1) {
-        setup();
+GLuint ShaderAsset::Handle(const std::string& defines) {
+    auto it = handles.find(defines);
+    if (it == handles.end()) {
+        it = handles.emplace(defines, compile(defines)).first;
     }
-    return handle;
+    return it->second;
 }
 
-void ShaderAsset::setup() {
-    handle = glCreateShader(type);
+GLuint ShaderAsset::compile(const std::string& defines) {
+    GLuint handle = glCreateShader(type);
     std::string pathString = file.RawPath();
 
     std::clog << "Loading shader: " << file.RelativePath() << std::endl;
@@ -32,7 +34,6 @@ void ShaderAsset::setup() {
     std::ifstream       ifs;
     std::stringstream   ss;
     std::string         s;
-    const GLchar*       c;
     
     ifs.open(pathString); // same as calling constructor vs_ifstream(path)
     if (ifs.fail()) {
@@ -42,7 +43,14 @@ void ShaderAsset::setup() {
     }
     ss << ifs.rdbuf();
     s = ss.str();
-    c = s.c_str();
+
+    // ==== Insert defines ====
+    // #version must stay first, and #line keeps compiler messages pointing at the file's own line numbers
+    if (!defines.empty()) {
+        const size_t versionEnd = s.find('\n') + 1;
+        s.insert(versionEnd, defines + "\n#line 2\n");
+    }
+    const GLchar* c = s.c_str();
 
     // ==== Compile shader ====
     GLint   compileStatus;
@@ -54,12 +62,17 @@ void ShaderAsset::setup() {
     glGetShaderiv(handle, GL_COMPILE_STATUS, &compileStatus);
     if (!compileStatus) {
         glGetShaderInfoLog(handle, 1024, NULL, infoLog);
+        glDeleteShader(handle);
         std::string errorMsg = "Failed to compile shader! ";
         errorMsg += infoLog;
         throw std::runtime_error(errorMsg);
     }
+    return handle;
 }
 
 void ShaderAsset::syncWithFile() {
-    setup();
+    for (auto& [defines, handle] : handles) {
+        glDeleteShader(handle);
+        handle = compile(defines);
+    }
 }
\ No newline at end of file
@@ -3,6 +3,9 @@
 #include "asset/manager.hpp"
 #include <glad/gl.h>
 
+#include <map>
+#include <string>
+
 class ShaderAsset : public Asset {
     public:
         ShaderAsset(const Path& path, GLenum shader_type);
@@ -12,12 +15,14 @@ class ShaderAsset : public Asset {
         
         void SetType(GLenum shader_type) { type = shader_type; }
         
-        GLuint Handle();
+        // Compiled with defines inserted after the #version line, e.g. "#define KERNEL_SIZE 16\n".
+        // Each set of defines is a separate shader object, compiled on first use and recompiled on resync.
+        GLuint Handle(const std::string& defines = "");
 
     private:
-        GLuint handle = -1;
+        std::map<std::string, GLuint> handles;  // By defines
         GLenum type;
 
-        void setup();
+        GLuint compile(const std::string& defines);
         void syncWithFile() override;
 };
\ No newline at end of file
@@ -7,7 +7,10 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <imgui/imgui.h>
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <limits>
 
 namespace Component {     
     
@@ -33,39 +36,83 @@ namespace Component {
         typeName = "Directional Light";
     }
 
-    const glm::mat4& DirectionalLight::LightspaceMatrix() const { 
+    const std::vector<glm::mat4>& DirectionalLight::CascadeMatrices() const { 
         if (!hasShadows) {
             throw std::runtime_error("Shadows are disabled for this light source!");
         }
-        return lightspaceMatrix; 
+        return cascadeMatrices; 
     }
 
-    void DirectionalLight::EnableShadows(float width, float height, float near, float far, float dist) {
+    void DirectionalLight::EnableShadows(float max_distance, int cascade_count, float split_lambda, float caster_margin) {
         hasShadows = true;
-        projWidth = width;
-        projHeight = height;
-        nearPlane = near;
-        farPlane = far;
-        distance = dist;
+        farPlane = max_distance;
+        cascadeCount = std::clamp(cascade_count, 1, maxCascades);
+        splitLambda = split_lambda;
+        casterMargin = caster_margin;
     }
 
     void DirectionalLight::Draw(const glm::mat4& parent_transform) {
         const glm::mat4 rotation = Transform::ExtractRotation(parent_transform);
-        const glm::vec3 direction = glm::mat3(rotation) * glm::vec3(0,0,1);
-        if (direction != lastDirection) {
-            updateLightspaceMatrix(direction);
-            lastDirection = direction;
-        }
+        direction = glm::mat3(rotation) * glm::vec3(0,0,1);
     }
 
-    void DirectionalLight::updateLightspaceMatrix(const glm::vec3& direction) { 
-        const glm::mat4 projection = glm::ortho(-projWidth/2, projWidth/2, -projHeight/2, projHeight/2, nearPlane, farPlane);
-        glm::mat4 view; 
-        if (direction != Direction::down && direction != Direction::up) 
-            view = glm::lookAt(-distance*direction, glm::vec3(0), Direction::up);
-        else
-            view = glm::lookAt(-distance*direction, glm::vec3(0), Direction::front);
-        lightspaceMatrix = projection * view;
+    void DirectionalLight::FitCascades(const glm::mat4& camera_view, const glm::mat4& camera_projection, int map_size) {
+        if (!hasShadows)
+            return;
+        // Shadows may also be switched on from the GUI, without EnableShadows()
+        cascadeMatrices.resize(cascadeCount);
+        cascadeSplits.resize(cascadeCount);
+
+        // Camera near and far planes, recovered from a perspective projection
+        const float cameraNear = camera_projection[3][2] / (camera_projection[2][2] - 1.f);
+        const float cameraFar = std::min(camera_projection[3][2] / (camera_projection[2][2] + 1.f), farPlane);
+
+        // View-space frustum corners on the near plane; a corner at view distance d is nearCorners[i] * d / cameraNear
+        const glm::mat4 invProjection = glm::inverse(camera_projection);
+        glm::vec3 nearCorners[4];
+        for (int i = 0; i < 4; i++) {
+            const glm::vec4 corner = invProjection * glm::vec4(i & 1 ? 1 : -1, i & 2 ? 1 : -1, -1, 1);
+            nearCorners[i] = glm::vec3(corner) / corner.w;
+        }
+        const glm::mat4 invView = glm::inverse(camera_view);
+        const glm::vec3 up = direction != Direction::down && direction != Direction::up ? Direction::up : Direction::front;
+
+        float sliceNear = cameraNear;
+        for (int c = 0; c < cascadeCount; c++) {
+            // ---- Split ----
+            const float fraction = static_cast<float>(c + 1) / cascadeCount;
+            const float logSplit = cameraNear * std::pow(cameraFar / cameraNear, fraction);
+            const float uniformSplit = cameraNear + (cameraFar - cameraNear) * fraction;
+            const float sliceFar = splitLambda * logSplit + (1.f - splitLambda) * uniformSplit;
+
+            // ---- Bounding sphere of the slice, in world space ----
+            // A sphere does not change size as the camera turns, so neither does the cascade's texel size
+            glm::vec3 corners[8];
+            glm::vec3 center(0);
+            for (int i = 0; i < 4; i++) {
+                corners[i] = glm::vec3(invView * glm::vec4(nearCorners[i] * (sliceNear / cameraNear), 1));
+                corners[i + 4] = glm::vec3(invView * glm::vec4(nearCorners[i] * (sliceFar / cameraNear), 1));
+            }
+            for (const auto& corner : corners)
+                center += corner / 8.f;
+            float radius = 0.f;
+            for (const auto& corner : corners)
+                radius = std::max(radius, glm::length(corner - center));
+            radius = std::ceil(radius * 16.f) / 16.f;
+
+            // ---- Lightspace transform ----
+            const glm::mat4 view = glm::lookAt(center - direction * (radius + casterMargin), center, up);
+            glm::mat4 projection = glm::ortho(-radius, radius, -radius, radius, 0.f, 2.f * radius + casterMargin);
+            // Snap the world origin to a texel, so the map moves in whole texels as the camera moves and edges do not shimmer
+            const glm::vec4 origin = projection * view * glm::vec4(0, 0, 0, 1) * (map_size / 2.f);
+            const glm::vec4 offset = (glm::round(origin) - origin) * (2.f / map_size);
+            projection[3][0] += offset.x;
+            projection[3][1] += offset.y;
+
+            cascadeMatrices[c] = projection * view;
+            cascadeSplits[c] = sliceFar;
+            sliceNear = sliceFar;
+        }
     }
 
     // ======== PointLight ========
@@ -88,7 +135,6 @@ namespace Component {
         attenuationConstant = constant;
         attenuationLinear = linear;
         attenuationQuadratic = quadratic;
-        updateRadius();
     }
 
     void PointLight::EnableShadows(float aspect, float near, float far) {
@@ -117,11 +163,18 @@ namespace Component {
         lightspaceMatrices[5] = projection * glm::lookAt(position, position + Direction::back,  Direction::down);
     }
 
-    float PointLight::updateRadius() {
-        float lightMax = std::fmaxf(std::fmaxf(color.r, color.g), color.b);
-        radius = (-attenuationLinear + std::sqrtf(attenuationLinear * attenuationLinear - 4 * attenuationQuadratic * (attenuationConstant - (256.0 / 5.0) * lightMax))) 
-        / (2 * attenuationQuadratic);  
-        return radius;
+    float PointLight::Radius() const {
+        const glm::vec3 radiance = color * intensity;
+        const float lightMax = std::fmax(std::fmax(radiance.r, radiance.g), radiance.b);
+        // lightMax / attenuation(d) = 5/256, i.e. solve constant + linear*d + quadratic*d^2 = lightMax * 256/5 for d
+        const float c = attenuationConstant - (256.0f / 5.0f) * lightMax;
+        if (c >= 0.0f)
+            return 0.0f;
+        if (attenuationQuadratic > 0.0f)
+            return (-attenuationLinear + std::sqrt(attenuationLinear * attenuationLinear - 4 * attenuationQuadratic * c)) / (2 * attenuationQuadratic);
+        if (attenuationLinear > 0.0f)
+            return -c / attenuationLinear;
+        return std::numeric_limits<float>::max();
     }
 
 }
\ No newline at end of file
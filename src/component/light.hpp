@@ -37,23 +37,31 @@ namespace Component {
 
     class DirectionalLight : public Light {
         public:            
+            static constexpr int maxCascades = 4;
+
             DirectionalLight();
 
-            const glm::mat4& LightspaceMatrix() const;
+            // Per cascade, nearest first: lightspace transforms, and the view-space distance where each cascade ends
+            const std::vector<glm::mat4>& CascadeMatrices() const;
+            const std::vector<float>& CascadeSplits() const { return cascadeSplits; }
+            int CascadeCount() const { return cascadeCount; }
             
-            void EnableShadows(float width = 50.0f, float height = 50.0f, float near = 0.1f, float far = 50.0f, float dist = 20.0f);
+            // Shadows reach max_distance from the camera, split into cascade_count slices by a blend of logarithmic (split_lambda = 1)
+            // and uniform (0) spacing. Casters up to caster_margin beyond a slice's bounds, toward the light, are included.
+            void EnableShadows(float max_distance = 50.0f, int cascade_count = maxCascades, float split_lambda = 0.75f, float caster_margin = 20.0f);
             void Draw(const glm::mat4& parent_transform) override;
+            // Fits each cascade to its slice of the camera frustum. Needs the shadow map size to snap to whole texels.
+            void FitCascades(const glm::mat4& camera_view, const glm::mat4& camera_projection, int map_size);
             
             std::shared_ptr<ComponentBase> Duplicate() override {return nullptr;}
 
         private:
-            glm::mat4 lightspaceMatrix = glm::identity<glm::mat4>();
-            float projWidth = 50.0;
-            float projHeight = 50.0;
-            float distance = 20.0;
-            glm::vec3 lastDirection;
-
-            void updateLightspaceMatrix(const glm::vec3& direction);      
+            std::vector<glm::mat4> cascadeMatrices;
+            std::vector<float> cascadeSplits;
+            int cascadeCount = maxCascades;
+            float splitLambda = 0.75f;
+            float casterMargin = 20.0f;
+            glm::vec3 direction = glm::vec3(0,0,1);
     };
 
     class PointLight : public Light {
@@ -61,7 +69,10 @@ namespace Component {
             PointLight();
 
             const std::vector<glm::mat4>& LightspaceMatrices() const;
-            float Radius() const { return radius; }
+            // Distance at which the brightest channel of the attenuated radiance falls below 5/256, an absolute cutoff rather than
+            // one relative to the light's peak; used to bound its influence for culling. Lights too dim to ever exceed it (radiance
+            // below constant attenuation * 5/256) get a radius of 0 and are culled entirely.
+            float Radius() const;
             float AttenuationConstant() const { return attenuationConstant; }
             float AttenuationLinear() const { return attenuationLinear; }
             float AttenuationQuadratic() const { return attenuationQuadratic; }
@@ -75,14 +86,12 @@ namespace Component {
         private:
             std::vector<glm::mat4> lightspaceMatrices;
             float aspectRatio = 1.0f;
-            float radius = 5.0f;
             float attenuationConstant = 1.0f;       // Default range 50
             float attenuationLinear = 0.09f;        // Default range 50
             float attenuationQuadratic = 0.032f;    // Default range 50
             glm::vec3 lastPosition;
 
             void updateLightspaceMatrices(const glm::vec3& position);
-            float updateRadius();
     };
 
 }
\ No newline at end of file
@@ -42,6 +42,15 @@ namespace Component {
         // std::clog << "destroying Mesh" << std::endl;
     }
 
+    const Bounds::Aabb& Mesh::BoundingBox() const {
+        static const Bounds::Aabb empty;
+        return vao ? vao->BoundingBox() : empty;
+    }
+    const Bounds::Sphere& Mesh::BoundingSphere() const {
+        static const Bounds::Sphere empty;
+        return vao ? vao->BoundingSphere() : empty;
+    }
+
     void Mesh::Draw(const glm::mat4& model_matrix) {
         if (material)   // If no material assigned, just draw the raw VAO
             material->SetUniforms(model_matrix);
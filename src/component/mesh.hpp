@@ -24,6 +24,10 @@ namespace Component {
             std::shared_ptr<Core::Vao> vao;
             std::shared_ptr<Material::MaterialBase> material = Material::defaultMaterial;
 
+            // Object-space bounds, from the vertex data
+            const Bounds::Aabb& BoundingBox() const;
+            const Bounds::Sphere& BoundingSphere() const;
+
             virtual void Draw(const glm::mat4& model_matrix = glm::identity<glm::mat4>()) override;
             virtual void Draw(Material::MaterialBase& material, const glm::mat4& model_matrix = glm::identity<glm::mat4>()) override;
             virtual void Draw(Renderer::RenderModule& module, const glm::mat4& model_matrix = glm::identity<glm::mat4>()) override;
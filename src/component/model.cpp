@@ -50,17 +50,27 @@ namespace Component {
         instanceName = model->GetFile().Filename();
         model->AddUser(this);
         root = std::make_shared<ModelNode>(*this, model->Scene()->mRootNode, model->Scene());
+        collectMeshInstances();
     }
     Model::~Model() {}
     
     void Model::Draw(const glm::mat4& model_matrix) {
-        root->Draw(model_matrix);
+        updateWorldMatrices(model_matrix);
+        for (auto& instance : meshInstances) {
+            instance.mesh->Draw(instance.worldMatrix);
+        }
     }
     void Model::Draw(Material::MaterialBase& material, const glm::mat4& model_matrix) {
-        root->Draw(material, model_matrix);
+        updateWorldMatrices(model_matrix);
+        for (auto& instance : meshInstances) {
+            instance.mesh->Draw(material, instance.worldMatrix);
+        }
     }
     void Model::Draw(Renderer::RenderModule& module, const glm::mat4& model_matrix) {
-        root->Draw(module, model_matrix);
+        updateWorldMatrices(model_matrix);
+        for (auto& instance : meshInstances) {
+            instance.mesh->Draw(module, instance.worldMatrix);
+        }
     }
     
     void Model::DisplayWidget() {
@@ -68,8 +78,30 @@ namespace Component {
         ImGui::Text("%s", instanceName.c_str());
     }
 
+    const std::vector<MeshInstance>& Model::MeshInstances(const glm::mat4& model_matrix) {
+        updateWorldMatrices(model_matrix);
+        return meshInstances;
+    }
+
     void Model::AssetResyncCallback() {
         root = std::make_shared<ModelNode>(*this, model->Scene()->mRootNode, model->Scene());
+        collectMeshInstances();
+    }
+
+    void Model::collectMeshInstances() {
+        meshInstances.clear();
+        root->CollectMeshInstances(glm::identity<glm::mat4>(), meshInstances);
+        lastModelMatrix = glm::mat4(0);  // Force world matrices to be recomputed
+    }
+
+    void Model::updateWorldMatrices(const glm::mat4& model_matrix) {
+        // Passes within a frame draw with the same model matrix, so this only recomputes when the node moves
+        if (model_matrix == lastModelMatrix)
+            return;
+        for (auto& instance : meshInstances) {
+            instance.worldMatrix = model_matrix * instance.localMatrix;
+        }
+        lastModelMatrix = model_matrix;
     }
 
     void Model::printSceneInfo(const std::string& path, const aiScene *scene, const std::string& outpath) {            
@@ -187,6 +219,16 @@ namespace Component {
         }
     }
 
+    void ModelNode::CollectMeshInstances(const glm::mat4& parent_transform, std::vector<MeshInstance>& instances) {
+        const glm::mat4 model_matrix = parent_transform * transform.Matrix();
+        for (auto& mesh : meshes) {
+            instances.push_back({mesh, model_matrix, model_matrix});
+        }
+        for (auto& child : children) {
+            child->CollectMeshInstances(model_matrix, instances);
+        }
+    }
+
     std::shared_ptr<Mesh> ModelNode::processMesh(aiMesh* aimesh, const aiScene* scene) {
         std::vector<float> vertices;
         std::vector<unsigned int> indices;
@@ -235,9 +277,7 @@ namespace Component {
         }
         
         auto va = Core::Vertex::VertexArray(vertices, vertexAttrFlags);
-        auto vbo = std::make_shared<Core::Vbo>(va);
-        auto ebo = std::make_shared<Core::Ebo>(indices);
-        auto vao = std::make_shared<Core::Vao>(vbo, ebo);
+        auto vao = std::make_shared<Core::Vao>(va, indices);
         
         auto mesh = std::make_shared<Mesh>(vao);
         
@@ -31,6 +31,12 @@ namespace Component {
     };
 
     class ModelNode;
+
+    struct MeshInstance {
+        std::shared_ptr<Mesh> mesh;
+        glm::mat4 localMatrix;  // Relative to the model root
+        glm::mat4 worldMatrix;  // As of the last draw
+    };
         
     class Model : public ComponentBase, public AssetUser {
         public:
@@ -45,6 +51,9 @@ namespace Component {
             void Draw(Material::MaterialBase& material, const glm::mat4& model_matrix) override;
             void Draw(Renderer::RenderModule& module, const glm::mat4& model_matrix) override;
 
+            // Flattened meshes with world matrices for the given model matrix
+            const std::vector<MeshInstance>& MeshInstances(const glm::mat4& model_matrix);
+
             void AssetResyncCallback() override;
             
             virtual std::shared_ptr<ComponentBase> Duplicate() override { return nullptr; } // future
@@ -53,6 +62,12 @@ namespace Component {
             void DisplayWidget() override;
 
         private:
+            // Meshes of the whole node hierarchy, flattened so draws do not re-walk the tree or re-multiply transforms per pass
+            std::vector<MeshInstance> meshInstances;
+            glm::mat4 lastModelMatrix = glm::mat4(0);
+
+            void collectMeshInstances();
+            void updateWorldMatrices(const glm::mat4& model_matrix);
             void printSceneInfo(const std::string& path, const aiScene *scene, const std::string& outpath = "");
     };
 
@@ -69,6 +84,9 @@ namespace Component {
             void Draw(Material::MaterialBase& material, const glm::mat4& parent_transform) override;
             void Draw(Renderer::RenderModule& module, const glm::mat4& parent_transform) override;
 
+            // Appends this node's and its descendants' meshes with their transforms relative to the model root
+            void CollectMeshInstances(const glm::mat4& parent_transform, std::vector<MeshInstance>& instances);
+
             std::shared_ptr<ComponentBase> Duplicate() override {return nullptr;}
         
         private:
@@ -28,9 +28,22 @@ namespace Component {
         vao->Draw();
     }
 
+    std::shared_ptr<Core::Vao> Primitive::sharedGeometry(GeometryCache& cache, GeometryKey key, std::shared_ptr<Core::Vao> (*build)(int, int)) {
+        std::weak_ptr<Core::Vao>& entry = cache[key];
+        std::shared_ptr<Core::Vao> geometry = entry.lock();
+        if (!geometry) {
+            geometry = build(key.first, key.second);
+            entry = geometry;
+        }
+        return geometry;
+    }
+
     Cube::Cube(int nrows, int ncols) : nRows(nrows), nCols(ncols) {
         typeName = "Mesh - Cube";
+        vao = sharedGeometry(geometryCache, {nrows, ncols}, buildGeometry);
+    }
 
+    std::shared_ptr<Core::Vao> Cube::buildGeometry(int nrows, int ncols) {
         const std::vector<float> cubedata = {
             // Positions           // Normals           // UV                    // Tangents
             -0.5f, -0.5f, -0.5f,   0.0f,  0.0f, -1.0f,        0.0f,       0.0f,  1.0f, 0.0f, 0.0f,
@@ -78,13 +91,15 @@ namespace Component {
         using namespace Core;
 
         Vertex::VertexArray va(cubedata, Vertex::AttrFlags::Default3D ^ Vertex::AttrFlags::Bitangent);
-        auto vbo = std::make_shared<Vbo>(va);
-        vao = std::make_shared<Vao>(vbo);
+        return std::make_shared<Vao>(va);
     }
     
     Sphere::Sphere(int nstacks, int nsectors) : nStacks(nstacks), nSectors(nsectors) {
         typeName = "Mesh - Sphere";
+        vao = sharedGeometry(geometryCache, {nstacks, nsectors}, buildGeometry);
+    }
 
+    std::shared_ptr<Core::Vao> Sphere::buildGeometry(int nstacks, int nsectors) {
         using namespace Core;
         
         Vertex::VertexArray::UncollatedVertices verts;
@@ -173,14 +188,15 @@ namespace Component {
             }
         }
         
-        auto vbo = std::make_shared<Vbo>(verts);
-        auto ebo = std::make_shared<Ebo>(indices);
-        vao = std::make_shared<Vao>(vbo, ebo);
+        return std::make_shared<Vao>(Vertex::VertexArray(verts), indices);
     }
     
     Plane::Plane(int nrows, int ncols) : nRows(nrows), nCols(ncols) {
         typeName = "Mesh - Plane";
+        vao = sharedGeometry(geometryCache, {nrows, ncols}, buildGeometry);
+    }
 
+    std::shared_ptr<Core::Vao> Plane::buildGeometry(int nrows, int ncols) {
         const std::vector<float> rectdata = {    // Remember CCW (x-z vs x-y)
             // Positions         // Normals         // UV                        // Tangents
             -0.5f, 0.0f, -0.5f,  0.0f, 1.0f, 0.0f,          0.0f,         0.0f,  1.0f, 0.0f, 0.0f,
@@ -194,8 +210,7 @@ namespace Component {
         using namespace Core;
 
         Vertex::VertexArray va(rectdata, Vertex::AttrFlags::Default3D ^ Vertex::AttrFlags::Bitangent);
-        auto vbo = std::make_shared<Vbo>(va);
-        vao = std::make_shared<Vao>(vbo);
+        return std::make_shared<Vao>(va);
     }
 
 }
\ No newline at end of file
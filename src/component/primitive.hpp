@@ -2,6 +2,10 @@
 
 #include "component/mesh.hpp"
 
+#include <map>
+#include <memory>
+#include <utility>
+
 namespace Component {
 
     class Primitive : public Mesh {
@@ -10,6 +14,11 @@ namespace Component {
             static void DrawQuad();
         protected:
             Primitive();
+
+            // Primitives built with the same parameters share one VAO, which lives as long as any of them does
+            using GeometryKey = std::pair<int, int>;
+            using GeometryCache = std::map<GeometryKey, std::weak_ptr<Core::Vao>>;
+            static std::shared_ptr<Core::Vao> sharedGeometry(GeometryCache& cache, GeometryKey key, std::shared_ptr<Core::Vao> (*build)(int, int));
     };
 
     class Cube : public Primitive {
@@ -17,6 +26,8 @@ namespace Component {
             Cube(int nrows = 1, int ncols = 1);
         private:
             int nRows, nCols;
+            inline static GeometryCache geometryCache;
+            static std::shared_ptr<Core::Vao> buildGeometry(int nrows, int ncols);
     };
 
     class Sphere : public Primitive  {
@@ -24,6 +35,8 @@ namespace Component {
             Sphere(int nstacks = 30, int nsectors = 30);
         private:
             int nStacks, nSectors;
+            inline static GeometryCache geometryCache;
+            static std::shared_ptr<Core::Vao> buildGeometry(int nstacks, int nsectors);
     };
 
     class Plane : public Primitive {
@@ -31,6 +44,8 @@ namespace Component {
             Plane(int nrows = 1, int ncols = 1);
         private:
             int nRows, nCols;
+            inline static GeometryCache geometryCache;
+            static std::shared_ptr<Core::Vao> buildGeometry(int nrows, int ncols);
     };
 
 }
\ No newline at end of file
@@ -3,6 +3,9 @@
 #include "demo/demo.hpp"
 #include "interface/interface.hpp"
 #include "asset/manager.hpp"
+#include "core/glstate.hpp"
+#include "renderer/profiler.hpp"
+#include "renderer/rendertargetpool.hpp"
 #include "util/time.hpp"
 
 #include <iostream>
@@ -49,6 +52,8 @@ namespace Context {
         }
         
         InputsAndEventsManager::Setup(activeWindow.get());
+        eventListener = InputsAndEventsManager::CreateEventListener();
+        eventListener->SetKeyCallback(std::bind(&Application::keyCallback, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4));
         Time::Update();
         Interface::Initialize(*activeWindow);
         Material::defaultMaterial = std::static_pointer_cast<Material::MaterialBase>(std::make_shared<Material::PBRMetallicMaterial>());
@@ -66,26 +71,49 @@ namespace Context {
     }
 
     void Application::display() {
+        Renderer::Profiler& profiler = Renderer::Profiler::Instance();
+        profiler.BeginCpu("Events");
         InputsAndEventsManager::PollEvents();
+        profiler.EndCpu();
         Time::Update();
         static float syncCooldown = 1.f;
         if ((syncCooldown -= Time::DeltaTime()) <= 0.f) {
+            Renderer::Profiler::CpuScope scope("Asset sync");
             AssetManager::Instance().HotSyncWithDevice();
             syncCooldown = 1.f;
         }
         Interface::BeginFrame();
 
+        profiler.BeginCpu("Scene");
         activeDemo->DisplayScene();
+        profiler.EndCpu();
         
+        profiler.BeginCpu("GUI");
         if (guiHeader()) {
             activeDemo->DisplayGui();
             guiFooter();
         }
-        
+        profiler.BeginGpu("GUI");
         Interface::RenderFrame();
+        profiler.EndGpu();
+        profiler.EndCpu();
+
+        profiler.EndFrame();
+        Renderer::RenderTargetPool::Instance().EndFrame();
+        // The GUI backend sets GL state directly
+        Core::GlState::Instance().EndFrame();
         activeWindow->SwapBuffers();
     }
 
+    void Application::CaptureTrace(int frames, const std::string& path) {
+        Renderer::Profiler::Instance().CaptureTrace(frames, path);
+    }
+
+    void Application::keyCallback(int key, int, int action, int) {
+        if (key == GLFW_KEY_F12 && action == GLFW_PRESS)
+            CaptureTrace(traceFrames);
+    }
+
     bool Application::guiHeader() {
         if (!ImGui::Begin(activeWindow->Title().c_str(), NULL, ImGuiWindowFlags_MenuBar | ImGuiWindowFlags_NoMove | ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoSavedSettings)) {
             ImGui::End();
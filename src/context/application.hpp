@@ -1,11 +1,13 @@
 #pragma once
 
+#include "context/inputsevents.hpp"
 #include "context/window.hpp"
 
 #include <glad/gl.h>
 #include <GLFW/glfw3.h>
 
 #include <memory>
+#include <string>
 
 class Demo;
 
@@ -26,8 +28,17 @@ namespace Context {
 
             void Run();
 
+            // Records a timeline of the next frames: event polling, asset syncing and loads, the scene, each render pass
+            // and the GUI, on the CPU and GPU. Written to path as Chrome trace event JSON, for chrome://tracing or Perfetto.
+            void CaptureTrace(int frames, const std::string& path = "trace.json");
+            // Captured by pressing F12
+            int traceFrames = 120;
+
         private:
             Application();
+
+            std::shared_ptr<EventListener> eventListener;
+            void keyCallback(int key, int scancode, int action, int mods);
             
             void display();
 
@@ -1,12 +1,26 @@
 #include "core/globject.hpp"
 #include "core/attribute.hpp"
+#include "core/glstate.hpp"
 
 #include <glad/gl.h>
 
+#include <algorithm>
 #include <iostream>
+#include <limits>
+#include <numeric>
 #include <vector>
 
 namespace Core {
+
+    namespace {
+        // Positions always come first in a vertex
+        void computeBounds(const Vertex::VertexArray& varray, Bounds::Aabb& box, Bounds::Sphere& sphere) {
+            const int ncomps = varray.HasAttributes(Vertex::AttrFlags::Position3) ? 3 : 2;
+            const int strideFloats = varray.Stride() / sizeof(float);
+            box = Bounds::Aabb::FromPoints(varray.Data().data(), varray.VertexCount(), strideFloats, ncomps);
+            sphere = Bounds::Sphere::FromPoints(varray.Data().data(), varray.VertexCount(), strideFloats, ncomps, box);
+        }
+    }
     
     GLuint GlObject::Handle() const {
         return handle;
@@ -19,6 +33,8 @@ namespace Core {
     Vbo::Vbo(const Vertex::VertexArray& varray) 
         : vertexArray(varray) 
     {
+        computeBounds(vertexArray, boundingBox, boundingSphere);
+
         glGenBuffers(1, &handle);
         Bind();
         // Create vertex data store
@@ -27,13 +43,13 @@ namespace Core {
     }
     Vbo::~Vbo() {
         // std::clog << "destroying Vbo" << std::endl;
-        glDeleteBuffers(1, &handle);
+        GlState::Instance().DeleteBuffer(handle);
     }
     void Vbo::Bind() {
-        glBindBuffer(GL_ARRAY_BUFFER, handle);
+        GlState::Instance().BindBuffer(GL_ARRAY_BUFFER, handle);
     }
     void Vbo::Unbind() {
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        GlState::Instance().BindBuffer(GL_ARRAY_BUFFER, 0);
     }
 
     // Element (index) array buffer
@@ -47,14 +63,196 @@ namespace Core {
         Unbind();
     }
     void Ebo::Bind() {
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, handle);
+        GlState::Instance().BindBuffer(GL_ELEMENT_ARRAY_BUFFER, handle);
     }
     void Ebo::Unbind() {
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        GlState::Instance().BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
     }
     Ebo::~Ebo() {
         // std::clog << "destroying Ebo" << std::endl;
-        glDeleteBuffers(1, &handle);
+        GlState::Instance().DeleteBuffer(handle);
+    }
+
+    // Geometry arena
+    std::shared_ptr<GeometryArena> GeometryArena::ForLayout(Vertex::AttrFlags attributes) {
+        std::weak_ptr<GeometryArena>& entry = arenas[attributes];
+        std::shared_ptr<GeometryArena> arena = entry.lock();
+        if (!arena) {
+            arena = std::make_shared<GeometryArena>(attributes);
+            entry = arena;
+        }
+        return arena;
+    }
+    bool GeometryArena::MultiDrawSupported() {
+        return GLAD_GL_VERSION_4_3;
+    }
+    void GeometryArena::ReserveInstances(size_t count) {
+        if (!MultiDrawSupported() || count <= instanceIdCount)
+            return;
+        instanceIdCount = std::max(count, 2 * instanceIdCount);
+        std::vector<GLuint> ids(instanceIdCount);
+        std::iota(ids.begin(), ids.end(), 0);
+        if (!instanceIdBuffer)
+            glGenBuffers(1, &instanceIdBuffer);
+        GlState::Instance().BindBuffer(GL_ARRAY_BUFFER, instanceIdBuffer);
+        glBufferData(GL_ARRAY_BUFFER, ids.size() * sizeof(GLuint), ids.data(), GL_STATIC_DRAW);
+        GlState::Instance().BindBuffer(GL_ARRAY_BUFFER, 0);
+        // Orphaned the old store, so every live arena has to point at the new one
+        for (auto& [attributes, entry] : arenas) {
+            if (auto arena = entry.lock()) {
+                arena->Bind();
+                arena->setInstanceIdFormat();
+                arena->Unbind();
+            }
+        }
+    }
+    void GeometryArena::SetFirstInstance(GLuint first_instance) {
+        ReserveInstances(first_instance + 1);
+        firstInstance = first_instance;
+    }
+    GeometryArena::GeometryArena(Vertex::AttrFlags attributes)
+        : attributes(attributes),
+        stride(Vertex::VertexArray({}, attributes).Stride())
+    {
+        glGenVertexArrays(1, &handle);
+        glGenBuffers(1, &vertexBuffer);
+        glGenBuffers(1, &indexBuffer);
+        reserve(1 << 16, 1 << 16);
+    }
+    GeometryArena::~GeometryArena() {
+        GlState::Instance().DeleteBuffer(indexBuffer);
+        GlState::Instance().DeleteBuffer(vertexBuffer);
+        GlState::Instance().DeleteVertexArray(handle);
+    }
+    void GeometryArena::Bind() {
+        GlState::Instance().BindVertexArray(handle);
+    }
+    void GeometryArena::Unbind() {
+        GlState::Instance().BindVertexArray(0);
+    }
+    void GeometryArena::MultiDrawIndirect(size_t first_command, GLsizei command_count) {
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void *)(first_command * sizeof(DrawCommand)), command_count, 0);
+    }
+    GeometryArena::Range GeometryArena::Allocate(const Vertex::VertexArray& varray, const std::vector<unsigned int>& indices) {
+        if (varray.AttributeFlags() != attributes)
+            throw std::runtime_error("Vertex layout does not match the geometry arena's!");
+
+        std::vector<unsigned int> sequential;
+        if (indices.empty()) {
+            sequential.resize(varray.VertexCount());
+            std::iota(sequential.begin(), sequential.end(), 0);
+        }
+        const std::vector<unsigned int>& rangeIndices = indices.empty() ? sequential : indices;
+
+        Range range;
+        range.vertexCount = varray.VertexCount();
+        range.indexCount = rangeIndices.size();
+        range.baseVertex = vertexBlocks.Allocate(range.vertexCount);
+        range.firstIndex = indexBlocks.Allocate(range.indexCount);
+        reserve(vertexBlocks.end, indexBlocks.end);
+
+        GlState::Instance().BindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        glBufferSubData(GL_ARRAY_BUFFER, range.baseVertex * stride, varray.Size(), varray.Data().data());
+        GlState::Instance().BindBuffer(GL_ARRAY_BUFFER, 0);
+        GlState::Instance().BindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, range.firstIndex * sizeof(unsigned int), range.indexCount * sizeof(unsigned int), rangeIndices.data());
+        GlState::Instance().BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        return range;
+    }
+    void GeometryArena::Free(const Range& range) {
+        vertexBlocks.Free(range.baseVertex, range.vertexCount);
+        indexBlocks.Free(range.firstIndex, range.indexCount);
+    }
+    void GeometryArena::reserve(size_t vertex_count, size_t index_count) {
+        // Grow geometrically, copying the old contents on the GPU
+        const auto grow = [](GLuint& buffer, size_t& capacity, size_t count, size_t element_size) {
+            if (count <= capacity)
+                return false;
+            const size_t newCapacity = std::max(count, 2 * capacity);
+            GLuint newBuffer;
+            glGenBuffers(1, &newBuffer);
+            GlState::Instance().BindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+            glBufferData(GL_COPY_WRITE_BUFFER, newCapacity * element_size, NULL, GL_STATIC_DRAW);
+            if (capacity > 0) {
+                GlState::Instance().BindBuffer(GL_COPY_READ_BUFFER, buffer);
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, capacity * element_size);
+                GlState::Instance().BindBuffer(GL_COPY_READ_BUFFER, 0);
+            }
+            GlState::Instance().BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            GlState::Instance().DeleteBuffer(buffer);
+            buffer = newBuffer;
+            capacity = newCapacity;
+            return true;
+        };
+        const bool grewVertices = grow(vertexBuffer, vertexCapacity, vertex_count, stride);
+        const bool grewIndices = grow(indexBuffer, indexCapacity, index_count, sizeof(unsigned int));
+        if (!grewVertices && !grewIndices)
+            return;
+        Bind();
+        GlState::Instance().BindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        setAttribPointerFormat();
+        GlState::Instance().BindBuffer(GL_ARRAY_BUFFER, 0);
+        GlState::Instance().BindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+        setInstanceIdFormat();
+        Unbind();
+    }
+    void GeometryArena::setAttribPointerFormat() {
+        const Vertex::VertexArray layout({}, attributes);
+        for (const auto& attr : Vertex::Attributes) {
+            if (layout.HasAttributes(attr.flag)) {
+                glEnableVertexAttribArray(attr.index);
+                glVertexAttribPointer(attr.index, attr.ncomps, GL_FLOAT, GL_FALSE, stride, (void *)(layout.AttributeOffset(attr.flag)));
+            }
+        }
+    }
+    void GeometryArena::setInstanceIdFormat() {
+        // A divisor no instance count reaches makes every instance of a draw read element base_instance
+        if (!instanceIdBuffer)
+            return;
+        GlState::Instance().BindBuffer(GL_ARRAY_BUFFER, instanceIdBuffer);
+        glEnableVertexAttribArray(5);   // Renderer::DrawDataBuffer::firstInstanceLocation
+        glVertexAttribIPointer(5, 1, GL_UNSIGNED_INT, 0, (void *)0);
+        glVertexAttribDivisor(5, std::numeric_limits<GLuint>::max());
+        GlState::Instance().BindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    size_t GeometryArena::FreeList::Allocate(size_t size) {
+        for (auto it = blocks.begin(); it != blocks.end(); it++) {
+            if (it->second < size)
+                continue;
+            const size_t offset = it->first;
+            const size_t remaining = it->second - size;
+            blocks.erase(it);
+            if (remaining > 0)
+                blocks.emplace(offset + size, remaining);
+            return offset;
+        }
+        const size_t offset = end;
+        end += size;
+        return offset;
+    }
+    void GeometryArena::FreeList::Free(size_t offset, size_t size) {
+        if (size == 0)
+            return;
+        auto next = blocks.lower_bound(offset);
+        // Merge with the following block
+        if (next != blocks.end() && offset + size == next->first) {
+            size += next->second;
+            next = blocks.erase(next);
+        }
+        // Merge with the preceding block
+        if (next != blocks.begin()) {
+            auto prev = std::prev(next);
+            if (prev->first + prev->second == offset) {
+                offset = prev->first;
+                size += prev->second;
+                blocks.erase(prev);
+            }
+        }
+        // Give the tail back to the untouched region
+        if (offset + size == end)
+            end = offset;
+        else
+            blocks.emplace(offset, size);
     }
 
     // Vertex array
@@ -63,7 +261,10 @@ namespace Core {
     {}
     Vao::Vao(std::shared_ptr<Vbo> vb, std::shared_ptr<Ebo> eb) 
         : vbo(std::move(vb)), 
-        ebo(std::move(eb)) 
+        ebo(std::move(eb)),
+        boundingBox(vbo->boundingBox),
+        boundingSphere(vbo->boundingSphere),
+        id(nextId++)
     {
         glGenVertexArrays(1, &handle);
         Bind();
@@ -73,22 +274,47 @@ namespace Core {
             ebo->Bind();
         Unbind();
     }
+    Vao::Vao(const Vertex::VertexArray& varray, const std::vector<unsigned int>& indices)
+        : arena(GeometryArena::ForLayout(varray.AttributeFlags())),
+        id(nextId++)
+    {
+        computeBounds(varray, boundingBox, boundingSphere);
+        range = arena->Allocate(varray, indices);
+        handle = arena->Handle();
+    }
     Vao::~Vao() {
         // std::clog << "destroying Vao" << std::endl;
-        glDeleteVertexArrays(1, &handle);
+        if (arena)
+            arena->Free(range);
+        else
+            GlState::Instance().DeleteVertexArray(handle);
     }
     void Vao::Bind() {
-        glBindVertexArray(handle);
+        GlState::Instance().BindVertexArray(handle);
     }
     void Vao::Unbind() {
-        glBindVertexArray(0);
+        GlState::Instance().BindVertexArray(0);
+    }
+    GeometryArena::DrawCommand Vao::MakeDrawCommand(GLuint instance_count, GLuint base_instance) const {
+        return {static_cast<GLuint>(range.indexCount), instance_count, range.firstIndex, range.baseVertex, base_instance};
     }
     void Vao::Draw() {
         Bind();
-        if (ebo) {
-            glDrawElements(GL_TRIANGLES, ebo->indices.size(), GL_UNSIGNED_INT, (void *)0);
+        DrawBound();
+    }
+    void Vao::DrawBound() {
+        DrawInstancedBound(1);
+    }
+    void Vao::DrawInstancedBound(int instance_count) {
+        if (arena && GeometryArena::MultiDrawSupported()) {
+            // The arena's instance ID buffer, not the constant attribute, carries first_instance here
+            glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, range.indexCount, GL_UNSIGNED_INT, (void *)(range.firstIndex * sizeof(unsigned int)), instance_count, range.baseVertex, GeometryArena::FirstInstance());
+        } else if (arena) {
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.indexCount, GL_UNSIGNED_INT, (void *)(range.firstIndex * sizeof(unsigned int)), instance_count, range.baseVertex);
+        } else if (ebo) {
+            glDrawElementsInstanced(GL_TRIANGLES, ebo->indices.size(), GL_UNSIGNED_INT, (void *)0, instance_count);
         } else {
-            glDrawArrays(GL_TRIANGLES, 0, vbo->vertexArray.VertexCount());
+            glDrawArraysInstanced(GL_TRIANGLES, 0, vbo->vertexArray.VertexCount(), instance_count);
         }
     }
     void Vao::setAttribPointerFormat() {
@@ -107,23 +333,219 @@ namespace Core {
         glGenBuffers(1, &handle);
         Bind();
         glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
-        glBindBufferBase(GL_UNIFORM_BUFFER, index, handle);
+        GlState::Instance().BindBufferBase(GL_UNIFORM_BUFFER, index, handle);
         Unbind();
     }
     Ubo::~Ubo() {
         // std::clog << "destroying Ubo" << std::endl;
-        glDeleteBuffers(1, &handle);
+        GlState::Instance().DeleteBuffer(handle);
     }
     void Ubo::Bind() {
-        glBindBuffer(GL_UNIFORM_BUFFER, handle);
+        GlState::Instance().BindBuffer(GL_UNIFORM_BUFFER, handle);
     }
     void Ubo::Unbind() {
-        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        GlState::Instance().BindBuffer(GL_UNIFORM_BUFFER, 0);
     }
     void Ubo::UpdateData(unsigned int offset, size_t size, const void* data) {
+        // Left bound; GlState skips the bind for the next update
         Bind();
         glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
-        Unbind();
+    }
+    void Ubo::BindBase(unsigned int index) {
+        GlState::Instance().BindBufferBase(GL_UNIFORM_BUFFER, index, handle);
+    }
+
+    // Frame ring of uniform buffer regions
+    UboRing::UboRing(size_t frame_size, int num_frames)
+        : numFrames(num_frames),
+        fences(num_frames, nullptr)
+    {
+        target = GL_UNIFORM_BUFFER;
+        GLint offsetAlignment;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+        alignment = std::max(offsetAlignment, 1);
+        frameSize = (frame_size + alignment - 1) / alignment * alignment;
+        glGenBuffers(1, &handle);
+        allocateStorage();
+    }
+    UboRing::~UboRing() {
+        for (GLsync fence : fences) {
+            if (fence)
+                glDeleteSync(fence);
+        }
+        GlState::Instance().DeleteBuffer(handle);
+    }
+    void UboRing::Bind() {
+        GlState::Instance().BindBuffer(GL_UNIFORM_BUFFER, handle);
+    }
+    void UboRing::Unbind() {
+        GlState::Instance().BindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+    void UboRing::BeginFrame() {
+        frame = (frame + 1) % numFrames;
+        if (GLsync fence = fences[frame]) {
+            // Normally long signaled; only blocks if the CPU is numFrames ahead of the GPU
+            while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED);
+            glDeleteSync(fence);
+            fences[frame] = nullptr;
+        }
+        staging.clear();
+        flushed = 0;
+        bindings.clear();
+    }
+    void UboRing::EndFrame() {
+        fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    size_t UboRing::Allocate(size_t size) {
+        const size_t offset = (staging.size() + alignment - 1) / alignment * alignment;
+        staging.resize(offset + size);
+        return offset;
+    }
+    size_t UboRing::Write(const void* data, size_t size) {
+        const size_t offset = Allocate(size);
+        std::copy_n(static_cast<const unsigned char*>(data), size, staging.begin() + offset);
+        return offset;
+    }
+    void UboRing::Flush() {
+        Bind();
+        if (staging.size() > frameSize) {
+            // Out of room: grow every region. The old store is orphaned, so this frame's data is uploaded again and re-bound.
+            while (frameSize < staging.size())
+                frameSize *= 2;
+            allocateStorage();
+            for (GLsync& fence : fences) {
+                if (fence)
+                    glDeleteSync(fence);
+                fence = nullptr;
+            }
+            flushed = 0;
+            for (GLuint index = 0; index < bindings.size(); index++) {
+                if (bindings[index].size > 0)
+                    GlState::Instance().BindBufferRange(GL_UNIFORM_BUFFER, index, handle, frame * frameSize + bindings[index].offset, bindings[index].size);
+            }
+        }
+        if (staging.size() > flushed) {
+            // Nothing in this part of the region has been used yet this frame, and the fence covered last use, so skip synchronization
+            void* dst = glMapBufferRange(GL_UNIFORM_BUFFER, frame * frameSize + flushed, staging.size() - flushed,
+                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+            if (dst) {
+                std::copy(staging.begin() + flushed, staging.end(), static_cast<unsigned char*>(dst));
+                glUnmapBuffer(GL_UNIFORM_BUFFER);
+            }
+            flushed = staging.size();
+        }
+    }
+    void UboRing::BindRange(GLuint index, size_t offset, size_t size) {
+        GlState::Instance().BindBufferRange(GL_UNIFORM_BUFFER, index, handle, frame * frameSize + offset, size);
+        if (index >= bindings.size())
+            bindings.resize(index + 1);
+        bindings[index] = {offset, size};
+    }
+    void UboRing::allocateStorage() {
+        // Left bound, since Flush() maps the buffer right after growing it
+        Bind();
+        glBufferData(GL_UNIFORM_BUFFER, numFrames * frameSize, NULL, GL_STREAM_DRAW);
+    }
+
+    // Texture buffer
+    Tbo::Tbo(GLenum internalformat)
+        : internalformat(internalformat)
+    {
+        target = GL_TEXTURE_BUFFER;
+        glGenBuffers(1, &handle);
+        glGenTextures(1, &texture);
+        // Allocate a minimal data store so the texture is always complete
+        UpdateData(16, nullptr);
+        GlState::Instance().BindTexture(GL_TEXTURE_BUFFER, texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, internalformat, handle);
+        GlState::Instance().BindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+    Tbo::~Tbo() {
+        // std::clog << "destroying Tbo" << std::endl;
+        GlState::Instance().DeleteTexture(texture);
+        GlState::Instance().DeleteBuffer(handle);
+    }
+    void Tbo::Bind() {
+        GlState::Instance().BindTexture(GL_TEXTURE_BUFFER, texture);
+    }
+    void Tbo::Bind(int texunit) {
+        GlState::Instance().BindTexture(texunit, GL_TEXTURE_BUFFER, texture);
+    }
+    void Tbo::Unbind() {
+        GlState::Instance().BindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+    void Tbo::UpdateData(size_t size, const void* data) {
+        GlState::Instance().BindBuffer(GL_TEXTURE_BUFFER, handle);
+        // Grow geometrically so a growing data set does not reallocate every frame
+        if (size > capacity)
+            capacity = std::max(size, 2 * capacity);
+        // Orphan the old store so the driver does not have to wait on in-flight draws
+        glBufferData(GL_TEXTURE_BUFFER, capacity, NULL, GL_STREAM_DRAW);
+        if (data && size > 0)
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+    }
+    void Tbo::UpdateSubData(size_t offset, size_t size, const void* data) {
+        if (offset + size > capacity)
+            throw std::runtime_error("Tbo::UpdateSubData() range is outside the data store");
+        GlState::Instance().BindBuffer(GL_TEXTURE_BUFFER, handle);
+        glBufferSubData(GL_TEXTURE_BUFFER, offset, size, data);
+    }
+
+    // Draw indirect buffer
+    Dibo::Dibo() {
+        target = GL_DRAW_INDIRECT_BUFFER;
+        glGenBuffers(1, &handle);
+    }
+    Dibo::~Dibo() {
+        GlState::Instance().DeleteBuffer(handle);
+    }
+    void Dibo::Bind() {
+        GlState::Instance().BindBuffer(GL_DRAW_INDIRECT_BUFFER, handle);
+    }
+    void Dibo::Unbind() {
+        GlState::Instance().BindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+    void Dibo::UpdateData(size_t size, const void* data) {
+        Bind();
+        if (size > capacity)
+            capacity = std::max(size, 2 * capacity);
+        // Orphan the old store so the driver does not have to wait on in-flight draws
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, capacity, NULL, GL_STREAM_DRAW);
+        if (data && size > 0)
+            glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, size, data);
+        // Left bound for the indirect draws that follow
+    }
+
+    // Query
+    Query::Query(GLenum target) {
+        this->target = target;
+        glGenQueries(1, &handle);
+    }
+    Query::~Query() {
+        glDeleteQueries(1, &handle);
+    }
+    void Query::Bind() {
+        glBeginQuery(target, handle);
+    }
+    void Query::Unbind() {
+        glEndQuery(target);
+        issued = true;
+    }
+    void Query::Stamp() {
+        glQueryCounter(handle, GL_TIMESTAMP);
+        issued = true;
+    }
+    bool Query::ResultAvailable() const {
+        if (!issued)
+            return false;
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(handle, GL_QUERY_RESULT_AVAILABLE, &available);
+        return available == GL_TRUE;
+    }
+    GLuint64 Query::Result() const {
+        GLuint64 result = 0;
+        glGetQueryObjectui64v(handle, GL_QUERY_RESULT, &result);
+        return result;
     }
 
     // Renderbuffer
@@ -135,14 +557,14 @@ namespace Core {
     }
     Rbo::~Rbo() {
         // std::clog << "destroying Rbo" << std::endl;
-        glDeleteRenderbuffers(1, &handle);
+        GlState::Instance().DeleteRenderbuffer(handle);
     }
     void Rbo::Bind() {
-        glViewport(0, 0, width, height);
-        glBindRenderbuffer(GL_RENDERBUFFER, handle);
+        GlState::Instance().Viewport(0, 0, width, height);
+        GlState::Instance().BindRenderbuffer(handle);
     }
     void Rbo::Unbind() {
-        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        GlState::Instance().BindRenderbuffer(0);
     }
     void Rbo::Setup16() {
         internalformat = GL_DEPTH_COMPONENT16;
@@ -171,26 +593,29 @@ namespace Core {
     }
     Fbo::~Fbo() {
         // std::clog << "destroying Fbo" << std::endl;
-        glDeleteFramebuffers(1, &handle);
+        GlState::Instance().DeleteFramebuffer(handle);
     }
     void Fbo::Bind() {
-        glViewport(0, 0, width, height);
-        glBindFramebuffer(GL_FRAMEBUFFER, handle);
+        GlState::Instance().Viewport(0, 0, width, height);
+        GlState::Instance().BindFramebuffer(GL_FRAMEBUFFER, handle);
     }
     void Fbo::Unbind() {
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        GlState::Instance().BindFramebuffer(GL_FRAMEBUFFER, 0);
     }
     void Fbo::SetViewportDims() {
-        glViewport(0, 0, width, height);
+        GlState::Instance().Viewport(0, 0, width, height);
     }
     void Fbo::ClearColor() {
         ClearColor(0.f,0.f,0.f,1.f);
     }
     void Fbo::ClearColor(float r, float g, float b, float a) {
+        GlState::Instance().ColorMask(true);
         glClearColor(r,g,b,a);
         glClear(GL_COLOR_BUFFER_BIT);
     }
     void Fbo::ClearDepth() {
+        // Clears are masked like any other depth write
+        GlState::Instance().DepthMask(true);
         glClear(GL_DEPTH_BUFFER_BIT);
     }
     void Fbo::AttachColorTex(std::shared_ptr<Tex> tex, int index, int level) {
@@ -267,8 +692,8 @@ namespace Core {
         mask |= GL_COLOR_BUFFER_BIT * color;
         mask |= GL_DEPTH_BUFFER_BIT * depth;
         
-        glBindFramebuffer(GL_READ_FRAMEBUFFER, handle);
-        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target.handle);
+        GlState::Instance().BindFramebuffer(GL_READ_FRAMEBUFFER, handle);
+        GlState::Instance().BindFramebuffer(GL_DRAW_FRAMEBUFFER, target.handle);
         glReadBuffer(GL_COLOR_ATTACHMENT0 + source_buffer_idx);
         glDrawBuffer(GL_COLOR_ATTACHMENT0 + target_buffer_idx);
         glBlitFramebuffer(0, 0, width, height, 0, 0, target.width, target.height, mask, GL_NEAREST);   // Internal formats need to match!
@@ -278,8 +703,8 @@ namespace Core {
         mask |= GL_COLOR_BUFFER_BIT * color;
         mask |= GL_DEPTH_BUFFER_BIT * depth;
 
-        glBindFramebuffer(GL_READ_FRAMEBUFFER, handle);
-        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        GlState::Instance().BindFramebuffer(GL_READ_FRAMEBUFFER, handle);
+        GlState::Instance().BindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
         glReadBuffer(GL_COLOR_ATTACHMENT0 + source_buffer_idx);
         glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, mask, GL_NEAREST);   // Internal formats need to match!
     }
@@ -2,10 +2,13 @@
 
 #include "core/vertex.hpp"
 #include "core/tex.hpp"
+#include "util/bounds.hpp"
 
 #include <glad/gl.h>
 
+#include <map>
 #include <memory>
+#include <vector>
 
 namespace Core {
 
@@ -34,6 +37,9 @@ namespace Core {
             Vbo& operator=(Vbo&& other) = delete;
 
             Vertex::VertexArray vertexArray;
+            // Object-space bounds of the vertex positions
+            Bounds::Aabb boundingBox;
+            Bounds::Sphere boundingSphere;
             
             void Bind() override;
             void Unbind() override;
@@ -55,10 +61,92 @@ namespace Core {
             void Unbind() override;
     };
 
+    // One VBO and EBO shared by every mesh with the same vertex layout, and a VAO (the handle) over them, so that
+    // meshes can be drawn back to back, or in one multi-draw, without rebinding.
+    // Meshes own a Range, allocated first fit from free lists and returned when the mesh is destroyed.
+    class GeometryArena : public GlObject {
+        public:
+            // Indices are stored relative to the range's first vertex
+            struct Range {
+                GLint baseVertex = 0;
+                GLsizei vertexCount = 0;
+                GLuint firstIndex = 0;
+                GLsizei indexCount = 0;
+            };
+            // Layout of DrawElementsIndirectCommand
+            struct DrawCommand {
+                GLuint count;
+                GLuint instanceCount;
+                GLuint firstIndex;
+                GLint baseVertex;
+                GLuint baseInstance;
+            };
+
+            // The arena for a vertex layout, created on first use and destroyed with its last range
+            static std::shared_ptr<GeometryArena> ForLayout(Vertex::AttrFlags attributes);
+            // Whether glMultiDrawElementsIndirect with a base instance is available (GL 4.3)
+            static bool MultiDrawSupported();
+            // With multi-draw, arena VAOs read first_instance (see Renderer::DrawDataBuffer) as the base instance, through
+            // an identity buffer that must cover every base instance drawn
+            static void ReserveInstances(size_t count);
+            // Base instance of later non-indirect arena draws, so they read the same first_instance as a constant attribute
+            // would give other VAOs. Reserves instances to cover it.
+            static void SetFirstInstance(GLuint first_instance);
+            static GLuint FirstInstance() { return firstInstance; }
+
+            GeometryArena(Vertex::AttrFlags attributes);
+            // Rule of five
+            ~GeometryArena();
+            GeometryArena(const GeometryArena& other) = delete;
+            GeometryArena(GeometryArena&& other) = delete;
+            GeometryArena& operator=(const GeometryArena& other) = delete;
+            GeometryArena& operator=(GeometryArena&& other) = delete;
+
+            const Vertex::AttrFlags attributes;
+            const size_t stride;
+
+            void Bind() override;
+            void Unbind() override;
+
+            // Draws commands [first_command, first_command + command_count) of the bound Dibo; expects this arena bound
+            void MultiDrawIndirect(size_t first_command, GLsizei command_count);
+
+            // Non-indexed vertex data (empty indices) is given sequential indices, so every range draws with glDrawElements*
+            Range Allocate(const Vertex::VertexArray& varray, const std::vector<unsigned int>& indices);
+            void Free(const Range& range);
+
+        private:
+            // Offsets and sizes in elements (vertices or indices)
+            struct FreeList {
+                std::map<size_t, size_t> blocks;    // Offset to size, coalesced
+                size_t end = 0;                     // Everything from here on is free
+                size_t Allocate(size_t size);
+                void Free(size_t offset, size_t size);
+            };
+
+            GLuint vertexBuffer = 0;
+            GLuint indexBuffer = 0;
+            size_t vertexCapacity = 0;
+            size_t indexCapacity = 0;
+            FreeList vertexBlocks;
+            FreeList indexBlocks;
+
+            inline static std::map<Vertex::AttrFlags, std::weak_ptr<GeometryArena>> arenas;
+            inline static GLuint instanceIdBuffer = 0;
+            inline static size_t instanceIdCount = 0;
+            inline static GLuint firstInstance = 0;
+
+            void reserve(size_t vertex_count, size_t index_count);
+            void setAttribPointerFormat();
+            void setInstanceIdFormat();
+    };
+
     class Vao : public GlObject {
         public:
             Vao(std::shared_ptr<Vbo> vb);
             Vao(std::shared_ptr<Vbo> vb, std::shared_ptr<Ebo> eb);
+            // Sub-allocates the geometry in the arena for its vertex layout; Handle() is then the arena's VAO
+            Vao(const Vertex::VertexArray& varray, const std::vector<unsigned int>& indices = {});
             // Rule of five
             ~Vao();
             Vao(const Vao& other) = delete;
@@ -69,11 +157,28 @@ namespace Core {
             void Bind() override;
             void Unbind() override;
 
+            // Unique per VAO, for sorting draws by geometry; arena VAOs share a handle but not an ID
+            unsigned int Id() const { return id; }
+            GeometryArena* Arena() const { return arena.get(); }
+            GeometryArena::DrawCommand MakeDrawCommand(GLuint instance_count, GLuint base_instance) const;
+
             void Draw();
+            // Issues the draw call without binding; for callers that already bound this VAO
+            void DrawBound();
+            void DrawInstancedBound(int instance_count);
+
+            const Bounds::Aabb& BoundingBox() const { return boundingBox; }
+            const Bounds::Sphere& BoundingSphere() const { return boundingSphere; }
 
         private:
             std::shared_ptr<Vbo> vbo;
-            std::shared_ptr<Ebo> ebo;            
+            std::shared_ptr<Ebo> ebo;
+            std::shared_ptr<GeometryArena> arena;
+            GeometryArena::Range range;
+            Bounds::Aabb boundingBox;
+            Bounds::Sphere boundingSphere;
+            const unsigned int id;
+            inline static unsigned int nextId = 1;
             
             void setAttribPointerFormat();
     };
@@ -92,6 +197,131 @@ namespace Core {
             void Unbind() override;
 
             void UpdateData(unsigned int offset, size_t size, const void* data);
+            // Re-attaches the whole buffer to a binding point
+            void BindBase(unsigned int index);
+    };
+
+    // Uniform buffer split into one region per frame in flight. Blocks are written to a CPU staging copy, uploaded with a single
+    // unsynchronized map per Flush(), and bound as ranges of the current region. A fence per region keeps the CPU from
+    // overwriting a region the GPU may still be reading.
+    class UboRing : public GlObject {
+        public:
+            UboRing(size_t frame_size = 64 * 1024, int num_frames = 3);
+            // Rule of five
+            ~UboRing();
+            UboRing(const UboRing& other) = delete;
+            UboRing(UboRing&& other) = delete;
+            UboRing& operator=(const UboRing& other) = delete;
+            UboRing& operator=(UboRing&& other) = delete;
+
+            void Bind() override;
+            void Unbind() override;
+
+            // Waits until the GPU is done with the oldest region, then starts writing to it
+            void BeginFrame();
+            // Fences the current region
+            void EndFrame();
+
+            // Reserves size bytes in this frame's staging data and returns their offset, aligned for BindRange()
+            size_t Allocate(size_t size);
+            // Staging memory at an offset from Allocate(); valid until the next Allocate()
+            void* Data(size_t offset) { return staging.data() + offset; }
+            size_t Write(const void* data, size_t size);
+            template<typename T>
+            size_t Write(const T& data) { return Write(&data, sizeof(T)); }
+            // Uploads everything written since the last Flush(). Draws only see data that has been flushed.
+            void Flush();
+            void BindRange(GLuint index, size_t offset, size_t size);
+
+        private:
+            struct Range {
+                size_t offset = 0;
+                size_t size = 0;
+            };
+            size_t frameSize;
+            const int numFrames;
+            int frame = 0;
+            size_t alignment;
+            std::vector<unsigned char> staging;
+            size_t flushed = 0;
+            std::vector<GLsync> fences;
+            std::vector<Range> bindings;    // Per binding index, this frame; re-bound if the buffer has to grow
+
+            void allocateStorage();
+    };
+
+    class Tbo : public GlObject {
+        public:
+            Tbo(GLenum internalformat);
+            // Rule of five
+            ~Tbo();
+            Tbo(const Tbo& other) = delete;
+            Tbo(Tbo&& other) = delete;
+            Tbo& operator=(const Tbo& other) = delete;
+            Tbo& operator=(Tbo&& other) = delete;
+
+            const GLenum internalformat;
+
+            GLuint TextureHandle() const { return texture; }
+
+            void Bind() override;
+            void Bind(int texunit);
+            void Unbind() override;
+
+            // Replaces the entire contents of the buffer, growing the data store if needed
+            void UpdateData(size_t size, const void* data);
+            // Writes into the current data store without orphaning it, so the range must not be read by in-flight draws
+            void UpdateSubData(size_t offset, size_t size, const void* data);
+            size_t Capacity() const { return capacity; }
+
+        private:
+            GLuint texture;
+            size_t capacity = 0;
+    };
+
+    // Draw indirect buffer
+    class Dibo : public GlObject {
+        public:
+            Dibo();
+            // Rule of five
+            ~Dibo();
+            Dibo(const Dibo& other) = delete;
+            Dibo(Dibo&& other) = delete;
+            Dibo& operator=(const Dibo& other) = delete;
+            Dibo& operator=(Dibo&& other) = delete;
+
+            void Bind() override;
+            void Unbind() override;
+
+            // Replaces the entire contents of the buffer, growing the data store if needed
+            void UpdateData(size_t size, const void* data);
+
+        private:
+            size_t capacity = 0;
+    };
+
+    // Query object, e.g. GL_SAMPLES_PASSED. Bind() begins and Unbind() ends the query.
+    class Query : public GlObject {
+        public:
+            Query(GLenum target);
+            // Rule of five
+            ~Query();
+            Query(const Query& other) = delete;
+            Query(Query&& other) = delete;
+            Query& operator=(const Query& other) = delete;
+            Query& operator=(Query&& other) = delete;
+
+            void Bind() override;
+            void Unbind() override;
+            // For GL_TIMESTAMP, which has no begin and end: the GPU time in ns once the commands before it have completed
+            void Stamp();
+
+            // False until a query has ended and its result reached the CPU; polling does not stall
+            bool ResultAvailable() const;
+            GLuint64 Result() const;
+
+        private:
+            bool issued = false;
     };
 
     class Rbo : public GlObject {
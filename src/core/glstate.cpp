@@ -0,0 +1,283 @@
+#include "core/glstate.hpp"
+
+#include <stdexcept>
+
+namespace Core {
+
+    GlState& GlState::Instance() {
+        static GlState instance;
+        return instance;
+    }
+
+    bool GlState::update(bool changed) {
+        if (changed)
+            frame.issued++;
+        else
+            frame.skipped++;
+        return changed;
+    }
+
+    // ---- Objects ----
+
+    void GlState::UseProgram(GLuint p) {
+        if (update(program != p)) {
+            glUseProgram(p);
+            program = p;
+        }
+    }
+
+    void GlState::BindVertexArray(GLuint v) {
+        if (update(vao != v)) {
+            glBindVertexArray(v);
+            vao = v;
+        }
+    }
+
+    void GlState::BindBuffer(GLenum target, GLuint buffer) {
+        if (target == GL_ELEMENT_ARRAY_BUFFER) {
+            update(true);
+            glBindBuffer(target, buffer);
+            return;
+        }
+        auto it = buffers.find(target);
+        if (update(it == buffers.end() || it->second != buffer)) {
+            glBindBuffer(target, buffer);
+            buffers[target] = buffer;
+        }
+    }
+
+    void GlState::BindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+        BindBufferRange(target, index, buffer, 0, -1);
+    }
+
+    void GlState::BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+        auto it = indexedBuffers.find({target, index});
+        const bool changed = it == indexedBuffers.end() || it->second.buffer != buffer || it->second.offset != offset || it->second.size != size;
+        if (update(changed)) {
+            if (size < 0)
+                glBindBufferBase(target, index, buffer);
+            else
+                glBindBufferRange(target, index, buffer, offset, size);
+            indexedBuffers[{target, index}] = {buffer, offset, size};
+            // Both also bind the generic binding point
+            buffers[target] = buffer;
+        }
+    }
+
+    void GlState::ActiveTexture(int unit) {
+        if (update(activeUnit != unit)) {
+            glActiveTexture(GL_TEXTURE0 + unit);
+            activeUnit = unit;
+        }
+    }
+
+    void GlState::BindTexture(GLenum target, GLuint texture) {
+        if (activeUnit < 0) {
+            // Unknown unit, so nothing to compare against
+            update(true);
+            glBindTexture(target, texture);
+            return;
+        }
+        if (textures.size() <= static_cast<size_t>(activeUnit))
+            textures.resize(activeUnit + 1);
+        auto& unitTextures = textures[activeUnit];
+        auto it = unitTextures.find(target);
+        if (update(it == unitTextures.end() || it->second != texture)) {
+            glBindTexture(target, texture);
+            unitTextures[target] = texture;
+        }
+    }
+
+    void GlState::BindTexture(int unit, GLenum target, GLuint texture) {
+        // Check first, so a redundant bind does not cost an active unit change either
+        if (unit >= 0 && static_cast<size_t>(unit) < textures.size()) {
+            auto it = textures[unit].find(target);
+            if (it != textures[unit].end() && it->second == texture) {
+                update(false);
+                return;
+            }
+        }
+        ActiveTexture(unit);
+        BindTexture(target, texture);
+    }
+
+    void GlState::BindFramebuffer(GLenum target, GLuint fbo) {
+        bool changed;
+        if (target == GL_DRAW_FRAMEBUFFER)
+            changed = drawFramebuffer != fbo;
+        else if (target == GL_READ_FRAMEBUFFER)
+            changed = readFramebuffer != fbo;
+        else
+            changed = drawFramebuffer != fbo || readFramebuffer != fbo;
+        if (update(changed)) {
+            glBindFramebuffer(target, fbo);
+            if (target != GL_READ_FRAMEBUFFER)
+                drawFramebuffer = fbo;
+            if (target != GL_DRAW_FRAMEBUFFER)
+                readFramebuffer = fbo;
+        }
+    }
+
+    void GlState::BindRenderbuffer(GLuint rbo) {
+        if (update(renderbuffer != rbo)) {
+            glBindRenderbuffer(GL_RENDERBUFFER, rbo);
+            renderbuffer = rbo;
+        }
+    }
+
+    // ---- Fixed function ----
+
+    void GlState::Viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+        const std::array<GLint, 4> v = {x, y, width, height};
+        if (update(viewport != v || !indexedViewports.empty())) {
+            glViewport(x, y, width, height);
+            viewport = v;
+            indexedViewports.clear();
+        }
+    }
+
+    void GlState::ViewportIndexed(GLuint index, GLint x, GLint y, GLsizei width, GLsizei height) {
+        if (index == 0)
+            throw std::runtime_error("GlState::ViewportIndexed() index 0 is set by Viewport()");
+        const std::array<GLint, 4> v = {x, y, width, height};
+        auto it = indexedViewports.find(index);
+        if (update((it != indexedViewports.end() ? it->second : viewport) != v)) {
+            glViewportIndexedf(index, x, y, width, height);
+            indexedViewports[index] = v;
+        }
+    }
+
+    void GlState::Scissor(GLint x, GLint y, GLsizei width, GLsizei height) {
+        const std::array<GLint, 4> s = {x, y, width, height};
+        if (update(scissor != s)) {
+            glScissor(x, y, width, height);
+            scissor = s;
+        }
+    }
+
+    void GlState::SetEnabled(GLenum capability, bool enabled) {
+        auto it = capabilities.find(capability);
+        if (update(it == capabilities.end() || it->second != enabled)) {
+            if (enabled)
+                glEnable(capability);
+            else
+                glDisable(capability);
+            capabilities[capability] = enabled;
+        }
+    }
+
+    void GlState::CullFace(GLenum mode) {
+        if (update(cullFace != mode)) {
+            glCullFace(mode);
+            cullFace = mode;
+        }
+    }
+
+    void GlState::DepthFunc(GLenum func) {
+        if (update(depthFunc != func)) {
+            glDepthFunc(func);
+            depthFunc = func;
+        }
+    }
+
+    void GlState::DepthMask(bool mask) {
+        if (update(depthMask != mask)) {
+            glDepthMask(mask ? GL_TRUE : GL_FALSE);
+            depthMask = mask;
+        }
+    }
+
+    void GlState::BlendFunc(GLenum source_factor, GLenum destination_factor) {
+        const std::pair<GLenum, GLenum> f = {source_factor, destination_factor};
+        if (update(blendFunc != f)) {
+            glBlendFunc(source_factor, destination_factor);
+            blendFunc = f;
+        }
+    }
+
+    void GlState::ColorMask(bool mask) {
+        if (update(colorMask != mask)) {
+            const GLboolean m = mask ? GL_TRUE : GL_FALSE;
+            glColorMask(m, m, m, m);
+            colorMask = mask;
+        }
+    }
+
+    // ---- Deletion ----
+
+    void GlState::DeleteProgram(GLuint p) {
+        glDeleteProgram(p);
+        if (program == p)
+            program = unknown;
+    }
+
+    void GlState::DeleteVertexArray(GLuint v) {
+        glDeleteVertexArrays(1, &v);
+        if (vao == v)
+            vao = unknown;
+    }
+
+    void GlState::DeleteBuffer(GLuint buffer) {
+        glDeleteBuffers(1, &buffer);
+        for (auto& [target, bound] : buffers) {
+            if (bound == buffer)
+                bound = unknown;
+        }
+        for (auto& [key, binding] : indexedBuffers) {
+            if (binding.buffer == buffer)
+                binding.buffer = unknown;
+        }
+    }
+
+    void GlState::DeleteTexture(GLuint texture) {
+        glDeleteTextures(1, &texture);
+        for (auto& unitTextures : textures) {
+            for (auto& [target, bound] : unitTextures) {
+                if (bound == texture)
+                    bound = unknown;
+            }
+        }
+    }
+
+    void GlState::DeleteFramebuffer(GLuint fbo) {
+        glDeleteFramebuffers(1, &fbo);
+        if (drawFramebuffer == fbo)
+            drawFramebuffer = unknown;
+        if (readFramebuffer == fbo)
+            readFramebuffer = unknown;
+    }
+
+    void GlState::DeleteRenderbuffer(GLuint rbo) {
+        glDeleteRenderbuffers(1, &rbo);
+        if (renderbuffer == rbo)
+            renderbuffer = unknown;
+    }
+
+    void GlState::Invalidate() {
+        program = unknown;
+        vao = unknown;
+        buffers.clear();
+        indexedBuffers.clear();
+        activeUnit = -1;
+        textures.clear();
+        drawFramebuffer = unknown;
+        readFramebuffer = unknown;
+        renderbuffer = unknown;
+        viewport = {-1, -1, -1, -1};
+        indexedViewports.clear();
+        scissor = {-1, -1, -1, -1};
+        capabilities.clear();
+        cullFace = 0;
+        depthFunc = 0;
+        depthMask = -1;
+        blendFunc = {0, 0};
+        colorMask = -1;
+    }
+
+    void GlState::EndFrame() {
+        Invalidate();
+        lastFrame = frame;
+        frame = Counters();
+    }
+
+}
\ No newline at end of file
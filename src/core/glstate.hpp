@@ -0,0 +1,110 @@
+#pragma once
+
+#include <glad/gl.h>
+
+#include <array>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace Core {
+
+    // Shadows the GL state that Core objects set and skips calls that would not change it.
+    // Everything in the engine that binds, enables or deletes goes through here; code that does not (third-party
+    // libraries) must be followed by Invalidate(), or the shadow goes stale.
+    class GlState {
+        public:
+            struct Counters {
+                int issued = 0;
+                int skipped = 0;
+            };
+
+            static GlState& Instance();
+            // Rule of five
+            ~GlState() = default;
+            GlState(const GlState& other) = delete;
+            GlState(GlState&& other) = delete;
+            GlState& operator=(const GlState& other) = delete;
+            GlState& operator=(GlState&& other) = delete;
+
+            // ---- Objects ----
+            void UseProgram(GLuint program);
+            void BindVertexArray(GLuint vao);
+            // GL_ELEMENT_ARRAY_BUFFER is part of the bound VAO and always issued
+            void BindBuffer(GLenum target, GLuint buffer);
+            void BindBufferBase(GLenum target, GLuint index, GLuint buffer);
+            void BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+            void ActiveTexture(int unit);
+            // On the active unit
+            void BindTexture(GLenum target, GLuint texture);
+            void BindTexture(int unit, GLenum target, GLuint texture);
+            // GL_FRAMEBUFFER sets both the draw and read bindings
+            void BindFramebuffer(GLenum target, GLuint fbo);
+            void BindRenderbuffer(GLuint rbo);
+
+            // ---- Fixed function ----
+            // Sets every viewport index
+            void Viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+            // One index of the viewport array, for geometry shaders that write gl_ViewportIndex. Index 0 is set by Viewport().
+            void ViewportIndexed(GLuint index, GLint x, GLint y, GLsizei width, GLsizei height);
+            void Scissor(GLint x, GLint y, GLsizei width, GLsizei height);
+            void SetEnabled(GLenum capability, bool enabled);
+            void CullFace(GLenum mode);
+            void DepthFunc(GLenum func);
+            void DepthMask(bool mask);
+            void BlendFunc(GLenum source_factor, GLenum destination_factor);
+            // All four channels of every draw buffer
+            void ColorMask(bool mask);
+
+            // ---- Deletion ----
+            // GL unbinds deleted objects and may reuse their names, so the shadow has to forget them too
+            void DeleteProgram(GLuint program);
+            void DeleteVertexArray(GLuint vao);
+            void DeleteBuffer(GLuint buffer);
+            void DeleteTexture(GLuint texture);
+            void DeleteFramebuffer(GLuint fbo);
+            void DeleteRenderbuffer(GLuint rbo);
+
+            // Forgets all shadowed state, so the next call of each kind is issued
+            void Invalidate();
+            // Call once per frame, after any third-party rendering: invalidates and starts new counters
+            void EndFrame();
+            const Counters& LastFrame() const { return lastFrame; }
+
+        private:
+            GlState() = default;
+
+            static constexpr GLuint unknown = ~0u;
+
+            GLuint program = unknown;
+            GLuint vao = unknown;
+            std::map<GLenum, GLuint> buffers;
+            struct IndexedBinding {
+                GLuint buffer;
+                GLintptr offset;
+                GLsizeiptr size;    // -1 for a whole-buffer binding
+            };
+            std::map<std::pair<GLenum, GLuint>, IndexedBinding> indexedBuffers;
+            int activeUnit = -1;
+            std::vector<std::map<GLenum, GLuint>> textures;     // Per unit
+            GLuint drawFramebuffer = unknown;
+            GLuint readFramebuffer = unknown;
+            GLuint renderbuffer = unknown;
+            std::array<GLint, 4> viewport = {-1, -1, -1, -1};
+            std::map<GLuint, std::array<GLint, 4>> indexedViewports;   // Indices that differ from viewport
+            std::array<GLint, 4> scissor = {-1, -1, -1, -1};
+            std::map<GLenum, bool> capabilities;
+            GLenum cullFace = 0;
+            GLenum depthFunc = 0;
+            int depthMask = -1;
+            std::pair<GLenum, GLenum> blendFunc = {0, 0};
+            int colorMask = -1;
+
+            Counters frame;
+            Counters lastFrame;
+
+            // Records the outcome; true if the call should be issued
+            bool update(bool changed);
+    };
+
+}
\ No newline at end of file
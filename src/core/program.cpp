@@ -1,28 +1,31 @@
 #include "core/program.hpp"
 #include "context/application.hpp"
+#include "core/glstate.hpp"
 
 #include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
 #include <string>
 
 namespace Core {
 
-    Program::Program(std::shared_ptr<ShaderAsset> vert_shader, std::shared_ptr<ShaderAsset> frag_shader, std::shared_ptr<ShaderAsset> geom_shader)
+    Program::Program(std::shared_ptr<ShaderAsset> vert_shader, std::shared_ptr<ShaderAsset> frag_shader, std::shared_ptr<ShaderAsset> geom_shader, const std::string& defines)
         : vertexShader(vert_shader),
         fragmentShader(frag_shader),
-        geometryShader(geom_shader)
+        geometryShader(geom_shader),
+        defines(defines)
     {
         setup();
         vert_shader->AddUser(this);
         fragmentShader->AddUser(this);
         if (geom_shader) {
-            vert_shader->AddUser(this);
+            geom_shader->AddUser(this);
         }
     }
 
     Program::~Program()
     {
-        glDeleteProgram(handle);
+        GlState::Instance().DeleteProgram(handle);
     }
 
     void Program::SetUniformBlockBindingScheme(UboScheme scheme) {
@@ -33,6 +36,7 @@ namespace Core {
                 SetUniformBlockBinding("Camera", 2);
                 SetUniformBlockBinding("DirLight", 3);
                 SetUniformBlockBinding("PointLight", 4);
+                SetUniformBlockBinding("SsaoKernel", 5);
         }
     }
 
@@ -45,40 +49,60 @@ namespace Core {
     }
 
     void Program::SetInt(const std::string& name, int val) {
-        GLint location = glGetUniformLocation(handle, name.c_str());
-        glUniform1i(location, val);
+        glUniform1i(location(name), val);
     }
 
     void Program::SetFloat(const std::string& name, float val) {
-        GLint location = glGetUniformLocation(handle, name.c_str());
-        glUniform1f(location, val);
+        glUniform1f(location(name), val);
     }
 
     void Program::SetVec3(const std::string& name, const glm::vec3& vec) {
-        GLint location = glGetUniformLocation(handle, name.c_str());
-        glUniform3fv(location, 1, glm::value_ptr(vec));
+        glUniform3fv(location(name), 1, glm::value_ptr(vec));
     }
 
     void Program::SetMat4(const std::string& name, const glm::mat4& mat) {
-        GLint location = glGetUniformLocation(handle, name.c_str());
-        glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(mat));
+        glUniformMatrix4fv(location(name), 1, GL_FALSE, glm::value_ptr(mat));
+    }
+
+    void Program::Set(Uniform<int> uniform, int val) {
+        glUniform1i(location(uniform.slot), val);
+    }
+
+    void Program::Set(Uniform<float> uniform, float val) {
+        glUniform1f(location(uniform.slot), val);
+    }
+
+    void Program::Set(Uniform<glm::vec3> uniform, const glm::vec3& vec) {
+        glUniform3fv(location(uniform.slot), 1, glm::value_ptr(vec));
+    }
+
+    void Program::Set(Uniform<glm::vec3> uniform, const glm::vec3* vecs, int count) {
+        glUniform3fv(location(uniform.slot), count, glm::value_ptr(vecs[0]));
+    }
+
+    void Program::Set(Uniform<glm::mat4> uniform, const glm::mat4& mat) {
+        glUniformMatrix4fv(location(uniform.slot), 1, GL_FALSE, glm::value_ptr(mat));
+    }
+
+    void Program::Set(Uniform<glm::mat4> uniform, const glm::mat4* mats, int count) {
+        glUniformMatrix4fv(location(uniform.slot), count, GL_FALSE, glm::value_ptr(mats[0]));
     }
 
     void Program::Use() {
-        glUseProgram(handle);
+        GlState::Instance().UseProgram(handle);
     }
 
     void Program::AssetResyncCallback() {
-        glDeleteProgram(handle);
+        GlState::Instance().DeleteProgram(handle);
         setup();
     }
 
     void Program::setup() {
         handle = glCreateProgram();
-        glAttachShader(handle, vertexShader->Handle());
-        glAttachShader(handle, fragmentShader->Handle());
+        glAttachShader(handle, vertexShader->Handle(defines));
+        glAttachShader(handle, fragmentShader->Handle(defines));
         if (geometryShader)
-            glAttachShader(handle, geometryShader->Handle());
+            glAttachShader(handle, geometryShader->Handle(defines));
 
         // ==== Link shaders ====
         glLinkProgram(handle);
@@ -93,7 +117,55 @@ namespace Core {
         }
 
         SetUniformBlockBindingScheme(UboScheme::Scheme1);
+        reflectUniforms();
         // std::clog << "Successfully linked shaders: " << vertexShader->GetFile().Filename() << " " << fragmentShader->GetFile().Filename() << std::endl;
     }
 
+    void Program::reflectUniforms() {
+        uniformLocations.clear();
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(handle, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(handle, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> buffer(std::max(maxLength, 1));
+        for (GLint i = 0; i < count; i++) {
+            GLint size;
+            GLenum type;
+            GLsizei length;
+            glGetActiveUniform(handle, i, buffer.size(), &length, &size, &type, buffer.data());
+            const std::string name(buffer.data(), length);
+            const GLint loc = glGetUniformLocation(handle, name.c_str());
+            if (loc < 0)    // Uniform block members
+                continue;
+            uniformLocations[name] = loc;
+
+            // Arrays are reported by their first element. Element locations are not guaranteed to be contiguous, so look each up now.
+            const std::string suffix = "[0]";
+            if (name.size() > suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0) {
+                const std::string base = name.substr(0, name.size() - suffix.size());
+                uniformLocations[base] = loc;
+                for (GLint j = 1; j < size; j++) {
+                    const std::string element = base + "[" + std::to_string(j) + "]";
+                    uniformLocations[element] = glGetUniformLocation(handle, element.c_str());
+                }
+            }
+        }
+
+        for (size_t i = 0; i < slotNames.size(); i++)
+            slotLocations[i] = location(slotNames[i]);
+    }
+
+    GLint Program::location(const std::string& name) const {
+        auto it = uniformLocations.find(name);
+        return it != uniformLocations.end() ? it->second : -1;
+    }
+
+    int Program::resolveSlot(const std::string& name) {
+        auto it = std::find(slotNames.begin(), slotNames.end(), name);
+        if (it != slotNames.end())
+            return it - slotNames.begin();
+        slotNames.push_back(name);
+        slotLocations.push_back(location(name));
+        return slotNames.size() - 1;
+    }
+
 }
\ No newline at end of file
@@ -6,8 +6,24 @@
 #include <glad/gl.h>
 #include <glm/glm.hpp>
 
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 namespace Core {
 
+    // Pre-resolved uniform of GLSL type T (int also covers bool and samplers). Only valid with the program that created it,
+    // and stays valid across that program's hot reloads. Default-constructed handles, like inactive uniforms, are ignored by Set().
+    template<typename T>
+    class Uniform {
+        public:
+            Uniform() = default;
+        private:
+            explicit Uniform(int slot) : slot(slot) {}
+            int slot = -1;
+            friend class Program;
+    };
+
     class Program : public AssetUser {
 
         public:
@@ -16,7 +32,8 @@ namespace Core {
                 Scheme1
             };
 
-            Program(std::shared_ptr<ShaderAsset> vert_shader, std::shared_ptr<ShaderAsset> frag_shader, std::shared_ptr<ShaderAsset> geom_shader = nullptr);
+            // defines are compiled into every stage, see ShaderAsset::Handle()
+            Program(std::shared_ptr<ShaderAsset> vert_shader, std::shared_ptr<ShaderAsset> frag_shader, std::shared_ptr<ShaderAsset> geom_shader = nullptr, const std::string& defines = "");
             // Rule of five
             ~Program();
             Program(const Program& other) = delete;
@@ -27,6 +44,7 @@ namespace Core {
             std::shared_ptr<ShaderAsset> vertexShader;
             std::shared_ptr<ShaderAsset> fragmentShader;
             std::shared_ptr<ShaderAsset> geometryShader;
+            const std::string defines;
             
             GLuint Handle() const { return handle; }
 
@@ -37,13 +55,33 @@ namespace Core {
             void SetVec3(const std::string& name, const glm::vec3& vec);
             void SetMat4(const std::string& name, const glm::mat4& mat);
             void Use();
+
+            // Resolve once and cache; for arrays, pass the bare name and set all elements at once
+            template<typename T>
+            Uniform<T> GetUniform(const std::string& name) { return Uniform<T>(resolveSlot(name)); }
+            void Set(Uniform<int> uniform, int val);
+            void Set(Uniform<float> uniform, float val);
+            void Set(Uniform<glm::vec3> uniform, const glm::vec3& vec);
+            void Set(Uniform<glm::vec3> uniform, const glm::vec3* vecs, int count);
+            void Set(Uniform<glm::mat4> uniform, const glm::mat4& mat);
+            void Set(Uniform<glm::mat4> uniform, const glm::mat4* mats, int count);
             
             void AssetResyncCallback() override;
 
         private:
             GLuint handle;
 
+            // Every active uniform by name, reflected at link time. Arrays are listed by bare name and by each element.
+            std::unordered_map<std::string, GLint> uniformLocations;
+            // Names behind the handles given out so far, and their locations in the current link
+            std::vector<std::string> slotNames;
+            std::vector<GLint> slotLocations;
+
             void setup();
+            void reflectUniforms();
+            GLint location(const std::string& name) const;
+            GLint location(int slot) const { return slot >= 0 ? slotLocations[slot] : -1; }
+            int resolveSlot(const std::string& name);
     };
     
 }
\ No newline at end of file
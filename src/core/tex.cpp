@@ -1,5 +1,7 @@
 #include "core/tex.hpp"
 
+#include "core/glstate.hpp"
+
 #include <string>
 #include <glad/gl.h>
 
@@ -26,20 +28,18 @@ namespace Core {
     }
     Tex::~Tex()
     {
-        glDeleteTextures(1, &handle);
+        GlState::Instance().DeleteTexture(handle);
     }
 
     void Tex::Bind() {
-        glBindTexture(target, handle);
+        GlState::Instance().BindTexture(target, handle);
     }
     void Tex::Bind(int texunit) {
         textureUnit = texunit;
-        glActiveTexture(GL_TEXTURE0 + textureUnit);
-        glBindTexture(target, handle);
+        GlState::Instance().BindTexture(textureUnit, target, handle);
     }
     void Tex::Unbind() {
-        glActiveTexture(GL_TEXTURE0 + textureUnit);
-        glBindTexture(target, 0);
+        GlState::Instance().BindTexture(textureUnit, target, 0);
     }
     
     void Tex::GenerateMipMap() {
@@ -29,6 +29,7 @@ namespace Core {
                 const std::vector<float>& Data() const { return data; }
                 
                 std::vector<float> AttributeData(AttrFlags flag) const;
+                AttrFlags AttributeFlags() const { return attributes; }
                 bool HasAttributes(AttrFlags flags) const;
                 size_t AttributeOffset(AttrFlags flag) const;
                 
@@ -1,5 +1,7 @@
 #include "demo/demo.hpp"
 
+#include "context/application.hpp"
+#include "core/glstate.hpp"
 #include "interface/widget.hpp"
 #include "material/material.hpp"
 
@@ -13,9 +15,8 @@ Demo::Demo(const std::string& title)
 void Demo::Initialize() {
     std::clog << "Creating renderer..." << std::endl;
     renderer = std::make_unique<Renderer::DeferredRenderer>();
-    fxaa = std::make_unique<PostProcessing::Fxaa>();
-    hdr = std::make_unique<PostProcessing::Hdr>();
-    bloom = std::make_unique<PostProcessing::Bloom>();
+    postChain = std::make_unique<PostProcessing::Chain>();
+    renderer->postProcessing = postChain.get();
     
     std::clog << "Creating environment..." << std::endl;
     environment = std::make_unique<Scene::Environment>();
@@ -28,26 +29,27 @@ void Demo::DisplayScene() {
 
     camera->ProcessInputs();
     renderer->ssao = renderOptions.ssao;
-    fbo = renderer->Render(*scene, *camera, *environment);
-    if (renderOptions.bloom) {
-        fbo = bloom->Process(*fbo);
-    }
-    if (renderOptions.hdr) {
-        hdr->exposure = renderOptions.hdrExposure;
-        fbo = hdr->Process(*fbo);
-    }
-    if (renderOptions.fxaa) {
-        fbo = fxaa->Process(*fbo);
-    }
+    renderer->ssaoResolution = static_cast<Renderer::SsaoModule::Resolution>(1 << renderOptions.ssaoResolution);
+    renderer->ssaoSamples = 8 << renderOptions.ssaoSamples;
+    renderer->depthPrepass = renderOptions.depthPrepass;
+    renderer->pointShadowMode = renderOptions.pointShadowsGeometryShader ? Renderer::PointShadowModule::CubeMode::GeometryShader : Renderer::PointShadowModule::CubeMode::PerFace;
+    // Post-processing is part of the renderer's frame, straight to the default framebuffer
+    postChain->bloomEnabled = renderOptions.bloom;
+    postChain->bloom.mipCount = renderOptions.bloomMips;
+    postChain->bloom.threshold = renderOptions.bloomThreshold;
+    postChain->bloom.knee = renderOptions.bloomKnee;
+    postChain->hdrEnabled = renderOptions.hdr;
+    postChain->exposure = renderOptions.hdrExposure;
+    postChain->fxaaEnabled = renderOptions.fxaa;
+    renderer->Render(*scene, *camera, *environment);
 
     postDisplayScene();
-
-    fbo->BlitToDefault();
 }
 
 void Demo::DisplayGui() {
     ImGui::TextColored(ImVec4(0.3,1,1,1), "Press ` to capture/release mouse.");
     ImGui::TextColored(ImVec4(0.3,1,1,1), "Use WASD, Shift, and Spacebar to move camera.");
+    ImGui::TextColored(ImVec4(0.3,1,1,1), "Press F12 to capture a trace of the next %d frames.", Context::Application::Instance().traceFrames);
     ImGui::Spacing();
     
     constexpr float pointsPerSecond = 1.f;    // points/sec
@@ -55,6 +57,34 @@ void Demo::DisplayGui() {
     static Interface::PerformanceWidget performanceWidget;
     performanceWidget.Display(pointsPerSecond, secondsToDisplay);
 
+    pickNode();
+
+    if (ImGui::CollapsingHeader("Render Statistics")) {
+        const auto& stats = renderer->Stats();
+        ImGui::Text("Geometry:           %5d drawn, %5d culled", stats.geometry.drawn, stats.geometry.culled);
+        ImGui::Text("Directional shadow: %5d drawn, %5d culled", stats.directionalShadows.drawn, stats.directionalShadows.culled);
+        ImGui::Text("Point shadow:       %5d drawn, %5d culled", stats.pointShadows.drawn, stats.pointShadows.culled);
+        ImGui::Text("Shadow tiles re-rendered: %d", stats.shadowTilesRendered);
+        ImGui::Text("Shadow atlas: %d lights, %d downsized, %d dropped, %.0f%% used", stats.shadowAtlas.lights, stats.shadowAtlas.downsized, stats.shadowAtlas.dropped, 100.f * stats.shadowAtlas.occupancy);
+        ImGui::Text("Geometry state changes: %d programs, %d materials, %d VAOs for %d draws (%d instances)",
+            stats.geometrySubmit.programChanges, stats.geometrySubmit.materialChanges, stats.geometrySubmit.vaoChanges, stats.geometrySubmit.draws, stats.geometrySubmit.instances);
+        ImGui::Text("G-buffer fragments shaded: %llu", static_cast<unsigned long long>(stats.geometrySamples));
+        const auto& traffic = postChain->LastTraffic();
+        ImGui::Text("Post-processing: %.0f MB traffic, estimated (%.0f MB as separate passes)", traffic.fused * 1e-6, traffic.separate * 1e-6);
+        // GPU times are a frame or two late
+        for (const auto& pass : renderer->Graph().LastFrame()) {
+            if (pass.culled)
+                ImGui::Text("  %-20s culled", pass.name.c_str());
+            else
+                ImGui::Text("  %-20s %6.3f ms CPU, %6.3f ms GPU", pass.name.c_str(), pass.cpuMs, pass.gpuMs);
+        }
+        const auto& targets = Renderer::RenderTargetPool::Instance().LastFrame();
+        ImGui::Text("Render targets: %d textures, %.0f MB estimated (%.0f MB unpooled), %d created, %d framebuffers",
+            targets.textures, targets.bytes * 1e-6, targets.unpooledBytes * 1e-6, targets.created, targets.framebuffers);
+        const auto& glState = Core::GlState::Instance().LastFrame();
+        ImGui::Text("GL state calls: %d issued, %d skipped", glState.issued, glState.skipped);
+    }
+
     if (ImGui::CollapsingHeader("Render Options", ImGuiTreeNodeFlags_DefaultOpen)) {
         ImGui::Checkbox("HDR", &renderOptions.hdr);
         if (renderOptions.hdr) {
@@ -66,6 +96,21 @@ void Demo::DisplayGui() {
         ImGui::Checkbox("SSAO", &renderOptions.ssao); ImGui::SameLine();
         ImGui::Checkbox("FXAA", &renderOptions.fxaa); ImGui::SameLine();
         ImGui::Checkbox("Bloom", &renderOptions.bloom);
+        if (renderOptions.bloom) {
+            ImGui::PushItemWidth(100.f);
+            ImGui::SliderInt("Bloom mips", &renderOptions.bloomMips, 1, 10); ImGui::SameLine();
+            ImGui::DragFloat("Threshold", &renderOptions.bloomThreshold, 0.01f, 0.0f, 100.0f); ImGui::SameLine();
+            ImGui::DragFloat("Knee", &renderOptions.bloomKnee, 0.01f, 0.0f, 10.0f);
+            ImGui::PopItemWidth();
+        }
+        if (renderOptions.ssao) {
+            ImGui::PushItemWidth(100.f);
+            ImGui::Combo("SSAO resolution", &renderOptions.ssaoResolution, "Full\0Half\0Quarter\0"); ImGui::SameLine();
+            ImGui::Combo("SSAO samples", &renderOptions.ssaoSamples, "8\0" "16\0" "32\0" "64\0");
+            ImGui::PopItemWidth();
+        }
+        ImGui::Checkbox("Depth pre-pass", &renderOptions.depthPrepass); ImGui::SameLine();
+        ImGui::Checkbox("Point shadows via geometry shader", &renderOptions.pointShadowsGeometryShader);
     }
     
     if (ImGui::CollapsingHeader("External Assets", ImGuiTreeNodeFlags_DefaultOpen)) {
@@ -136,19 +181,39 @@ void Demo::DisplayGui() {
                 showComponentCreationWidget = false;
             }
         }
+        ImGui::Text("Picked: %s", pickedNodeName.empty() ? "(none)" : pickedNodeName.c_str());
         scene->DisplayWidget();
     }
 
     displayGui();
 }
 
+void Demo::pickNode() {
+    // Only while the cursor is free and over the viewport rather than a GUI window
+    const ImGuiIO& io = ImGui::GetIO();
+    if (Context::InputObserver::GetCursorEnabled() || io.WantCaptureMouse || !ImGui::IsMouseClicked(ImGuiMouseButton_Left))
+        return;
+    if (io.DisplaySize.x <= 0 || io.DisplaySize.y <= 0)
+        return;
+
+    // Unproject the cursor at the near and far planes to get a worldspace ray
+    const ImVec2 mouse = ImGui::GetMousePos();
+    const glm::vec2 ndc(2.f * mouse.x / io.DisplaySize.x - 1.f, 1.f - 2.f * mouse.y / io.DisplaySize.y);
+    const glm::mat4 inverseViewProjection = glm::inverse(camera->projection * camera->View());
+    glm::vec4 nearPoint = inverseViewProjection * glm::vec4(ndc, -1.f, 1.f);
+    glm::vec4 farPoint = inverseViewProjection * glm::vec4(ndc, 1.f, 1.f);
+    nearPoint /= nearPoint.w;
+    farPoint /= farPoint.w;
+
+    const Scene::SceneNode* node = scene->Pick(glm::vec3(nearPoint), glm::vec3(farPoint - nearPoint));
+    pickedNodeName = node ? node->name : "";
+}
+
 void Demo::CleanUp() {
     cleanUp();
 
     renderer.reset();
-    fxaa.reset();
-    hdr.reset();
-    bloom.reset();
+    postChain.reset();
     
     scene.reset();
     environment.reset();
@@ -26,24 +26,33 @@ class Demo {
             bool hdr = true;
             float hdrExposure = 1.0f;
             bool ssao = true;
+            // Half resolution and 32 samples cost about a quarter of full resolution and 64 (see `./renderbench ssao`)
+            int ssaoResolution = 1;     // Index into full, half, quarter
+            int ssaoSamples = 2;        // Index into 8, 16, 32, 64
+            bool depthPrepass = false;
+            bool pointShadowsGeometryShader = false;
             bool fxaa = true;
             bool bloom = false;
+            int bloomMips = 6;
+            float bloomThreshold = 1.0f;
+            float bloomKnee = 0.5f;
         } renderOptions;
-        
-        Core::Fbo* fbo;
 
         std::unique_ptr<Scene::Scene> scene;
         std::unique_ptr<Scene::Environment> environment;
         std::unique_ptr<Component::Camera> camera;
         
         std::unique_ptr<Renderer::DeferredRenderer> renderer;
-        std::unique_ptr<PostProcessing::Fxaa> fxaa;
-        std::unique_ptr<PostProcessing::Hdr> hdr;
-        std::unique_ptr<PostProcessing::Bloom> bloom;
+        std::unique_ptr<PostProcessing::Chain> postChain;
+
+        std::string pickedNodeName;     // Name of the node last clicked in the viewport
 
         virtual void initialize() {}
         virtual void preDisplayScene() {}
         virtual void postDisplayScene() {}
         virtual void displayGui() {}
         virtual void cleanUp() {}
+
+    private:
+        void pickNode();
 };
\ No newline at end of file
@@ -119,7 +119,7 @@ void Demo2::initialize() {
             mesh = std::make_shared<Component::Cube>();
         }
         mesh->material = metalmats[k];
-        metalNode->component = mesh;
+        metalNode->SetComponent(mesh);
     }
     auto lightParent = scene->EmplaceChild();
     lightParent->name = "Neon Lights";
@@ -134,7 +134,7 @@ void Demo2::initialize() {
         light->color = lightmats[k]->albedo / neonIntensity;
         light->intensity = neonIntensity / 2.f;
         light->EnableShadows();
-        lightNode->component = light;
+        lightNode->SetComponent(light);
         
         auto lightMeshNode = lightNode->EmplaceChild();
         lightMeshNode->transform.Scale(0.5f);
@@ -146,7 +146,7 @@ void Demo2::initialize() {
         }
         mesh->material = lightmats[k];
         mesh->castShadows = false;
-        lightMeshNode->component = mesh;
+        lightMeshNode->SetComponent(mesh);
 
         // Turn on Bloom
         renderOptions.bloom = true;
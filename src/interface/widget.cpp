@@ -7,6 +7,8 @@
 
 #include <algorithm>
 #include <cctype>
+#include <cmath>
+#include <cstdio>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -23,6 +25,17 @@ bool PerformanceWidget::Display(float points_per_sec, float seconds_to_display)
         ImGui::Text("%.2f ms/frame (%.1f fps)", 1000.f/framerateData.back(), framerateData.back());
         int n = std::min(static_cast<int>(framerateData.size()), numDisplayPoints);
         ImGui::PlotLines("ms/frame", framerateData.data(), n, framerateData.size() - n, NULL, FLT_MAX, FLT_MAX, ImVec2(250,50));
+
+        if (ImGui::TreeNode("Profiler")) {
+            const Renderer::Profiler& profiler = Renderer::Profiler::Instance();
+            ImGui::Text("Over the last %d frames; GPU times arrive a few frames late", static_cast<int>(profiler.History().size()));
+            displayGpuHistory(80.f);
+            displayScopeTable("GPU", profiler.GpuStats(), true);
+            displayScopeTable("CPU", profiler.CpuStats(), false);
+            if (ImGui::Button("Reset"))
+                Renderer::Profiler::Instance().Clear();
+            ImGui::TreePop();
+        }
     }
     
     // Update data vector at a rate of points_per_sec
@@ -38,6 +51,76 @@ bool PerformanceWidget::Display(float points_per_sec, float seconds_to_display)
     return true;
 }
 
+ImU32 PerformanceWidget::scopeColor(int scope) {
+    // Hues a golden angle apart, so neighbouring scopes differ
+    return ImColor::HSV(std::fmod(scope * 0.618034f, 1.f), 0.6f, 0.9f);
+}
+
+void PerformanceWidget::displayScopeTable(const char* label, const std::vector<Renderer::Profiler::ScopeStats>& stats, bool gpu) {
+    if (!ImGui::BeginTable(label, 7, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV | ImGuiTableFlags_SizingFixedFit))
+        return;
+    ImGui::TableSetupColumn(label);
+    for (const char* column : {"last", "avg", "p50", "p95", "p99", "max"})
+        ImGui::TableSetupColumn(column);
+    ImGui::TableHeadersRow();
+    for (size_t i = 0; i < stats.size(); i++) {
+        const Renderer::Profiler::ScopeStats& s = stats[i];
+        if (s.samples == 0)
+            continue;
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        // GPU rows double as the history's legend
+        if (gpu)
+            ImGui::TextColored(ImColor(scopeColor(i)), "%s", s.name.c_str());
+        else
+            ImGui::TextUnformatted(s.name.c_str());
+        for (float ms : {s.lastMs, s.averageMs, s.p50Ms, s.p95Ms, s.p99Ms, s.maxMs}) {
+            ImGui::TableNextColumn();
+            ImGui::Text("%6.3f", ms);
+        }
+    }
+    ImGui::EndTable();
+}
+
+void PerformanceWidget::displayGpuHistory(float height) {
+    // One column per frame, its GPU scopes stacked bottom up in the order first seen. ImGui has no stacked plot, so drawn directly.
+    const std::deque<Renderer::Profiler::Frame>& history = Renderer::Profiler::Instance().History();
+    const ImVec2 size(250.f, height);
+    const ImVec2 origin = ImGui::GetCursorScreenPos();
+    ImGui::InvisibleButton("##gpuhistory", size);
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    drawList->AddRectFilled(origin, ImVec2(origin.x + size.x, origin.y + size.y), ImGui::GetColorU32(ImGuiCol_FrameBg));
+
+    float maxTotal = 0.f;
+    for (const Renderer::Profiler::Frame& frame : history) {
+        float total = 0.f;
+        for (float ms : frame.gpuMs)
+            total += std::max(ms, 0.f);
+        maxTotal = std::max(maxTotal, total);
+    }
+    if (maxTotal <= 0.f)
+        return;
+
+    const float columnWidth = size.x / Renderer::Profiler::historyFrames;
+    const float scale = size.y / maxTotal;
+    for (size_t f = 0; f < history.size(); f++) {
+        // Newest frame on the right
+        const float x = origin.x + size.x - (history.size() - f) * columnWidth;
+        float y = origin.y + size.y;
+        const std::vector<float>& gpuMs = history[f].gpuMs;
+        for (size_t scope = 0; scope < gpuMs.size(); scope++) {
+            if (gpuMs[scope] <= 0.f)
+                continue;
+            const float top = y - gpuMs[scope] * scale;
+            drawList->AddRectFilled(ImVec2(x, top), ImVec2(x + columnWidth, y), scopeColor(scope));
+            y = top;
+        }
+    }
+    char label[32];
+    std::snprintf(label, sizeof(label), "%.2f ms", maxTotal);
+    drawList->AddText(ImVec2(origin.x + 2, origin.y), ImGui::GetColorU32(ImGuiCol_Text), label);
+}
+
 bool FileExplorerWidget::Display(Directory* display_dir, const Directory& highest_dir, Path* selected_path) {
     bool result = false;
 
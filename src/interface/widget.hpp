@@ -2,12 +2,14 @@
 
 #include "util/file.hpp"
 #include "asset/asset.hpp"
+#include "renderer/profiler.hpp"
 
 #include <imgui/imgui.h>
 
 #include <memory>
 #include <set>
 #include <string>
+#include <vector>
 
 namespace Component {
     class ComponentBase;
@@ -31,9 +33,12 @@ namespace Interface {
     class PerformanceWidget : public Widget {
         public:
             PerformanceWidget() = default;
-            // Displays frame time and frame rate.
+            // Displays frame time and frame rate, then each Profiler scope's statistics and the GPU scopes stacked per frame.
             bool Display(float points_per_sec = 0.5f, float seconds_to_display = 20.f);
         private:
+            void displayScopeTable(const char* label, const std::vector<Renderer::Profiler::ScopeStats>& stats, bool gpu);
+            void displayGpuHistory(float height);
+            static ImU32 scopeColor(int scope);
     };
     
     class FileExplorerWidget : public Widget {
@@ -1,15 +1,39 @@
 #include "context/application.hpp"
 #include "demo/all.hpp"
 
+#include <climits>
+#include <cstdlib>
 #include <iostream>
+#include <string>
+
+// Options: --trace <frames> [path] captures a trace of the first frames
+int main(int argc, char** argv) {
+    int traceFrames = 0;
+    std::string tracePath = "trace.json";
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) != "--trace")
+            continue;
+        char* end = nullptr;
+        const long frames = i + 1 < argc ? std::strtol(argv[i + 1], &end, 10) : 0;
+        if (!end || end == argv[i + 1] || *end != '\0' || frames <= 0 || frames > INT_MAX) {
+            std::cerr << "--trace expects a positive frame count, as in --trace <frames> [path]" << std::endl;
+            return 1;
+        }
+        traceFrames = frames;
+        i++;
+        // The path is optional, so a following option is not taken for one
+        if (i + 1 < argc && std::string(argv[i + 1]).rfind("--", 0) != 0)
+            tracePath = argv[++i];
+    }
 
-int main() {
     std::clog << "Initializing application..." << std::endl;
     Context::Application& app = Context::Application::Instance();
     auto demo1 = std::make_shared<Demo1>();
     auto demo2 = std::make_shared<Demo2>();
     app.demos = {demo1, demo2};
     app.activeDemo = demo1;
+    if (traceFrames > 0)
+        app.CaptureTrace(traceFrames, tracePath);
 
     std::clog << "Starting application..." << std::endl;
     app.Run();
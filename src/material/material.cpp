@@ -3,6 +3,7 @@
 #include "asset/manager.hpp"
 #include "asset/shader.hpp"
 #include "component/model.hpp"
+#include "renderer/drawdata.hpp"
 
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -13,10 +14,21 @@
 
 namespace Material {
     
+    MaterialBase::MaterialBase()
+        : id(nextId++)
+    {}
+
     MaterialBase::~MaterialBase() {
         // std::clog << "destroying MaterialBase" << std::endl;
     }
 
+    void MaterialBase::SetUniforms(const glm::mat4& model_matrix) {
+        GetProgram()->Use();
+        Bind();
+
+        Renderer::DrawDataBuffer::DrawImmediate(model_matrix, this);
+    }
+
     PBRMetallicMaterial::PBRMetallicMaterial()
     {
         name = "PBR Metallic";
@@ -29,6 +41,16 @@ namespace Material {
             
             program = std::make_shared<Core::Program>(vs, fs);
             program->SetUniformBlockBindingScheme(Core::Program::UboScheme::Scheme1);
+
+            uniforms.textureAlbedo = program->GetUniform<int>("material.texture_albedo");
+            uniforms.textureMetallic = program->GetUniform<int>("material.texture_metallic");
+            uniforms.textureRoughness = program->GetUniform<int>("material.texture_roughness");
+            uniforms.textureNormal = program->GetUniform<int>("material.texture_normal");
+            uniforms.textureHeight = program->GetUniform<int>("material.texture_height");
+            uniforms.textureOcclusion = program->GetUniform<int>("material.texture_occlusion");
+            uniforms.instanceDraws = program->GetUniform<int>("instanceDraws");
+            uniforms.drawData = program->GetUniform<int>("drawData");
+            uniforms.materialData = program->GetUniform<int>("materialData");
         }
     }
 
@@ -38,52 +60,52 @@ namespace Material {
         processMaterialInfo(info);
     }
     
-    void PBRMetallicMaterial::SetUniforms(const glm::mat4& model_matrix) {
-        program->Use();
-
-        // Model transform
-        program->SetMat4("model", model_matrix);
-        
+    void PBRMetallicMaterial::Bind() {
         // Textures
         int tex_idx = 0;
 
         if (albedoMap) {
             albedoMap->Bind(tex_idx);
-            program->SetInt("material.texture_albedo", tex_idx++);
+            program->Set(uniforms.textureAlbedo, tex_idx++);
         }
         if (metallicMap) {
             metallicMap->Bind(tex_idx);
-            program->SetInt("material.texture_metallic", tex_idx++);
+            program->Set(uniforms.textureMetallic, tex_idx++);
         }
         if (roughnessMap) {
             roughnessMap->Bind(tex_idx);
-            program->SetInt("material.texture_roughness", tex_idx++);
+            program->Set(uniforms.textureRoughness, tex_idx++);
         }
         if (normalMap) {
             normalMap->Bind(tex_idx);
-            program->SetInt("material.texture_normal", tex_idx++);
+            program->Set(uniforms.textureNormal, tex_idx++);
         }
         if (displacementMap) {
             displacementMap->Bind(tex_idx);
-            program->SetInt("material.texture_height", tex_idx++);
+            program->Set(uniforms.textureHeight, tex_idx++);
         }
         if (occlusionMap) {
             occlusionMap->Bind(tex_idx);
-            program->SetInt("material.texture_occlusion", tex_idx++);
+            program->Set(uniforms.textureOcclusion, tex_idx++);
         }
-        
-        program->SetInt("material.has_texture_albedo", static_cast<bool>(albedoMap));
-        program->SetInt("material.has_texture_metallic", static_cast<bool>(metallicMap));
-        program->SetInt("material.has_texture_roughness", static_cast<bool>(roughnessMap));
-        program->SetInt("material.has_texture_normal", static_cast<bool>(normalMap));
-        program->SetInt("material.has_texture_height", static_cast<bool>(displacementMap));
-        program->SetInt("material.has_texture_occlusion", static_cast<bool>(occlusionMap));
-
-        // Raw values
-        program->SetVec3("material.albedo", albedo);
-        program->SetFloat("material.metallic", metallic);
-        program->SetFloat("material.roughness", roughness);
 
+
+        // Draw data tables
+        program->Set(uniforms.instanceDraws, Renderer::DrawDataBuffer::instanceTexUnit);
+        program->Set(uniforms.drawData, Renderer::DrawDataBuffer::drawTexUnit);
+        program->Set(uniforms.materialData, Renderer::DrawDataBuffer::materialTexUnit);
+    }
+
+    void PBRMetallicMaterial::FillMaterialRecord(MaterialRecord& record) const {
+        unsigned int flags = 0;
+        if (albedoMap) flags |= HasAlbedoMap;
+        if (metallicMap) flags |= HasMetallicMap;
+        if (roughnessMap) flags |= HasRoughnessMap;
+        if (normalMap) flags |= HasNormalMap;
+        if (displacementMap) flags |= HasHeightMap;
+        if (occlusionMap) flags |= HasOcclusionMap;
+        record.albedoMetallic = glm::vec4(albedo, metallic);
+        record.roughnessFlags = glm::vec4(roughness, flags, 0, 0);
     }
     
     void PBRMetallicMaterial::DisplayWidget() {
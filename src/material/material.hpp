@@ -1,5 +1,6 @@
 #pragma once
 
+#include "core/globject.hpp"
 #include "core/program.hpp"
 #include "core/tex.hpp"
 #include "interface/widget.hpp"
@@ -21,6 +22,22 @@ namespace Material {
     class MaterialBase;
     class PBRMetallicMaterial;
 
+    // Bits of MaterialRecord::roughnessFlags.y
+    enum TextureFlags : unsigned int {
+        HasAlbedoMap = 1 << 0,
+        HasMetallicMap = 1 << 1,
+        HasRoughnessMap = 1 << 2,
+        HasNormalMap = 1 << 3,
+        HasHeightMap = 1 << 4,
+        HasOcclusionMap = 1 << 5,
+    };
+
+    // A material's constants as stored in the frame's material table (see Renderer::DrawDataBuffer)
+    struct MaterialRecord {
+        glm::vec4 albedoMetallic = glm::vec4(0.5f, 0.5f, 0.5f, 0.0f);
+        glm::vec4 roughnessFlags = glm::vec4(0.5f, 0.0f, 0.0f, 0.0f);  // Roughness, TextureFlags
+    };
+
     inline std::shared_ptr<Material::MaterialBase> defaultMaterial;
     inline std::set<std::shared_ptr<Material::MaterialBase>> materials;
     
@@ -29,15 +46,28 @@ namespace Material {
             virtual ~MaterialBase();
             
             std::string name;
+
+            // Unique per material, for sorting draws by material
+            unsigned int Id() const { return id; }
             
             virtual std::shared_ptr<Core::Program> GetProgram() = 0;
-            virtual void SetUniforms(const glm::mat4& model_transform) = 0;
+            // Uses the program, binds the material and uploads the draw's data for a single draw. Batched passes instead
+            // call Bind() once per material and read draw data from the frame's DrawDataBuffer.
+            void SetUniforms(const glm::mat4& model_transform);
+            // Textures; expects GetProgram() to be in use
+            virtual void Bind() = 0;
+            // Material constants for the frame's material table
+            virtual void FillMaterialRecord(MaterialRecord& record) const = 0;
 
             // GUI widget
             virtual void DisplayWidget() {}
         
         protected:
-            MaterialBase() = default;
+            MaterialBase();
+
+        private:
+            const unsigned int id;
+            inline static unsigned int nextId = 1;
     };
 
     class PBRMetallicMaterial : public MaterialBase {
@@ -51,7 +81,8 @@ namespace Material {
             float roughness = 0.5f;
 
             std::shared_ptr<Core::Program> GetProgram() override { return program; }
-            void SetUniforms(const glm::mat4& model_transform) override;
+            void Bind() override;
+            void FillMaterialRecord(MaterialRecord& record) const override;
             
             // GUI widget
             Path albedoPath, metallicPath, roughnessPath, normalPath, displacementPath, occlusionPath;
@@ -61,6 +92,11 @@ namespace Material {
             
         private:
             inline static std::shared_ptr<Core::Program> program;
+            struct Uniforms {
+                Core::Uniform<int> textureAlbedo, textureMetallic, textureRoughness, textureNormal, textureHeight, textureOcclusion;
+                Core::Uniform<int> instanceDraws, drawData, materialData;
+            };
+            inline static Uniforms uniforms;
             
             void processMaterialInfo(Component::MaterialInfo info);
     };
@@ -1,5 +1,11 @@
 #pragma once
 
+#include "cluster.hpp"
 #include "module.hpp"
 #include "postprocessing.hpp"
-#include "renderer.hpp"
\ No newline at end of file
+#include "profiler.hpp"
+#include "renderer.hpp"
+#include "rendergraph.hpp"
+#include "renderqueue.hpp"
+#include "rendertargetpool.hpp"
+#include "shadowatlas.hpp"
\ No newline at end of file
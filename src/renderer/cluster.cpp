@@ -0,0 +1,141 @@
+#include "renderer/cluster.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Renderer {
+
+    LightClusterGrid::LightClusterGrid(int tiles_x, int tiles_y, int depth_slices)
+        : tilesX(tiles_x),
+        tilesY(tiles_y),
+        depthSlices(depth_slices),
+        clusterMin(ClusterCount()),
+        clusterMax(ClusterCount()),
+        clusters(ClusterCount(), Cluster{0, 0})
+    {}
+
+    int LightClusterGrid::DepthSlice(float depth) const {
+        const int slice = static_cast<int>(std::floor(std::log(depth) * depthScale - depthBias));
+        return std::clamp(slice, 0, depthSlices - 1);
+    }
+
+    void LightClusterGrid::SetProjection(const glm::mat4& proj) {
+        if (proj == projection)
+            return;
+        projection = proj;
+
+        // Extract clip planes from a standard OpenGL perspective matrix
+        nearPlane = projection[3][2] / (projection[2][2] - 1.f);
+        farPlane = projection[3][2] / (projection[2][2] + 1.f);
+        depthScale = depthSlices / std::log(farPlane / nearPlane);
+        depthBias = depthSlices * std::log(nearPlane) / std::log(farPlane / nearPlane);
+
+        // Viewspace direction through each tile corner, scaled so that z = -1
+        const glm::mat4 invProjection = glm::inverse(projection);
+        std::vector<glm::vec3> corners((tilesX + 1) * (tilesY + 1));
+        for (int y = 0; y <= tilesY; y++) {
+            for (int x = 0; x <= tilesX; x++) {
+                const glm::vec2 ndc = glm::vec2(x, y) / glm::vec2(tilesX, tilesY) * 2.f - 1.f;
+                const glm::vec4 p = invProjection * glm::vec4(ndc, -1, 1);
+                const glm::vec3 v = glm::vec3(p) / p.w;
+                corners[x + (tilesX + 1) * y] = v / -v.z;
+            }
+        }
+
+        for (int z = 0; z < depthSlices; z++) {
+            const float sliceNear = nearPlane * std::pow(farPlane / nearPlane, static_cast<float>(z) / depthSlices);
+            const float sliceFar = nearPlane * std::pow(farPlane / nearPlane, static_cast<float>(z + 1) / depthSlices);
+            for (int y = 0; y < tilesY; y++) {
+                for (int x = 0; x < tilesX; x++) {
+                    glm::vec3 bmin(INFINITY), bmax(-INFINITY);
+                    for (int c = 0; c < 4; c++) {
+                        const glm::vec3& dir = corners[(x + c % 2) + (tilesX + 1) * (y + c / 2)];
+                        bmin = glm::min(bmin, glm::min(dir * sliceNear, dir * sliceFar));
+                        bmax = glm::max(bmax, glm::max(dir * sliceNear, dir * sliceFar));
+                    }
+                    const int i = ClusterIndex(x, y, z);
+                    clusterMin[i] = bmin;
+                    clusterMax[i] = bmax;
+                }
+            }
+        }
+    }
+
+    void LightClusterGrid::Build(const std::vector<LightSphere>& lights) {
+        pairs.clear();
+
+        for (unsigned int i = 0; i < lights.size(); i++) {
+            const LightSphere& light = lights[i];
+            const float depthNear = -(light.center.z + light.radius);
+            const float depthFar = -(light.center.z - light.radius);
+            if (depthFar < nearPlane || depthNear > farPlane)
+                continue;
+
+            // Candidate clusters: depth slices spanned by the sphere (padded by one to absorb rounding at slice boundaries), then
+            // per slice the tiles whose bounds overlap the sphere's extent. A tile's x extent depends only on its column and slice,
+            // and its y extent only on its row and slice, so each axis can be narrowed independently.
+            const int z0 = std::max(DepthSlice(std::max(depthNear, nearPlane)) - 1, 0);
+            const int z1 = std::min(DepthSlice(std::min(depthFar, farPlane)) + 1, depthSlices - 1);
+            for (int z = z0; z <= z1; z++) {
+                int x0 = 0, x1 = tilesX - 1;
+                while (x0 < tilesX && clusterMax[ClusterIndex(x0, 0, z)].x < light.center.x - light.radius)
+                    x0++;
+                while (x1 >= x0 && clusterMin[ClusterIndex(x1, 0, z)].x > light.center.x + light.radius)
+                    x1--;
+                int y0 = 0, y1 = tilesY - 1;
+                while (y0 < tilesY && clusterMax[ClusterIndex(0, y0, z)].y < light.center.y - light.radius)
+                    y0++;
+                while (y1 >= y0 && clusterMin[ClusterIndex(0, y1, z)].y > light.center.y + light.radius)
+                    y1--;
+
+                for (int y = y0; y <= y1; y++) {
+                    for (int x = x0; x <= x1; x++) {
+                        const int cluster = ClusterIndex(x, y, z);
+                        if (intersects(light, cluster))
+                            pairs.emplace_back(cluster, i);
+                    }
+                }
+            }
+        }
+
+        compactPairs();
+    }
+
+    void LightClusterGrid::BuildBruteForce(const std::vector<LightSphere>& lights) {
+        pairs.clear();
+        for (unsigned int i = 0; i < lights.size(); i++) {
+            for (int cluster = 0; cluster < ClusterCount(); cluster++) {
+                if (intersects(lights[i], cluster))
+                    pairs.emplace_back(cluster, i);
+            }
+        }
+        compactPairs();
+    }
+
+    bool LightClusterGrid::intersects(const LightSphere& light, int cluster) const {
+        // Squared distance from sphere center to the closest point of the cluster's box
+        const glm::vec3 closest = glm::clamp(light.center, clusterMin[cluster], clusterMax[cluster]);
+        const glm::vec3 d = light.center - closest;
+        return glm::dot(d, d) <= light.radius * light.radius;
+    }
+
+    void LightClusterGrid::compactPairs() {
+        // Counting sort by cluster; stable, so light indices stay in ascending order within each cluster
+        for (auto& cluster : clusters)
+            cluster = {0, 0};
+        for (const auto& [cluster, _] : pairs)
+            clusters[cluster].count++;
+        unsigned int offset = 0;
+        for (auto& cluster : clusters) {
+            cluster.offset = offset;
+            offset += cluster.count;
+            cluster.count = 0;
+        }
+        lightIndices.resize(pairs.size());
+        for (const auto& [cluster, light] : pairs) {
+            Cluster& c = clusters[cluster];
+            lightIndices[c.offset + c.count++] = light;
+        }
+    }
+
+}
\ No newline at end of file
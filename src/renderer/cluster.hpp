@@ -0,0 +1,64 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace Renderer {
+
+    // Froxel grid for clustered light culling. The view frustum is split into tilesX * tilesY screen tiles and
+    // depthSlices exponentially spaced depth slices, and each cluster lists the point lights whose sphere of influence overlaps it.
+    // Has no GL dependencies so the culling can be run and verified on the CPU alone.
+    class LightClusterGrid {
+        public:
+            struct LightSphere {
+                glm::vec3 center;   // Viewspace
+                float radius;
+            };
+            struct Cluster {
+                unsigned int offset;    // Into LightIndices()
+                unsigned int count;
+            };
+
+            LightClusterGrid(int tiles_x = 16, int tiles_y = 9, int depth_slices = 24);
+
+            const int tilesX, tilesY, depthSlices;
+
+            int ClusterCount() const { return tilesX * tilesY * depthSlices; }
+            int ClusterIndex(int x, int y, int z) const { return x + tilesX * (y + tilesY * z); }
+            float NearPlane() const { return nearPlane; }
+            float FarPlane() const { return farPlane; }
+            // Depth slice of a viewspace depth d (positive) is floor(log(d) * DepthScale() - DepthBias())
+            float DepthScale() const { return depthScale; }
+            float DepthBias() const { return depthBias; }
+            int DepthSlice(float depth) const;
+
+            const std::vector<Cluster>& Clusters() const { return clusters; }
+            const std::vector<unsigned int>& LightIndices() const { return lightIndices; }
+            const glm::vec3& ClusterMin(int cluster) const { return clusterMin[cluster]; }
+            const glm::vec3& ClusterMax(int cluster) const { return clusterMax[cluster]; }
+
+            // Recomputes the viewspace cluster bounds. Near and far planes are extracted from the (perspective) projection matrix.
+            void SetProjection(const glm::mat4& projection);
+            // Assigns each light to every cluster its sphere overlaps. Each cluster's light list is in ascending light index order.
+            void Build(const std::vector<LightSphere>& lights);
+            // Reference implementation that tests every light against every cluster. Produces the same result as Build().
+            void BuildBruteForce(const std::vector<LightSphere>& lights);
+
+        private:
+            glm::mat4 projection = glm::mat4(0);
+            float nearPlane = 0.1f;
+            float farPlane = 100.f;
+            float depthScale = 0.f;
+            float depthBias = 0.f;
+
+            std::vector<glm::vec3> clusterMin, clusterMax;
+            std::vector<Cluster> clusters;
+            std::vector<unsigned int> lightIndices;
+            std::vector<std::pair<unsigned int, unsigned int>> pairs;   // (cluster, light) scratch
+
+            bool intersects(const LightSphere& light, int cluster) const;
+            void compactPairs();
+    };
+
+}
\ No newline at end of file
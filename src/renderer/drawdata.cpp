@@ -0,0 +1,131 @@
+#include "renderer/drawdata.hpp"
+
+#include "material/material.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+namespace Renderer {
+
+    DrawDataBuffer::DrawDataBuffer()
+        : drawTbo(std::make_shared<Core::Tbo>(GL_RGBA32F)),
+        materialTbo(std::make_shared<Core::Tbo>(GL_RGBA32F))
+    {}
+
+    DrawDataBuffer::~DrawDataBuffer() {
+        if (current == this)
+            current = nullptr;
+        if (immediate == this)
+            immediate = nullptr;
+    }
+
+    void DrawDataBuffer::Clear() {
+        drawData.clear();
+        materialData.clear();
+        materialIndices.clear();
+    }
+
+    unsigned int DrawDataBuffer::Add(const glm::mat4& model, Material::MaterialBase* material) {
+        // Materials are stored once per frame, in order of first use. Index 0 is a default for meshes without one.
+        if (materialData.empty()) {
+            Material::MaterialRecord record;
+            materialData.push_back(record.albedoMetallic);
+            materialData.push_back(record.roughnessFlags);
+        }
+        unsigned int materialIndex = 0;
+        if (material) {
+            auto [it, inserted] = materialIndices.try_emplace(material, materialData.size() / 2);
+            if (inserted) {
+                Material::MaterialRecord record;
+                material->FillMaterialRecord(record);
+                materialData.push_back(record.albedoMetallic);
+                materialData.push_back(record.roughnessFlags);
+            }
+            materialIndex = it->second;
+        }
+
+        const unsigned int id = drawData.size() / 8;
+        const glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+        drawData.insert(drawData.end(), {model[0], model[1], model[2], model[3]});
+        drawData.insert(drawData.end(), {glm::vec4(normalMatrix[0], 0), glm::vec4(normalMatrix[1], 0), glm::vec4(normalMatrix[2], 0)});
+        drawData.emplace_back(materialIndex, 0, 0, 0);
+        return id;
+    }
+
+    void DrawDataBuffer::Upload() {
+        drawTbo->UpdateData(drawData.size() * sizeof(glm::vec4), drawData.data());
+        materialTbo->UpdateData(materialData.size() * sizeof(glm::vec4), materialData.data());
+    }
+
+    void DrawDataBuffer::Bind() {
+        drawTbo->Bind(drawTexUnit);
+        materialTbo->Bind(materialTexUnit);
+        current = this;
+    }
+
+    void DrawDataBuffer::RebindCurrent() {
+        if (current)
+            current->Bind();
+    }
+
+    void DrawDataBuffer::SetFirstInstance(unsigned int first_instance) {
+        glVertexAttribI1ui(firstInstanceLocation, first_instance);
+        Core::GeometryArena::SetFirstInstance(first_instance);
+    }
+
+    void DrawDataBuffer::DrawImmediate(const glm::mat4& model, Material::MaterialBase* material) {
+        if (!immediate)
+            throw std::runtime_error("DrawDataBuffer::DrawImmediate() needs an immediate table; renderers set one in Render()");
+        immediate->appendImmediate(model, material);
+    }
+
+    void DrawDataBuffer::BeginImmediate() {
+        Clear();
+        drawTexelsUploaded = 0;
+        materialTexelsUploaded = 0;
+        immediate = this;
+    }
+
+    void DrawDataBuffer::appendImmediate(const glm::mat4& model, Material::MaterialBase* material) {
+        const unsigned int id = Add(model, material);
+        if (drawTexelsUploaded == 0) {
+            // First append of the frame: orphan, as last frame's draws may still read the stores
+            Upload();
+            drawTexelsUploaded = drawData.size();
+            materialTexelsUploaded = materialData.size();
+        } else {
+            uploadTail(*drawTbo, drawData, drawTexelsUploaded);
+            uploadTail(*materialTbo, materialData, materialTexelsUploaded);
+        }
+
+        if (!instanceTbo)
+            instanceTbo = std::make_shared<Core::Tbo>(GL_R32UI);
+        if (id >= instanceCount) {
+            instanceCount = std::max(64u, 2 * (id + 1));
+            std::vector<unsigned int> identity(instanceCount);
+            std::iota(identity.begin(), identity.end(), 0u);
+            instanceTbo->UpdateData(identity.size() * sizeof(unsigned int), identity.data());
+        }
+
+        // Not through Bind(), which would make it current
+        drawTbo->Bind(drawTexUnit);
+        materialTbo->Bind(materialTexUnit);
+        instanceTbo->Bind(instanceTexUnit);
+        SetFirstInstance(id);
+    }
+
+    void DrawDataBuffer::uploadTail(Core::Tbo& tbo, const std::vector<glm::vec4>& data, size_t& uploaded) {
+        if (uploaded == data.size())
+            return;
+        const size_t size = data.size() * sizeof(glm::vec4);
+        if (size > tbo.Capacity()) {
+            tbo.UpdateData(size, data.data());
+        } else {
+            const size_t offset = uploaded * sizeof(glm::vec4);
+            tbo.UpdateSubData(offset, size - offset, data.data() + uploaded);
+        }
+        uploaded = data.size();
+    }
+
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "core/globject.hpp"
+
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace Material {
+    class MaterialBase;
+}
+
+namespace Renderer {
+
+    // Per-frame table of everything a draw needs besides its mesh: model matrix, normal matrix and material constants.
+    // Shaders fetch their record from texture buffers with a draw ID, so a draw costs one attribute value instead of uniform calls.
+    // Layout (RGBA32F): per draw, model matrix (4 texels), normal matrix (3), material index (1); per material, 2 texels
+    // as filled by MaterialBase::FillMaterialRecord().
+    // Draw IDs are not passed directly but through an instance list (R32UI, bound by whoever submits), so that one
+    // instanced call can draw any set of records: instance i of a call reads list[first_instance + i].
+    class DrawDataBuffer {
+        public:
+            static constexpr int drawTexUnit = 13;
+            static constexpr int materialTexUnit = 14;
+            static constexpr int instanceTexUnit = 15;
+            // Vertex attribute that carries first_instance. On GL 4.1 it is a constant attribute, set per draw by
+            // SetFirstInstance(). Under multi-draw indirect (GL 4.3+), arena VAOs back it with an identity buffer read at the
+            // draw's base instance, see Core::GeometryArena::setInstanceIdFormat().
+            static constexpr GLuint firstInstanceLocation = 5;
+
+            DrawDataBuffer();
+            // Rule of five
+            ~DrawDataBuffer();
+            DrawDataBuffer(const DrawDataBuffer& other) = delete;
+            DrawDataBuffer(DrawDataBuffer&& other) = delete;
+            DrawDataBuffer& operator=(const DrawDataBuffer& other) = delete;
+            DrawDataBuffer& operator=(DrawDataBuffer&& other) = delete;
+
+            void Clear();
+            // Appends a draw's record and returns its draw ID
+            unsigned int Add(const glm::mat4& model, Material::MaterialBase* material);
+            void Upload();
+            // Binds both tables to their texture units, as the ones RebindCurrent() restores
+            void Bind();
+            // Rebinds the tables of the last Bind(), which a DrawImmediate() since may have replaced. Free if it has not.
+            static void RebindCurrent();
+
+            // Where following draws start reading the instance list; GL 4.1 has no base instance to do this
+            static void SetFirstInstance(unsigned int first_instance);
+            // For draws that do not go through a frame's table: appends a record to the immediate table and selects it.
+            // Leaves that table bound in place of the frame's; RenderQueue submits put the frame's back. Throws if there
+            // is no immediate table.
+            static void DrawImmediate(const glm::mat4& model, Material::MaterialBase* material);
+            // Empties this table and makes it the one DrawImmediate() appends to, until another table is or this one is
+            // destroyed. Call once per frame; appends only upload their own records.
+            void BeginImmediate();
+
+        private:
+            std::vector<glm::vec4> drawData;
+            std::vector<glm::vec4> materialData;
+            std::unordered_map<Material::MaterialBase*, unsigned int> materialIndices;
+            std::shared_ptr<Core::Tbo> drawTbo;
+            std::shared_ptr<Core::Tbo> materialTbo;
+            inline static DrawDataBuffer* current = nullptr;   // Of the last Bind()
+
+            // ---- Immediate table ----
+            std::shared_ptr<Core::Tbo> instanceTbo;     // Identity instance list, so a draw ID is its own first instance
+            unsigned int instanceCount = 0;
+            size_t drawTexelsUploaded = 0;              // Of this frame; 0 until the first append orphans the stores
+            size_t materialTexelsUploaded = 0;
+            inline static DrawDataBuffer* immediate = nullptr;
+
+            void appendImmediate(const glm::mat4& model, Material::MaterialBase* material);
+            // Uploads texels [uploaded, data.size()), or all of them if the store has to grow
+            static void uploadTail(Core::Tbo& tbo, const std::vector<glm::vec4>& data, size_t& uploaded);
+    };
+
+}
\ No newline at end of file
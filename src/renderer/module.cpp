@@ -4,10 +4,16 @@
 #include "component/light.hpp"
 #include "component/primitive.hpp"
 #include "asset/manager.hpp"
+#include "core/glstate.hpp"
+#include "renderer/drawdata.hpp"
+#include "renderer/rendertargetpool.hpp"
 #include "scene/scene.hpp"
 #include "scene/scenenode.hpp"
 
+#include <algorithm>
 #include <set>
+#include <stdexcept>
+#include <string>
 
 #include <random>
 
@@ -15,12 +21,45 @@
 
 namespace Renderer {
 
-    DirectionalShadowModule::DirectionalShadowModule(int map_width, int map_height, int num_layers)
-        : mapWidth(map_width),
-        mapHeight(map_height),
-        numLayers(num_layers),
-        depthMap(std::make_shared<Core::Tex3D>(GL_TEXTURE_2D_ARRAY, GL_DEPTH_COMPONENT24, map_width, map_height, num_layers, GL_DEPTH_COMPONENT, GL_FLOAT, GL_CLAMP_TO_EDGE, GL_LINEAR, true)),
-        fbo(map_width, map_height)
+    namespace {
+        // Splits culled drawables into the shadow casters that a static cache holds and the ones drawn every frame
+        void splitCasters(const Scene::Scene& scene, const std::vector<unsigned int>& visible, std::vector<unsigned int>& static_casters, std::vector<unsigned int>& dynamic_casters) {
+            static_casters.clear();
+            dynamic_casters.clear();
+            for (unsigned int idx : visible) {
+                const Scene::Drawable& drawable = scene.Drawables()[idx];
+                if (drawable.mesh->castShadows)
+                    (drawable.dynamic ? dynamic_casters : static_casters).push_back(idx);
+            }
+        }
+    }
+
+    DepthPrepassModule::DepthPrepassModule() {
+        if (!program) {
+            AssetManager& manager = AssetManager::Instance();
+
+            auto vs = manager.LoadHot<ShaderAsset>("assets/shaders/shaderv_depth.vs", GL_VERTEX_SHADER);
+            auto fs = manager.LoadHot<ShaderAsset>("assets/shaders/shaderf_depth.fs", GL_FRAGMENT_SHADER);
+
+            program = std::make_shared<Core::Program>(vs, fs);
+            program->SetUniformBlockBindingScheme(Core::Program::UboScheme::Scheme1);
+            instanceDrawsUniform = program->GetUniform<int>("instanceDraws");
+            drawDataUniform = program->GetUniform<int>("drawData");
+        }
+    }
+
+    void DepthPrepassModule::Render(const Scene::Scene& scene, RenderQueue& queue) {
+        program->Use();
+        program->Set(instanceDrawsUniform, DrawDataBuffer::instanceTexUnit);
+        program->Set(drawDataUniform, DrawDataBuffer::drawTexUnit);
+        Core::GlState::Instance().ColorMask(false);
+        Core::GlState::Instance().DepthMask(true);
+        queue.Submit(scene, *this);
+        Core::GlState::Instance().ColorMask(true);
+    }
+
+    DirectionalShadowModule::DirectionalShadowModule(ShadowAtlas& atlas)
+        : atlas(atlas)
     {
         if (!program) {
             AssetManager& manager = AssetManager::Instance();
@@ -30,55 +69,85 @@ namespace Renderer {
             
             program = std::make_shared<Core::Program>(vs, fs);
             program->SetUniformBlockBindingScheme(Core::Program::UboScheme::Scheme1);
+            instanceDrawsUniform = program->GetUniform<int>("instanceDraws");
+            drawDataUniform = program->GetUniform<int>("drawData");
+            lightSpaceMatrixUniform = program->GetUniform<glm::mat4>("lightSpaceMatrix");
         }
-        fbo.Bind();
-        fbo.AttachDepthTex(depthMap);
-        glDrawBuffer(GL_NONE);  // No colorbuffer
-        glReadBuffer(GL_NONE);  // No colorbuffer
-        fbo.CheckStatus();
     }
 
-    void DirectionalShadowModule::Render(Scene::Scene& scene, const std::vector<Scene::SceneNode*>& dirlight_nodes) {
-        fbo.Bind();
-        fbo.SetViewportDims();
-        fbo.ClearDepth();
+    void DirectionalShadowModule::Render(Scene::Scene& scene, const std::vector<Scene::LightRegistry::DirectionalLightEntry>& dirlights) {
         program->Use();
+        program->Set(instanceDrawsUniform, DrawDataBuffer::instanceTexUnit);
+        program->Set(drawDataUniform, DrawDataBuffer::drawTexUnit);
+        Core::GlState::Instance().CullFace(GL_FRONT);
+        stats = CullStats();
+        tilesRendered = 0;
+
+        // Grouped by VAO; depth order does not matter for an orthographic depth-only pass
+        auto drawCasters = [&](const std::vector<unsigned int>& casters) {
+            queue.Clear();
+            queue.Push(scene, casters, RenderQueue::Pass::DirectionalShadow, false, glm::vec3(0), 0.f);
+            queue.Sort();
+            queue.Submit(scene, *this);
+        };
         
-        for (int i = 0, shadow_count = 0; i < dirlight_nodes.size() && shadow_count < numLayers; i++) {
-            Component::DirectionalLight& dirlight = dynamic_cast<Component::DirectionalLight&>(*dirlight_nodes[i]->component);
+        for (const auto& entry : dirlights) {
+            Component::DirectionalLight& dirlight = *entry.light;
             
-            if (dirlight.HasShadows()) {
-                setGlobalUniforms(dirlight, fbo.depthAtt->Handle(), &shadow_count);
-                
-                glCullFace(GL_FRONT);
-                scene.Draw(*this);
-                glCullFace(GL_BACK);
+            // Lights without shadows, or that the atlas had no room for, have no tiles
+            std::vector<ShadowAtlas::Slot>* slots = atlas.Slots(&dirlight);
+            if (!slots)
+                continue;
+            for (size_t c = 0; c < slots->size(); c++) {
+                ShadowAtlas::Slot& slot = (*slots)[c];
+                const glm::mat4& lightspace = dirlight.CascadeMatrices()[c];
+
+                // Only draw casters inside the cascade's orthographic box
+                visibleDrawables.clear();
+                scene.DrawableBvh().Query(Bounds::Frustum(lightspace), visibleDrawables);
+                stats.drawn += visibleDrawables.size();
+                stats.culled += scene.Drawables().size() - visibleDrawables.size();
+                splitCasters(scene, visibleDrawables, staticCasters, dynamicCasters);
+
+                // ---- Skip the tile if nothing in it changed ----
+                const bool staticStale = slot.StaticStale(lightspace, scene.StaticVersion());
+                const bool hasDynamic = !dynamicCasters.empty();
+                if (!staticStale && !hasDynamic && !slot.hadDynamic)
+                    continue;
+                program->Set(lightSpaceMatrixUniform, lightspace);
+
+                // ---- Static casters, into the cache ----
+                if (staticStale) {
+                    atlas.BeginStatic(slot.tile);
+                    drawCasters(staticCasters);
+                    slot.CacheStatic(lightspace, scene.StaticVersion());
+                }
+
+                // ---- Dynamic casters, over a copy of it ----
+                atlas.BeginDynamic(slot.tile);
+                if (hasDynamic)
+                    drawCasters(dynamicCasters);
+                slot.hadDynamic = hasDynamic;
+                tilesRendered++;
             }
         }
+        Core::GlState::Instance().CullFace(GL_BACK);
     }
     
     void DirectionalShadowModule::SetObjectUniforms(const glm::mat4& model, const Component::ComponentBase& component) {
-        program->SetMat4("model", model);
+        // Only reached by immediate draws; queued draws read the frame's DrawDataBuffer
+        DrawDataBuffer::DrawImmediate(model, nullptr);
     }
 
     bool DirectionalShadowModule::AllowDraw(const Component::ComponentBase& component) {
         if (component.IsMesh()) {
-            return dynamic_cast<const Component::Mesh&>(component).castShadows;
+            return static_cast<const Component::Mesh&>(component).castShadows;
         }
         return true;
     }
-
-    void DirectionalShadowModule::setGlobalUniforms(Component::DirectionalLight& dl, GLuint depth_texture, int* shadow_idx) {
-        program->SetMat4("lightSpaceMatrix", dl.LightspaceMatrix());
-        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depth_texture, 0, (*shadow_idx)++);
-    }
     
-    PointShadowModule::PointShadowModule(int map_width, int map_height, int num_layers)
-        : mapWidth(map_width),
-        mapHeight(map_height),
-        numLayers(num_layers),
-        depthMap(std::make_shared<Core::Tex3D>(GL_TEXTURE_CUBE_MAP_ARRAY, GL_DEPTH_COMPONENT24, map_width, map_height, 6 * num_layers, GL_DEPTH_COMPONENT, GL_FLOAT, GL_CLAMP_TO_EDGE, GL_LINEAR, true)),
-        fbo(map_width, map_height)
+    PointShadowModule::PointShadowModule(ShadowAtlas& atlas)
+        : atlas(atlas)
     {
         if (!program) {
             AssetManager& manager = AssetManager::Instance();
@@ -88,42 +157,144 @@ namespace Renderer {
             
             program = std::make_shared<Core::Program>(vs, fs, gs);
             program->SetUniformBlockBindingScheme(Core::Program::UboScheme::Scheme1);
+            instanceDrawsUniform = program->GetUniform<int>("instanceDraws");
+            drawDataUniform = program->GetUniform<int>("drawData");
+            lightSpaceMatricesUniform = program->GetUniform<glm::mat4>("lightSpaceMatrices");
+            lightPosUniform = program->GetUniform<glm::vec3>("lightPos");
+            farUniform = program->GetUniform<float>("far");
+
+            programPerFace = std::make_shared<Core::Program>(vs, fs, nullptr, "#define PER_FACE");
+            programPerFace->SetUniformBlockBindingScheme(Core::Program::UboScheme::Scheme1);
+            faceInstanceDrawsUniform = programPerFace->GetUniform<int>("instanceDraws");
+            faceDrawDataUniform = programPerFace->GetUniform<int>("drawData");
+            faceMatrixUniform = programPerFace->GetUniform<glm::mat4>("lightSpaceMatrix");
+            faceLightPosUniform = programPerFace->GetUniform<glm::vec3>("lightPos");
+            faceFarUniform = programPerFace->GetUniform<float>("far");
         }
-        fbo.Bind();
-        fbo.AttachDepthTex(depthMap);
-        glDrawBuffer(GL_NONE);  // No colorbuffer
-        glReadBuffer(GL_NONE);  // No colorbuffer
-        fbo.CheckStatus();
     }
 
-    void PointShadowModule::Render(Scene::Scene& scene, const std::vector<Scene::SceneNode*>& pointlight_nodes) {
+    void PointShadowModule::Render(Scene::Scene& scene, const std::vector<Scene::LightRegistry::PointLightEntry>& pointlights) {
         // ---- Generate PointLight shadow maps ----
-        fbo.Bind();
-        fbo.SetViewportDims();
-        fbo.ClearDepth();
-        program->Use();
+        const bool perFace = cubeMode == CubeMode::PerFace;
+        if (perFace) {
+            programPerFace->Use();
+            programPerFace->Set(faceInstanceDrawsUniform, DrawDataBuffer::instanceTexUnit);
+            programPerFace->Set(faceDrawDataUniform, DrawDataBuffer::drawTexUnit);
+        } else {
+            program->Use();
+            program->Set(instanceDrawsUniform, DrawDataBuffer::instanceTexUnit);
+            program->Set(drawDataUniform, DrawDataBuffer::drawTexUnit);
+        }
+        Core::GlState::Instance().CullFace(GL_FRONT);
+        stats = CullStats();
+        tilesRendered = 0;
+
+        for (const auto& entry : pointlights) {
+            Component::PointLight& pointlight = *entry.light;
+
+            // Lights without shadows, out of view, or that the atlas had no room for, have no tiles
+            std::vector<ShadowAtlas::Slot>* slots = atlas.Slots(&pointlight);
+            if (!slots)
+                continue;
+            const glm::vec3 position = entry.node->WorldMatrix()[3];
+            const std::vector<glm::mat4>& lightspace = pointlight.LightspaceMatrices();
+
+            // Cull against the union of the faces: a sphere out to the far plane. Nothing beyond the light's radius is lit,
+            // so nothing there can cast a visible shadow either. Per-face draws cull each face's share further below.
+            visibleDrawables.clear();
+            const float radius = std::min(pointlight.FarPlane(), pointlight.Radius());
+            scene.DrawableBvh().Query(Bounds::Sphere{position, radius}, visibleDrawables);
+            stats.drawn += visibleDrawables.size();
+            stats.culled += scene.Drawables().size() - visibleDrawables.size();
+            splitCasters(scene, visibleDrawables, staticCasters, dynamicCasters);
+            setGlobalUniforms(pointlight, position);
+
+            // Grouped by VAO, then nearest to the light first
+            auto drawCasters = [&](const std::vector<unsigned int>& casters) {
+                queue.Clear();
+                queue.Push(scene, casters, RenderQueue::Pass::PointShadow, false, position, radius);
+                queue.Sort();
+                queue.Submit(scene, *this);
+            };
+
+            if (perFace) {
+                for (int face = 0; face < 6; face++) {
+                    ShadowAtlas::Slot& slot = (*slots)[face];
+
+                    // Only casters that touch the face's frustum
+                    const Bounds::Frustum frustum(lightspace[face]);
+                    auto faceCasters = [&](const std::vector<unsigned int>& casters, std::vector<unsigned int>& face_casters) {
+                        face_casters.clear();
+                        for (unsigned int idx : casters) {
+                            if (frustum.Intersects(scene.DrawableBounds().At(idx)))
+                                face_casters.push_back(idx);
+                        }
+                    };
+                    faceCasters(dynamicCasters, faceDynamicCasters);
+
+                    // ---- Skip the face if nothing in it changed ----
+                    const bool staticStale = slot.StaticStale(lightspace[face], scene.StaticVersion());
+                    const bool hasDynamic = !faceDynamicCasters.empty();
+                    if (!staticStale && !hasDynamic && !slot.hadDynamic)
+                        continue;
+                    programPerFace->Set(faceMatrixUniform, lightspace[face]);
+
+                    // ---- Static casters, into the cache ----
+                    if (staticStale) {
+                        faceCasters(staticCasters, faceStaticCasters);
+                        atlas.BeginStatic(slot.tile);
+                        drawCasters(faceStaticCasters);
+                        slot.CacheStatic(lightspace[face], scene.StaticVersion());
+                    }
+
+                    // ---- Dynamic casters, over a copy of it ----
+                    atlas.BeginDynamic(slot.tile);
+                    if (hasDynamic)
+                        drawCasters(faceDynamicCasters);
+                    slot.hadDynamic = hasDynamic;
+                    tilesRendered++;
+                }
+                continue;
+            }
 
-        for (int i = 0, shadow_count = 0; i < pointlight_nodes.size() && shadow_count < numLayers; i++) {
-            Component::PointLight& pointlight = dynamic_cast<Component::PointLight&>(*pointlight_nodes[i]->component);
+            // ---- Skip the cube map if nothing in it changed ----
+            // The geometry shader draws every face at once, so all six are redrawn if any one has to be
+            bool staticStale = false, hadDynamic = false;
+            for (int face = 0; face < 6; face++) {
+                staticStale = staticStale || (*slots)[face].StaticStale(lightspace[face], scene.StaticVersion());
+                hadDynamic = hadDynamic || (*slots)[face].hadDynamic;
+            }
+            const bool hasDynamic = !dynamicCasters.empty();
+            if (!staticStale && !hasDynamic && !hadDynamic)
+                continue;
 
-            if (pointlight.HasShadows()) {
-                glm::mat4 worldTransform = glm::identity<glm::mat4>();
-                Scene::SceneNode* currNode = pointlight_nodes[i];
-                while (currNode) {
-                    worldTransform = currNode->transform.Matrix() * worldTransform;
-                    currNode = currNode->parent;
+            // ---- Static casters, into the cache ----
+            if (staticStale) {
+                for (int face = 0; face < 6; face++) {
+                    atlas.BeginStatic((*slots)[face].tile);
+                    (*slots)[face].CacheStatic(lightspace[face], scene.StaticVersion());
                 }
-                setGlobalUniforms(pointlight, worldTransform[3], &shadow_count);
-                
-                glCullFace(GL_FRONT);
-                scene.Draw(*this);
-                glCullFace(GL_BACK);
+                ShadowAtlas::SetViewports(*slots);
+                drawCasters(staticCasters);
+            }
+
+            // ---- Dynamic casters, over a copy of it ----
+            for (int face = 0; face < 6; face++) {
+                atlas.BeginDynamic((*slots)[face].tile);
+                (*slots)[face].hadDynamic = hasDynamic;
+            }
+            if (hasDynamic) {
+                ShadowAtlas::SetViewports(*slots);
+                drawCasters(dynamicCasters);
             }
+            tilesRendered += 6;
         }
+        Core::GlState::Instance().CullFace(GL_BACK);
     }
 
     void PointShadowModule::SetObjectUniforms(const glm::mat4& model, const Component::ComponentBase& component) {
-        program->SetMat4("model", model);
+        // Only reached by immediate draws; queued draws read the frame's DrawDataBuffer
+        DrawDataBuffer::DrawImmediate(model, nullptr);
     }
 
     bool PointShadowModule::AllowDraw(const Component::ComponentBase& component) {
@@ -133,13 +304,16 @@ namespace Renderer {
         return true;
     }
 
-    void PointShadowModule::setGlobalUniforms(Component::PointLight& pl, const glm::vec3& position, int* shadow_idx) {
-        program->SetInt("layer", (*shadow_idx)++);
-        for (int j = 0; j < 6; j++) {
-            program->SetMat4("lightSpaceMatrices[" + std::to_string(j) + "]", pl.LightspaceMatrices()[j]);
+    void PointShadowModule::setGlobalUniforms(Component::PointLight& pl, const glm::vec3& position) {
+        if (cubeMode == CubeMode::PerFace) {
+            // The face's matrix is set per draw
+            programPerFace->Set(faceLightPosUniform, position);
+            programPerFace->Set(faceFarUniform, pl.FarPlane());
+            return;
         }
-        program->SetVec3("lightPos", position);
-        program->SetFloat("far", pl.FarPlane());
+        program->Set(lightSpaceMatricesUniform, pl.LightspaceMatrices().data(), 6);
+        program->Set(lightPosUniform, position);
+        program->Set(farUniform, pl.FarPlane());
     }
 
     SkyboxModule::SkyboxModule() {
@@ -150,6 +324,9 @@ namespace Renderer {
             
             program = std::make_shared<Core::Program>(vs, fs);
             program->SetUniformBlockBindingScheme(Core::Program::UboScheme::Scheme1);
+            viewUniform = program->GetUniform<glm::mat4>("view");
+            projectionUniform = program->GetUniform<glm::mat4>("projection");
+            cubemapUniform = program->GetUniform<int>("cubemap");
         }
     }
     
@@ -160,58 +337,36 @@ namespace Renderer {
         setGlobalUniforms(camera, 0);
         skybox.Bind(0);
         
-        glCullFace(GL_FRONT);
+        Core::GlState::Instance().CullFace(GL_FRONT);
         cube.Draw(*this);
-        glCullFace(GL_BACK);
+        Core::GlState::Instance().CullFace(GL_BACK);
     }
 
     void SkyboxModule::setGlobalUniforms(Component::Camera& camera, int tex_unit) {
-        program->SetMat4("view", glm::mat4(glm::mat3(camera.View())));
-        program->SetMat4("projection", camera.projection);
-        program->SetInt("cubemap", tex_unit);
+        program->Set(viewUniform, glm::mat4(glm::mat3(camera.View())));
+        program->Set(projectionUniform, camera.projection);
+        program->Set(cubemapUniform, tex_unit);
     }
 
     SsaoModule::SsaoModule()
-        : ssao(std::make_shared<Core::Tex2D>(GL_TEXTURE_2D, GL_RED, 2, 2, GL_RED, GL_FLOAT, GL_CLAMP_TO_EDGE, GL_LINEAR)),
-        ssaoBlurred(std::make_shared<Core::Tex2D>(GL_TEXTURE_2D, GL_RED, 2, 2, GL_RED, GL_FLOAT, GL_CLAMP_TO_EDGE, GL_LINEAR)),
-        noise(GL_TEXTURE_2D, GL_RGBA16F, 4, 4, GL_RGB, GL_FLOAT, GL_REPEAT, GL_NEAREST),
-        fbo(2,2)
+        : noise(GL_TEXTURE_2D, GL_RGBA16F, 4, 4, GL_RGB, GL_FLOAT, GL_REPEAT, GL_NEAREST)
     {
-        if (!program) {
+        if (!programBlur) {
             AssetManager& manager = AssetManager::Instance();
 
             auto vs2d = manager.LoadHot<ShaderAsset>("assets/shaders/shaderv_2d.vs", GL_VERTEX_SHADER);
-            auto fsSsao = manager.LoadHot<ShaderAsset>("assets/shaders/shaderf_2dssao.fs", GL_FRAGMENT_SHADER);
-            auto fsSsaoBlur = manager.LoadHot<ShaderAsset>("assets/shaders/shaderf_2dssaoBlur.fs", GL_FRAGMENT_SHADER);
-            
-            program = std::make_shared<Core::Program>(vs2d, fsSsao);
-            program->SetUniformBlockBindingScheme(Core::Program::UboScheme::Scheme1);
+            auto fsSsaoBlur = manager.LoadHot<ShaderAsset>("assets/shaders/shaderf_2dssaoblur.fs", GL_FRAGMENT_SHADER);
 
             programBlur = std::make_shared<Core::Program>(vs2d, fsSsaoBlur);
             programBlur->SetUniformBlockBindingScheme(Core::Program::UboScheme::Scheme1);
+            blurInputUniform = programBlur->GetUniform<int>("ssaoInput");
+            blurDepthUniform = programBlur->GetUniform<int>("gDepth");
+            blurInvProjectionUniform = programBlur->GetUniform<glm::mat4>("inv_projection");
         }
-        fbo.Bind();
-        fbo.AttachColorTex(ssao);
-        fbo.AttachColorTex(ssaoBlurred);
-        fbo.CheckStatus();
 
-        // Generate sampling kernel (random vectors in tangent space in the +normal hemisphere)
+        // Generate noise texture (random vectors in tangent space on the tangent-bitangent plane)
         std::uniform_real_distribution<float> randomFloats(0.0f, 1.0f);
         std::default_random_engine generator;
-        for (int i = 0; i < 64; i++) {
-            glm::vec3 sample(
-                randomFloats(generator) * 2.0f - 1.0f,
-                randomFloats(generator) * 2.0f - 1.0f,
-                randomFloats(generator)
-            );
-            sample = randomFloats(generator) * glm::normalize(sample);
-            float scale = static_cast<float>(i) / 64.0f;
-            scale = 0.1f + scale*scale * (1.0f - 0.1f);    // lerp, places more samples closer to origin of hemisphere
-            sample *= scale;
-            kernel.push_back(sample);
-        }
-
-        // Generate noise texture (random vectors in tangent space on the tangent-bitangent plane)
         std::vector<glm::vec3> noiseVector;    
         for (int i = 0; i < 16; i++) {
             glm::vec3 sample(
@@ -225,40 +380,89 @@ namespace Renderer {
         noise.DefineImage(noiseVector.data());
     }
 
-    void SsaoModule::Render(Core::Tex& positions, Core::Tex& normals, const glm::mat4& projection) {
-        if (positions.width != fbo.width || positions.height != fbo.height) {
-            fbo.Resize(positions.width, positions.height);
+    SsaoModule::Variant& SsaoModule::variant(int sample_count) {
+        auto it = variants.find(sample_count);
+        if (it != variants.end())
+            return it->second;
+        if (sample_count != 8 && sample_count != 16 && sample_count != 32 && sample_count != 64)
+            throw std::runtime_error("SSAO sample count must be 8, 16, 32 or 64");
+
+        AssetManager& manager = AssetManager::Instance();
+        auto vs2d = manager.LoadHot<ShaderAsset>("assets/shaders/shaderv_2d.vs", GL_VERTEX_SHADER);
+        auto fsSsao = manager.LoadHot<ShaderAsset>("assets/shaders/shaderf_2dssao.fs", GL_FRAGMENT_SHADER);
+
+        Variant& v = variants[sample_count];
+        v.program = std::make_shared<Core::Program>(vs2d, fsSsao, nullptr, "#define KERNEL_SIZE " + std::to_string(sample_count));
+        v.program->SetUniformBlockBindingScheme(Core::Program::UboScheme::Scheme1);
+        v.depthUniform = v.program->GetUniform<int>("gDepth");
+        v.normalUniform = v.program->GetUniform<int>("gNormal");
+        v.noiseUniform = v.program->GetUniform<int>("noiseTexture");
+        v.projectionUniform = v.program->GetUniform<glm::mat4>("projection");
+        v.invProjectionUniform = v.program->GetUniform<glm::mat4>("inv_projection");
+
+        // Generate sampling kernel (random vectors in tangent space in the +normal hemisphere), padded to vec4 for std140
+        std::uniform_real_distribution<float> randomFloats(0.0f, 1.0f);
+        std::default_random_engine generator;
+        std::vector<glm::vec4> kernel;
+        for (int i = 0; i < sample_count; i++) {
+            glm::vec3 sample(
+                randomFloats(generator) * 2.0f - 1.0f,
+                randomFloats(generator) * 2.0f - 1.0f,
+                randomFloats(generator)
+            );
+            sample = randomFloats(generator) * glm::normalize(sample);
+            float scale = static_cast<float>(i) / sample_count;
+            scale = 0.1f + scale*scale * (1.0f - 0.1f);    // lerp, places more samples closer to origin of hemisphere
+            sample *= scale;
+            kernel.emplace_back(sample, 0.f);
         }
+        v.kernel = std::make_shared<Core::Ubo>(kernelBinding, kernel.size() * sizeof(glm::vec4));
+        v.kernel->UpdateData(0, kernel.size() * sizeof(glm::vec4), kernel.data());
+        return v;
+    }
 
-        fbo.Bind();
-        fbo.SetViewportDims();
+    void SsaoModule::Render(Core::Tex& depth, Core::Tex& normals, const glm::mat4& projection, const std::shared_ptr<Core::Tex>& output) {
+        const int divisor = static_cast<int>(resolution);
+        const int width = std::max(depth.width / divisor, 1), height = std::max(depth.height / divisor, 1);
+        RenderTargetPool& pool = RenderTargetPool::Instance();
+        std::shared_ptr<Core::Tex2D> ssao = pool.Acquire(width, height, GL_R8);
+
+        const glm::mat4 invProjection = glm::inverse(projection);
 
         // SSAO unblurred
-        glDrawBuffer(GL_COLOR_ATTACHMENT0);
+        Core::Fbo& fbo = pool.Framebuffer({ssao});
+        fbo.Bind();
+        fbo.SetViewportDims();
         fbo.ClearColor();
         
-        program->Use();
-        program->SetInt("gPosition", 0);
-        program->SetInt("gNormal", 1);
-        program->SetInt("noiseTexture", 2);
-        program->SetMat4("projection", projection);
-        positions.Bind(0);
+        Variant& v = variant(sampleCount);
+        v.program->Use();
+        v.program->Set(v.depthUniform, 0);
+        v.program->Set(v.normalUniform, 1);
+        v.program->Set(v.noiseUniform, 2);
+        v.program->Set(v.projectionUniform, projection);
+        v.program->Set(v.invProjectionUniform, invProjection);
+        v.kernel->BindBase(kernelBinding);
+        depth.Bind(0);
         normals.Bind(1);
         noise.Bind(2);
         
-        for (int i = 0; i < kernel.size(); i++) {
-            program->SetVec3("samples[" + std::to_string(i) + "]", kernel[i]);
-        }
         Component::Primitive::DrawQuad();
         
-        // Blurring
-        glDrawBuffer(GL_COLOR_ATTACHMENT1);
-        fbo.ClearColor(1,1,1,1);
+        // Blurring and upsampling
+        Core::Fbo& blurFbo = pool.Framebuffer({output});
+        blurFbo.Bind();
+        blurFbo.SetViewportDims();
+        blurFbo.ClearColor(1,1,1,1);
         
         programBlur->Use();
-        programBlur->SetInt("ssaoInput", 0);
-        fbo.colorAtts[0]->Bind();
+        programBlur->Set(blurInputUniform, 0);
+        programBlur->Set(blurDepthUniform, 1);
+        programBlur->Set(blurInvProjectionUniform, invProjection);
+        ssao->Bind(0);
+        depth.Bind(1);
         Component::Primitive::DrawQuad();
+        pool.Release(ssao);
     }
 
 }
\ No newline at end of file
@@ -2,9 +2,13 @@
 
 #include "core/program.hpp"
 #include "core/globject.hpp"
+#include "renderer/renderqueue.hpp"
+#include "renderer/shadowatlas.hpp"
+#include "scene/lightregistry.hpp"
 
 #include <glm/glm.hpp>
 
+#include <map>
 #include <memory>
 #include <vector>
 
@@ -22,6 +26,12 @@ namespace Scene {
 
 namespace Renderer {
 
+    // Result of CPU culling for one pass
+    struct CullStats {
+        int drawn = 0;
+        int culled = 0;
+    };
+
     class RenderModule {
         public:
             virtual std::shared_ptr<Core::Program> GetProgram() = 0;
@@ -32,42 +42,89 @@ namespace Renderer {
             virtual ~RenderModule() = default;
     };
 
-    class DirectionalShadowModule : public RenderModule {
+    // Depth-only draw of an already sorted queue, so that a following pass can shade with GL_EQUAL and no overdraw
+    class DepthPrepassModule : public RenderModule {
         public:
-            DirectionalShadowModule(int map_width = 512, int map_height = 512, int num_layers = 8);
+            DepthPrepassModule();
+
+            std::shared_ptr<Core::Program> GetProgram() override { return program; }
+            // Into the bound framebuffer, with color writes off; leaves depth writes on
+            void Render(const Scene::Scene& scene, RenderQueue& queue);
+
+        private:
+            inline static std::shared_ptr<Core::Program> program;
+            inline static Core::Uniform<int> instanceDrawsUniform, drawDataUniform;
+    };
 
-            const int mapWidth, mapHeight, numLayers;
-            const std::shared_ptr<Core::Tex3D> depthMap;
+    // Draws each cascade into its tile of the shared ShadowAtlas
+    class DirectionalShadowModule : public RenderModule {
+        public:
+            DirectionalShadowModule(ShadowAtlas& atlas);
             
             std::shared_ptr<Core::Program> GetProgram() override { return program; }
             void SetObjectUniforms(const glm::mat4& model, const Component::ComponentBase& component) override;
             bool AllowDraw(const Component::ComponentBase& component) override;
-            void Render(Scene::Scene& scene, const std::vector<Scene::SceneNode*>& dirlight_nodes);
+            void Render(Scene::Scene& scene, const std::vector<Scene::LightRegistry::DirectionalLightEntry>& dirlights);
+            // Summed over all shadow maps rendered in the last Render()
+            const CullStats& Stats() const { return stats; }
+            // Atlas tiles (per cascade or per cube face) redrawn in the last Render(); the rest were cached
+            int TilesRendered() const { return tilesRendered; }
             
         private:
-            Core::Fbo fbo;
+            ShadowAtlas& atlas;
+            std::vector<unsigned int> staticCasters, dynamicCasters;
+            int tilesRendered = 0;
             inline static std::shared_ptr<Core::Program> program;
+            inline static Core::Uniform<glm::mat4> lightSpaceMatrixUniform;
+            inline static Core::Uniform<int> instanceDrawsUniform, drawDataUniform;
+            CullStats stats;
+            std::vector<unsigned int> visibleDrawables;
+            RenderQueue queue;
 
-            void setGlobalUniforms(Component::DirectionalLight& dl, GLuint depth_texture, int* shadow_idx);
     };
         
+    // Draws each cube face into its tile of the shared ShadowAtlas
     class PointShadowModule : public RenderModule {
         public:
-            PointShadowModule(int map_width = 512, int map_height = 512, int num_layers = 8);
+            // How the six faces of a cube map are drawn
+            enum class CubeMode {
+                GeometryShader,     // One draw per light, amplified to every face's viewport by shaderg_shadowcube.gs
+                PerFace             // One draw per face, each culled against the face's frustum
+            };
+
+            PointShadowModule(ShadowAtlas& atlas);
 
-            const int mapWidth, mapHeight, numLayers;
-            const std::shared_ptr<Core::Tex3D> depthMap;
+            CubeMode cubeMode = CubeMode::PerFace;
             
-            std::shared_ptr<Core::Program> GetProgram() override { return program; }
+            std::shared_ptr<Core::Program> GetProgram() override { return cubeMode == CubeMode::PerFace ? programPerFace : program; }
             void SetObjectUniforms(const glm::mat4& model, const Component::ComponentBase& component) override;
             bool AllowDraw(const Component::ComponentBase& component) override;
-            void Render(Scene::Scene& scene, const std::vector<Scene::SceneNode*>& pointlight_nodes);
+            void Render(Scene::Scene& scene, const std::vector<Scene::LightRegistry::PointLightEntry>& pointlights);
+            // Summed over all shadow maps rendered in the last Render()
+            const CullStats& Stats() const { return stats; }
+            // Atlas tiles (per cascade or per cube face) redrawn in the last Render(); the rest were cached
+            int TilesRendered() const { return tilesRendered; }
             
         private:
-            Core::Fbo fbo;
+            ShadowAtlas& atlas;
+            std::vector<unsigned int> staticCasters, dynamicCasters, faceStaticCasters, faceDynamicCasters;
+            int tilesRendered = 0;
             inline static std::shared_ptr<Core::Program> program;
+            inline static Core::Uniform<glm::mat4> lightSpaceMatricesUniform;
+            inline static Core::Uniform<glm::vec3> lightPosUniform;
+            inline static Core::Uniform<float> farUniform;
+            inline static Core::Uniform<int> instanceDrawsUniform, drawDataUniform;
+            // PER_FACE variant of the same shaders, without the geometry shader
+            inline static std::shared_ptr<Core::Program> programPerFace;
+            inline static Core::Uniform<glm::mat4> faceMatrixUniform;
+            inline static Core::Uniform<glm::vec3> faceLightPosUniform;
+            inline static Core::Uniform<float> faceFarUniform;
+            inline static Core::Uniform<int> faceInstanceDrawsUniform, faceDrawDataUniform;
+            CullStats stats;
+            std::vector<unsigned int> visibleDrawables;
+            RenderQueue queue;
             
-            void setGlobalUniforms(Component::PointLight& pl, const glm::vec3& position, int* shadow_idx);
+            void setGlobalUniforms(Component::PointLight& pl, const glm::vec3& position);
         };
 
     class SkyboxModule : public RenderModule {
@@ -79,6 +136,8 @@ namespace Renderer {
             
         private:
             inline static std::shared_ptr<Core::Program> program;
+            inline static Core::Uniform<glm::mat4> viewUniform, projectionUniform;
+            inline static Core::Uniform<int> cubemapUniform;
                 
             void setGlobalUniforms(Component::Camera& camera, int tex_unit);
 
@@ -86,20 +145,40 @@ namespace Renderer {
 
     class SsaoModule : public RenderModule {
         public:
+            // Divisor of the G-buffer size that occlusion is computed at
+            enum class Resolution {
+                Full = 1,
+                Half = 2,
+                Quarter = 4
+            };
+
             SsaoModule();
 
-            const std::shared_ptr<Core::Tex2D> ssao;
-            const std::shared_ptr<Core::Tex2D> ssaoBlurred;
+            Resolution resolution = Resolution::Full;
+            int sampleCount = 64;   // 8, 16, 32 or 64, each its own program
             
-            std::shared_ptr<Core::Program> GetProgram() override { return program; }
-            void Render(Core::Tex& positions, Core::Tex& normals, const glm::mat4& projection);
+            std::shared_ptr<Core::Program> GetProgram() override { return variant(sampleCount).program; }
+            // Normals octahedral-encoded; view-space positions are rebuilt from depth. Occlusion is blurred and upsampled into
+            // output, at the size of depth.
+            void Render(Core::Tex& depth, Core::Tex& normals, const glm::mat4& projection, const std::shared_ptr<Core::Tex>& output);
 
         private:
-            Core::Fbo fbo;
+            // Program with KERNEL_SIZE defined, and its kernel in a uniform block, uploaded once
+            struct Variant {
+                std::shared_ptr<Core::Program> program;
+                std::shared_ptr<Core::Ubo> kernel;
+                Core::Uniform<int> depthUniform, normalUniform, noiseUniform;
+                Core::Uniform<glm::mat4> projectionUniform, invProjectionUniform;
+            };
+            static constexpr unsigned int kernelBinding = 5;    // SsaoKernel in UboScheme::Scheme1
+
             Core::Tex2D noise;
-            std::vector<glm::vec3> kernel;
-            inline static std::shared_ptr<Core::Program> program;
+            inline static std::map<int, Variant> variants;  // By sample count
             inline static std::shared_ptr<Core::Program> programBlur;
+            inline static Core::Uniform<int> blurInputUniform, blurDepthUniform;
+            inline static Core::Uniform<glm::mat4> blurInvProjectionUniform;
+
+            static Variant& variant(int sample_count);
     };
 
 }
\ No newline at end of file
@@ -1,17 +1,32 @@
 #include "renderer/postprocessing.hpp"
 #include "component/primitive.hpp"
+#include "core/glstate.hpp"
+#include "renderer/rendertargetpool.hpp"
+
+#include <algorithm>
 #include <iostream>
 
 namespace PostProcessing {
 
-    PostProcessor::PostProcessor()
-        : output(2,2)
-    {}
+    PostProcessor::~PostProcessor() {
+        Renderer::RenderTargetPool::Instance().Release(output);
+    }
 
     Core::Fbo* PostProcessor::Process(Core::Fbo& input, int att_idx) {
         return Process(*input.colorAtts[att_idx], input.width, input.height);
     }
 
+    Core::Fbo& PostProcessor::beginOutput(int width, int height) {
+        Renderer::RenderTargetPool& pool = Renderer::RenderTargetPool::Instance();
+        pool.Release(output);
+        output = pool.Acquire(width, height, GL_RGBA32F);
+        Core::Fbo& fbo = pool.Framebuffer({output});
+        fbo.Bind();
+        fbo.SetViewportDims();
+        fbo.ClearColor();
+        return fbo;
+    }
+
     Fxaa::Fxaa()
     {
         if (!program) {
@@ -21,27 +36,15 @@ namespace PostProcessing {
             
             program = std::make_shared<Core::Program>(vs, fs);
             program->SetUniformBlockBindingScheme(Core::Program::UboScheme::Scheme1);
+            screenTextureUniform = program->GetUniform<int>("screenTexture");
         }
-
-        auto color = std::make_shared<Core::Tex2D>(GL_TEXTURE_2D, GL_RGBA32F, output.width, output.height, GL_RGBA, GL_FLOAT, GL_CLAMP_TO_EDGE, GL_LINEAR, false, true);
-        
-        output.Bind();
-        output.AttachColorTex(color);
-        output.AttachDepthRbo16();
-        output.CheckStatus();
     }
 
     Core::Fbo* Fxaa::Process(Core::Tex& input, int width, int height) {
-        if (output.width != width || output.height != height) {
-            output.Resize(width, height);
-        }
-        output.Bind();
-        output.SetViewportDims();
-        output.ClearColor();
-        output.ClearDepth();
+        Core::Fbo& output = beginOutput(width, height);
         
         program->Use();
-        program->SetInt("screenTexture", 0);
+        program->Set(screenTextureUniform, 0);
         input.Bind(0);
         Component::Primitive::DrawQuad();
 
@@ -49,91 +52,94 @@ namespace PostProcessing {
     }
 
     Bloom::Bloom()
-        : highlights(2,2),
-        bloom(2,2)
     {
-        if (!programHighlights) {
+        if (!programDownsample) {
             AssetManager& manager = AssetManager::Instance();
 
             auto vs2d = manager.LoadHot<ShaderAsset>("assets/shaders/shaderv_2d.vs", GL_VERTEX_SHADER);
-            auto fsHighlights = manager.LoadHot<ShaderAsset>("assets/shaders/shaderf_2dhighlights.fs", GL_FRAGMENT_SHADER);
-            auto fsGaussian = manager.LoadHot<ShaderAsset>("assets/shaders/shaderf_2dgaussian.fs", GL_FRAGMENT_SHADER);
+            auto fsDownsample = manager.LoadHot<ShaderAsset>("assets/shaders/shaderf_2dbloomdown.fs", GL_FRAGMENT_SHADER);
+            auto fsUpsample = manager.LoadHot<ShaderAsset>("assets/shaders/shaderf_2dbloomup.fs", GL_FRAGMENT_SHADER);
             auto fsBloom = manager.LoadHot<ShaderAsset>("assets/shaders/shaderf_2dbloom.fs", GL_FRAGMENT_SHADER);
             
-            programHighlights = std::make_shared<Core::Program>(vs2d, fsHighlights);
-            programBlur = std::make_shared<Core::Program>(vs2d, fsGaussian);
+            programDownsample = std::make_shared<Core::Program>(vs2d, fsDownsample);
+            programUpsample = std::make_shared<Core::Program>(vs2d, fsUpsample);
             programDisplay = std::make_shared<Core::Program>(vs2d, fsBloom);
+            downSourceUniform = programDownsample->GetUniform<int>("source");
+            downPrefilterUniform = programDownsample->GetUniform<int>("prefilter");
+            downThresholdUniform = programDownsample->GetUniform<float>("threshold");
+            downKneeUniform = programDownsample->GetUniform<float>("knee");
+            upSourceUniform = programUpsample->GetUniform<int>("source");
+            upRadiusUniform = programUpsample->GetUniform<float>("radius");
+            displaySceneRawUniform = programDisplay->GetUniform<int>("sceneRaw");
+            displaySceneBloomUniform = programDisplay->GetUniform<int>("sceneBloom");
+            displayIntensityUniform = programDisplay->GetUniform<float>("intensity");
+            displayRadiusUniform = programDisplay->GetUniform<float>("radius");
         }
-
-        auto color = std::make_shared<Core::Tex2D>(GL_TEXTURE_2D, GL_RGBA32F, output.width, output.height, GL_RGBA, GL_FLOAT, GL_CLAMP_TO_EDGE, GL_LINEAR, false, true);
-        
-        output.Bind();
-        output.AttachColorTex(color);
-        output.AttachDepthRbo16();
-        output.CheckStatus();
-        
-        auto color1 = std::make_shared<Core::Tex2D>(GL_TEXTURE_2D, GL_RGBA32F, output.width, output.height, GL_RGBA, GL_FLOAT, GL_CLAMP_TO_EDGE, GL_LINEAR, false, true);
-        auto color2 = std::make_shared<Core::Tex2D>(GL_TEXTURE_2D, GL_RGBA32F, output.width, output.height, GL_RGBA, GL_FLOAT, GL_CLAMP_TO_EDGE, GL_LINEAR, false, true);
-        
-        bloom.Bind();
-        bloom.AttachColorTex(color1);
-        bloom.AttachColorTex(color2);
-        bloom.AttachDepthRbo16();
-        bloom.CheckStatus();
     }
 
     Core::Fbo* Bloom::Process(Core::Tex& input, int width, int height) {   
-        if (output.width != width || output.height != height) {
-            output.Resize(width, height);
-        }
-        if (bloom.width != width || bloom.height != height) {
-            bloom.Resize(width, height);
-        }
-
-        // Extract highlights from scene
-        bloom.Bind();
-        bloom.SetViewportDims();
-        bloom.ClearColor();
-        bloom.ClearDepth();
-        glDrawBuffer(GL_COLOR_ATTACHMENT0);
-
-        programHighlights->Use();
-        programHighlights->SetInt("rawScene", 0);
-        input.Bind(0);
-        Component::Primitive::DrawQuad();
-
-        // Ping pong between color attachments 0 and 1 to achieve Gaussian blur
-        const int amount = 6;
-        bool horizontal = true;
-
-        programBlur->Use();
-        programBlur->SetInt("image", 0);
-        for (int i = 0; i < amount; i++) {
-            const int readIdx = !horizontal;
-            const int drawIdx = horizontal;
-            programBlur->SetInt("horizontal", horizontal);
-            bloom.colorAtts[readIdx]->Bind(0); // Sample from color attachment at readIdx
-            glDrawBuffer(GL_COLOR_ATTACHMENT0 + drawIdx); // Draw to color attachment at drawIdx
-            Component::Primitive::DrawQuad();
-            horizontal = !horizontal;
-        }
+        Renderer::RenderTargetPool& pool = Renderer::RenderTargetPool::Instance();
+        std::shared_ptr<Core::Tex2D> blurred = pool.Acquire(std::max(1, width / 2), std::max(1, height / 2), GL_R11F_G11F_B10F);
+        Blur(input, blurred);
         
-        output.Bind();
-        output.SetViewportDims();
-        output.ClearColor();
-        output.ClearDepth();
+        // ---- Composite ----
+        Core::Fbo& output = beginOutput(width, height);
 
+        // Every level adds its share of the highlights, so the sum is averaged for intensity to mean the same at any mip count
         programDisplay->Use();
-        programDisplay->SetFloat("intensity", 0.75f);
-        programDisplay->SetInt("sceneRaw", 0);
-        programDisplay->SetInt("sceneBloom", 1);
+        programDisplay->Set(displayIntensityUniform, intensity / mips.size());
+        programDisplay->Set(displayRadiusUniform, radius);
+        programDisplay->Set(displaySceneRawUniform, 0);
+        programDisplay->Set(displaySceneBloomUniform, 1);
         input.Bind(0);
-        bloom.colorAtts[amount % 2]->Bind(1);
+        blurred->Bind(1);
         Component::Primitive::DrawQuad();
+        pool.Release(blurred);
 
         return &output;
     }
 
+    void Bloom::Blur(Core::Tex& input, const std::shared_ptr<Core::Tex>& output) {
+        const int width = input.width, height = input.height;
+        // At least one level, and no more than fit before a dimension would drop below 1 pixel
+        int levels = 1;
+        for (int w = width / 4, h = height / 4; levels < mipCount && w >= 1 && h >= 1; w /= 2, h /= 2)
+            levels++;
+        // 4 bytes per pixel; bloom needs range but not precision or alpha
+        Renderer::RenderTargetPool& pool = Renderer::RenderTargetPool::Instance();
+        mips.assign(1, output);
+        for (int i = 1; i < levels; i++)
+            mips.push_back(pool.Acquire(std::max(1, width >> (i + 1)), std::max(1, height >> (i + 1)), GL_R11F_G11F_B10F));
+
+        // ---- Downsample, thresholding on the way into the first level ----
+        programDownsample->Use();
+        programDownsample->Set(downSourceUniform, 0);
+        programDownsample->Set(downThresholdUniform, threshold);
+        programDownsample->Set(downKneeUniform, knee);
+        Core::Tex* source = &input;
+        for (size_t i = 0; i < mips.size(); i++) {
+            pool.Framebuffer({mips[i]}).Bind();
+            programDownsample->Set(downPrefilterUniform, i == 0);
+            source->Bind(0);
+            Component::Primitive::DrawQuad();
+            source = mips[i].get();
+        }
+
+        // ---- Upsample, adding each level onto the one above ----
+        programUpsample->Use();
+        programUpsample->Set(upSourceUniform, 0);
+        programUpsample->Set(upRadiusUniform, radius);
+        Core::GlState::Instance().SetEnabled(GL_BLEND, true);
+        Core::GlState::Instance().BlendFunc(GL_ONE, GL_ONE);
+        for (int i = mips.size() - 1; i > 0; i--) {
+            pool.Framebuffer({mips[i - 1]}).Bind();
+            mips[i]->Bind(0);
+            Component::Primitive::DrawQuad();
+            pool.Release(std::static_pointer_cast<Core::Tex2D>(mips[i]));
+        }
+        Core::GlState::Instance().SetEnabled(GL_BLEND, false);
+    }
+
     Hdr::Hdr() 
     {
         if (!program) {
@@ -143,32 +149,176 @@ namespace PostProcessing {
             
             program = std::make_shared<Core::Program>(vs, fs);
             program->SetUniformBlockBindingScheme(Core::Program::UboScheme::Scheme1);
+            exposureUniform = program->GetUniform<float>("exposure");
+            hdrBufferUniform = program->GetUniform<int>("hdrBuffer");
         }
-        
-        auto color = std::make_shared<Core::Tex2D>(GL_TEXTURE_2D, GL_RGBA32F, output.width, output.height, GL_RGBA, GL_FLOAT, GL_CLAMP_TO_EDGE, GL_LINEAR, false, true);
-        
-        output.Bind();
-        output.AttachColorTex(color);
-        output.AttachDepthRbo16();
-        output.CheckStatus();
     }
 
     Core::Fbo* Hdr::Process(Core::Tex& input, int width, int height) {
-        if (output.width != width || output.height != height) {
-            output.Resize(width, height);
-        }
-        output.Bind();
-        output.SetViewportDims();
-        output.ClearColor();
-        output.ClearDepth();
+        Core::Fbo& output = beginOutput(width, height);
         
         program->Use();
-        program->SetFloat("exposure", exposure);
-        program->SetInt("hdrBuffer", 0);
+        program->Set(exposureUniform, exposure);
+        program->Set(hdrBufferUniform, 0);
         input.Bind(0);
         Component::Primitive::DrawQuad();
 
         return &output;
     }
 
+    namespace {
+        double bytesPerPixel(GLint internal_format) {
+            switch (internal_format) {
+                case GL_RGBA32F:
+                    return 16;
+                case GL_RGBA16F:
+                    return 8;
+                case GL_DEPTH_COMPONENT16:
+                    return 2;
+                default:    // GL_RGBA8, GL_R11F_G11F_B10F, and the default framebuffer
+                    return 4;
+            }
+        }
+    }
+
+    Chain::Chain()
+    {
+        if (!programFxaa) {
+            AssetManager& manager = AssetManager::Instance();
+            auto vs = manager.LoadHot<ShaderAsset>("assets/shaders/shaderv_2d.vs", GL_VERTEX_SHADER);
+            auto fs = manager.LoadHot<ShaderAsset>("assets/shaders/shaderf_2dfxaa.fs", GL_FRAGMENT_SHADER);
+            
+            programFxaa = std::make_shared<Core::Program>(vs, fs, nullptr, "#define LUMA_IN_ALPHA");
+            programFxaa->SetUniformBlockBindingScheme(Core::Program::UboScheme::Scheme1);
+            fxaaScreenTextureUniform = programFxaa->GetUniform<int>("screenTexture");
+        }
+    }
+
+    void Chain::Process(Core::Fbo& input, Core::Fbo* target, int att_idx) {
+        Process(input.colorAtts[att_idx], target);
+    }
+
+    void Chain::Process(const std::shared_ptr<Core::Tex>& input, Core::Fbo* target) {
+        graph.Reset();
+        graph.ImportTexture("input", input);
+        graph.ImportFramebuffer("output", target, input->width, input->height);
+        AddPasses(graph, "input", "output");
+        graph.Execute();
+    }
+
+    void Chain::AddPasses(Renderer::RenderGraph& graph, const std::string& input, const std::string& output) {
+        const Renderer::RenderTargetPool::Desc& in = graph.Describe(input);
+        const int width = in.width, height = in.height;
+        lastTraffic = EstimateTraffic(width, height, in.internalformat, bloomEnabled, hdrEnabled, fxaaEnabled);
+        // Declared either way: with bloom off nothing reads it, and the graph culls it
+        graph.AddPass("Bloom", [&](Renderer::RenderGraph::Builder& builder) {
+            builder.Read(input);
+            builder.Create("bloom", {std::max(1, width / 2), std::max(1, height / 2), GL_R11F_G11F_B10F});
+        }, [this, input](const Renderer::RenderGraph& graph) {
+            bloom.Blur(*graph.Texture(input), graph.Texture("bloom"));
+        });
+
+        // ---- Composite: bloom, exposure, tone map, luma ----
+        // When FXAA follows, into an intermediate: 8-bit once tone mapped, half float otherwise
+        const int stages = BloomStage * bloomEnabled | HdrStage * hdrEnabled | FxaaStage * fxaaEnabled;
+        const std::string composited = fxaaEnabled ? "composite" : output;
+        graph.AddPass("Composite", [&](Renderer::RenderGraph::Builder& builder) {
+            builder.Read(input);
+            if (bloomEnabled)
+                builder.Read("bloom");
+            if (fxaaEnabled)
+                builder.Create(composited, {width, height, hdrEnabled ? GL_RGBA8 : GL_RGBA16F});
+            else
+                builder.Write(output);
+        }, [this, input, composited, stages](const Renderer::RenderGraph& graph) {
+            // Every pass covers the whole target, so depth is neither tested nor needed
+            Core::GlState::Instance().SetEnabled(GL_DEPTH_TEST, false);
+            graph.BindTarget(composited);
+            Composite& c = composite(stages);
+            c.program->Use();
+            c.program->Set(c.sceneUniform, 0);
+            graph.Texture(input)->Bind(0);
+            if (stages & BloomStage) {
+                // Every level adds its share of the highlights, so the sum is averaged for intensity to mean the same at any mip count
+                c.program->Set(c.bloomUniform, 1);
+                c.program->Set(c.bloomIntensityUniform, bloom.intensity / bloom.Levels());
+                c.program->Set(c.bloomRadiusUniform, bloom.radius);
+                graph.Texture("bloom")->Bind(1);
+            }
+            if (stages & HdrStage)
+                c.program->Set(c.exposureUniform, exposure);
+            Component::Primitive::DrawQuad();
+            Core::GlState::Instance().SetEnabled(GL_DEPTH_TEST, true);
+        });
+
+        // ---- FXAA, into the output ----
+        if (!fxaaEnabled)
+            return;
+        graph.AddPass("FXAA", [&](Renderer::RenderGraph::Builder& builder) {
+            builder.Read(composited);
+            builder.Write(output);
+        }, [output, composited](const Renderer::RenderGraph& graph) {
+            Core::GlState::Instance().SetEnabled(GL_DEPTH_TEST, false);
+            graph.BindTarget(output);
+            programFxaa->Use();
+            programFxaa->Set(fxaaScreenTextureUniform, 0);
+            graph.Texture(composited)->Bind(0);
+            Component::Primitive::DrawQuad();
+            Core::GlState::Instance().SetEnabled(GL_DEPTH_TEST, true);
+        });
+    }
+
+    Chain::Traffic Chain::EstimateTraffic(int width, int height, GLint input_format, bool bloom, bool hdr, bool fxaa) {
+        const double pixels = static_cast<double>(width) * height;
+        const double in = bytesPerPixel(input_format);
+        const double bloomRead = bloom ? bytesPerPixel(GL_R11F_G11F_B10F) / 4 : 0;    // Half resolution
+        const double final = bytesPerPixel(GL_RGBA8);
+
+        Traffic traffic;
+        // Separate: each stage reads the one before, writes GL_RGBA32F and clears a 16-bit depth buffer; the last is blitted
+        const double stage = bytesPerPixel(GL_RGBA32F);
+        double previous = in;
+        for (int i = 0; i < bloom + hdr + fxaa; i++) {
+            traffic.separate += previous + stage + bytesPerPixel(GL_DEPTH_COMPONENT16);
+            previous = stage;
+        }
+        traffic.separate += bloomRead + previous + final;
+        // Fused: the composite reads the input once and writes either the final target or the intermediate that FXAA reads
+        traffic.fused = in + bloomRead;
+        if (fxaa) {
+            const double middle = bytesPerPixel(hdr ? GL_RGBA8 : GL_RGBA16F);
+            traffic.fused += middle + middle + final;
+        } else {
+            traffic.fused += final;
+        }
+        traffic.separate *= pixels;
+        traffic.fused *= pixels;
+        return traffic;
+    }
+
+    Chain::Composite& Chain::composite(int stages) {
+        Composite& c = compositeVariants[stages];
+        if (!c.program) {
+            std::string defines;
+            if (stages & BloomStage)
+                defines += "#define BLOOM\n";
+            if (stages & HdrStage)
+                defines += "#define TONEMAP\n";
+            if (stages & FxaaStage)
+                defines += "#define LUMA_IN_ALPHA\n";
+
+            AssetManager& manager = AssetManager::Instance();
+            auto vs = manager.LoadHot<ShaderAsset>("assets/shaders/shaderv_2d.vs", GL_VERTEX_SHADER);
+            auto fs = manager.LoadHot<ShaderAsset>("assets/shaders/shaderf_2dpost.fs", GL_FRAGMENT_SHADER);
+            c.program = std::make_shared<Core::Program>(vs, fs, nullptr, defines);
+            c.program->SetUniformBlockBindingScheme(Core::Program::UboScheme::Scheme1);
+            c.sceneUniform = c.program->GetUniform<int>("scene");
+            c.bloomUniform = c.program->GetUniform<int>("bloom");
+            c.bloomIntensityUniform = c.program->GetUniform<float>("bloomIntensity");
+            c.bloomRadiusUniform = c.program->GetUniform<float>("bloomRadius");
+            c.exposureUniform = c.program->GetUniform<float>("exposure");
+        }
+        return c;
+    }
+
 }
\ No newline at end of file
@@ -2,18 +2,29 @@
 
 #include "core/globject.hpp"
 #include "core/program.hpp"
+#include "renderer/rendergraph.hpp"
+
+#include <map>
+#include <memory>
+#include <vector>
 
 namespace PostProcessing {
 
     class PostProcessor {
         public:
-            virtual ~PostProcessor() = default;
+            // Hands its output back to the pool
+            virtual ~PostProcessor();
+            // The returned framebuffer stays valid until the next Process()
             virtual Core::Fbo* Process(Core::Tex& input, int width, int height) = 0;
             Core::Fbo* Process(Core::Fbo& input, int att_idx = 0);
         
         protected:
-            Core::Fbo output;
-            PostProcessor();
+            PostProcessor() = default;
+            // Releases the last output and acquires this one's from the RenderTargetPool
+            Core::Fbo& beginOutput(int width, int height);
+
+        private:
+            std::shared_ptr<Core::Tex2D> output;
     };
 
     class Fxaa : public PostProcessor {
@@ -25,22 +36,42 @@ namespace PostProcessing {
         
         private:
             inline static std::shared_ptr<Core::Program> program;
+            inline static Core::Uniform<int> screenTextureUniform;
     };
 
+    // Progressive downsample/upsample bloom. The scene is soft-thresholded and filtered down a chain of half-size targets, then
+    // tent-filtered back up, each level added onto the one above. All but the final composite run at half resolution or less,
+    // so the blur radius grows with mipCount at little cost.
     class Bloom : public PostProcessor {
         public:
             Bloom();
 
             using PostProcessor::Process;
             Core::Fbo* Process(Core::Tex& input, int width, int height) override;
-            
-            Core::Fbo highlights;
-            Core::Fbo bloom;
+            // Only the downsample and upsample, into output as the top of the mip chain, at half the size of input, for a later
+            // pass to composite
+            void Blur(Core::Tex& input, const std::shared_ptr<Core::Tex>& output);
+            // Mip chain levels in use, which may be fewer than mipCount
+            int Levels() const { return mips.size(); }
+
+            int mipCount = 6;           // Levels below full resolution; stops early at 1 pixel
+            float threshold = 1.0f;     // Brightness where bloom reaches full strength
+            float knee = 0.5f;          // Width of the curve that eases bloom in below the threshold
+            float intensity = 0.75f;
+            float radius = 1.0f;        // Of the upsampling tent filter, in texels of the level it reads
         
         private:
-            inline static std::shared_ptr<Core::Program> programHighlights;
-            inline static std::shared_ptr<Core::Program> programBlur;
+            // Of the last Blur(): mips[0] is its output, each after it half the one before and from the RenderTargetPool
+            std::vector<std::shared_ptr<Core::Tex>> mips;
+            inline static std::shared_ptr<Core::Program> programDownsample;
+            inline static std::shared_ptr<Core::Program> programUpsample;
             inline static std::shared_ptr<Core::Program> programDisplay;
+            inline static Core::Uniform<int> downSourceUniform, downPrefilterUniform;
+            inline static Core::Uniform<float> downThresholdUniform, downKneeUniform;
+            inline static Core::Uniform<int> upSourceUniform;
+            inline static Core::Uniform<float> upRadiusUniform;
+            inline static Core::Uniform<int> displaySceneRawUniform, displaySceneBloomUniform;
+            inline static Core::Uniform<float> displayIntensityUniform, displayRadiusUniform;
     };
 
     class Hdr : public PostProcessor {
@@ -54,6 +85,69 @@ namespace PostProcessing {
         
         private:
             inline static std::shared_ptr<Core::Program> program;
+            inline static Core::Uniform<float> exposureUniform;
+            inline static Core::Uniform<int> hdrBufferUniform;
+    };
+
+    // Bloom, HDR tone mapping and FXAA fused into as few full-screen passes as the enabled stages allow: one that composites
+    // bloom, exposes, tone maps and stores luma in alpha, then FXAA into the final target. Without FXAA the first pass writes the
+    // final target itself. Each combination of stages is a program variant of shaderf_2dpost.fs, built on first use.
+    // The stages are RenderGraph passes ("Bloom", "Composite", "FXAA"), added to a frame's graph or run on their own.
+    class Chain {
+        public:
+            // Estimated full-resolution memory traffic, in bytes: texels read and written, and depth cleared. The bloom mip chain
+            // costs the same either way and is left out, apart from the composite's read of its top level.
+            struct Traffic {
+                double fused = 0.0;
+                double separate = 0.0;      // The same stages as separate GL_RGBA32F passes with depth buffers, then blitted
+            };
+
+            Chain();
+            // Rule of five
+            ~Chain() = default;
+            Chain(const Chain& other) = delete;
+            Chain(Chain&& other) = delete;
+            Chain& operator=(const Chain& other) = delete;
+            Chain& operator=(Chain&& other) = delete;
+
+            bool bloomEnabled = false;
+            bool hdrEnabled = true;
+            bool fxaaEnabled = true;
+            float exposure = 1.0f;
+            Bloom bloom;    // Only its settings and Blur() are used
+
+            // From the graph's input resource into its output resource, which the caller declares
+            void AddPasses(Renderer::RenderGraph& graph, const std::string& input, const std::string& output);
+            // Runs the passes on their own, into target, or the default framebuffer if null
+            void Process(const std::shared_ptr<Core::Tex>& input, Core::Fbo* target = nullptr);
+            void Process(Core::Fbo& input, Core::Fbo* target = nullptr, int att_idx = 0);
+            
+            static Traffic EstimateTraffic(int width, int height, GLint input_format, bool bloom, bool hdr, bool fxaa);
+            // Of the last AddPasses() or Process()
+            const Traffic& LastTraffic() const { return lastTraffic; }
+            // Of the last Process()
+            const Renderer::RenderGraph& Graph() const { return graph; }
+
+        private:
+            enum Stage {
+                BloomStage = 1,
+                HdrStage = 2,
+                FxaaStage = 4
+            };
+
+            struct Composite {
+                std::shared_ptr<Core::Program> program;
+                Core::Uniform<int> sceneUniform, bloomUniform;
+                Core::Uniform<float> bloomIntensityUniform, bloomRadiusUniform, exposureUniform;
+            };
+
+            inline static std::map<int, Composite> compositeVariants;   // By stages
+            inline static std::shared_ptr<Core::Program> programFxaa;    // LUMA_IN_ALPHA
+            inline static Core::Uniform<int> fxaaScreenTextureUniform;
+            Traffic lastTraffic;
+            Renderer::RenderGraph graph;
+
+            static Composite& composite(int stages);
     };
 
 }
\ No newline at end of file
@@ -0,0 +1,262 @@
+#include "renderer/profiler.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+namespace Renderer {
+
+    Profiler& Profiler::Instance() {
+        static Profiler instance;
+        return instance;
+    }
+
+    int Profiler::scopeIndex(const std::string& name, std::vector<std::string>& scopes, std::map<std::string, int>& indices) {
+        auto [it, inserted] = indices.try_emplace(name, scopes.size());
+        if (inserted)
+            scopes.push_back(name);
+        return it->second;
+    }
+
+    Profiler::Frame& Profiler::currentFrame() {
+        if (history.empty() || history.back().index != frameIndex) {
+            history.emplace_back();
+            history.back().index = frameIndex;
+            while (history.size() > historyFrames)
+                history.pop_front();
+        }
+        return history.back();
+    }
+
+    void Profiler::record(int frame, int scope, float ms, bool gpu) {
+        if (history.empty() || frame < history.front().index || frame > history.back().index)
+            return;
+        Frame& f = history[frame - history.front().index];
+        std::vector<float>& times = gpu ? f.gpuMs : f.cpuMs;
+        if (times.size() <= static_cast<size_t>(scope))
+            times.resize(scope + 1, -1.f);
+        // A scope entered more than once in a frame counts once, in total
+        times[scope] = std::max(times[scope], 0.f) + ms;
+    }
+
+    // ---- Recording ----
+
+    void Profiler::BeginCpu(const std::string& name) {
+        currentFrame();
+        openCpuScopes.push_back({scopeIndex(name, cpuScopes, cpuScopeIndices), Clock::now()});
+    }
+
+    void Profiler::EndCpu() {
+        if (openCpuScopes.empty())
+            throw std::runtime_error("Profiler::EndCpu() without a matching BeginCpu()");
+        const OpenCpuScope open = openCpuScopes.back();
+        openCpuScopes.pop_back();
+        const Clock::time_point end = Clock::now();
+        record(frameIndex, open.scope, std::chrono::duration<float, std::milli>(end - open.start).count(), false);
+        if (tracing(frameIndex))
+            trace.push_back({cpuScopes[open.scope], "cpu", false, traceUs(open.start), traceUs(end) - traceUs(open.start)});
+    }
+
+    void Profiler::BeginGpu(const std::string& name) {
+        if (openGpuScope >= 0)
+            throw std::runtime_error("Profiler GPU scope " + name + " begins inside " + gpuScopes[openGpuScope]);
+        currentFrame();
+        openGpuScope = scopeIndex(name, gpuScopes, gpuScopeIndices);
+        if (gpuQueries.size() <= static_cast<size_t>(openGpuScope))
+            gpuQueries.resize(openGpuScope + 1);
+
+        PendingQuery& pending = gpuQueries[openGpuScope].queries[gpuQueries[openGpuScope].next];
+        if (!pending.query)
+            pending.query = std::make_shared<Core::Query>(GL_TIME_ELAPSED);
+        // Still in flight after a full round: dropped rather than waited for
+        if (pending.frame >= 0 && pending.query->ResultAvailable())
+            resolve(pending, openGpuScope);
+        pending.frame = frameIndex;
+        // Where the range starts on the GPU, which elapsed time alone does not say
+        pending.stamped = tracing(frameIndex);
+        if (pending.stamped) {
+            if (!pending.timestamp)
+                pending.timestamp = std::make_shared<Core::Query>(GL_TIMESTAMP);
+            pending.timestamp->Stamp();
+        }
+        pending.query->Bind();
+    }
+
+    void Profiler::resolve(PendingQuery& pending, int scope) {
+        const GLuint64 elapsed = pending.query->Result();
+        record(pending.frame, scope, elapsed * 1e-6f, true);
+        if (pending.stamped && tracing(pending.frame)) {
+            // Finished before the range it starts, so available too
+            const double startUs = (static_cast<GLint64>(pending.timestamp->Result()) - gpuTraceStart) * 1e-3;
+            trace.push_back({gpuScopes[scope], "gpu", true, startUs, elapsed * 1e-3});
+        }
+        pending.frame = -1;
+        pending.stamped = false;
+    }
+
+    void Profiler::EndGpu() {
+        if (openGpuScope < 0)
+            throw std::runtime_error("Profiler::EndGpu() without a matching BeginGpu()");
+        GpuScope& scope = gpuQueries[openGpuScope];
+        scope.queries[scope.next].query->Unbind();
+        scope.next = (scope.next + 1) % queriesPerScope;
+        openGpuScope = -1;
+    }
+
+    void Profiler::EndFrame() {
+        if (!openCpuScopes.empty() || openGpuScope >= 0)
+            throw std::runtime_error("Profiler frame ends with scopes still open");
+
+        // Whatever has arrived, without waiting for the rest
+        for (size_t scope = 0; scope < gpuQueries.size(); scope++) {
+            for (PendingQuery& pending : gpuQueries[scope].queries) {
+                if (pending.frame >= 0 && pending.query->ResultAvailable())
+                    resolve(pending, scope);
+            }
+        }
+
+        updateStats(cpuStats, cpuScopes, false);
+        updateStats(gpuStats, gpuScopes, true);
+
+        // ---- Tracing ----
+        const Clock::time_point now = Clock::now();
+        if (tracing(frameIndex))
+            trace.push_back({"Frame " + std::to_string(frameIndex), "frame", false, traceUs(frameStart), traceUs(now) - traceUs(frameStart)});
+        // Every query of the capture has come round by now, so what has not arrived never will
+        if (traceLastFrame >= 0 && frameIndex >= traceLastFrame + queriesPerScope) {
+            writeTrace();
+            trace.clear();
+            tracePath.clear();
+            traceFirstFrame = traceLastFrame = -1;
+        }
+        frameIndex++;
+        if (Capturing() && traceFirstFrame < 0) {
+            traceFirstFrame = frameIndex;
+            traceLastFrame = frameIndex + traceFrames - 1;
+            traceStart = Clock::now();
+            glGetInteger64v(GL_TIMESTAMP, &gpuTraceStart);
+        }
+        frameStart = Clock::now();
+    }
+
+    void Profiler::updateStats(std::vector<ScopeStats>& stats, const std::vector<std::string>& scopes, bool gpu) const {
+        stats.resize(scopes.size());
+        std::vector<float> samples;
+        for (size_t scope = 0; scope < scopes.size(); scope++) {
+            ScopeStats& s = stats[scope];
+            s = ScopeStats();
+            s.name = scopes[scope];
+
+            samples.clear();
+            for (const Frame& frame : history) {
+                const std::vector<float>& times = gpu ? frame.gpuMs : frame.cpuMs;
+                if (scope < times.size() && times[scope] >= 0.f)
+                    samples.push_back(times[scope]);
+            }
+            if (samples.empty())
+                continue;
+            s.samples = samples.size();
+            s.lastMs = samples.back();
+            float total = 0.f;
+            for (float ms : samples)
+                total += ms;
+            s.averageMs = total / samples.size();
+
+            // Nearest rank
+            std::sort(samples.begin(), samples.end());
+            const auto percentile = [&](float p) {
+                return samples[std::min(static_cast<int>(p * samples.size()), static_cast<int>(samples.size()) - 1)];
+            };
+            s.p50Ms = percentile(0.50f);
+            s.p95Ms = percentile(0.95f);
+            s.p99Ms = percentile(0.99f);
+            s.maxMs = samples.back();
+        }
+    }
+
+    // ---- Results ----
+
+    const Profiler::ScopeStats* Profiler::FindCpu(const std::string& name) const {
+        auto it = cpuScopeIndices.find(name);
+        return it != cpuScopeIndices.end() && static_cast<size_t>(it->second) < cpuStats.size() ? &cpuStats[it->second] : nullptr;
+    }
+
+    const Profiler::ScopeStats* Profiler::FindGpu(const std::string& name) const {
+        auto it = gpuScopeIndices.find(name);
+        return it != gpuScopeIndices.end() && static_cast<size_t>(it->second) < gpuStats.size() ? &gpuStats[it->second] : nullptr;
+    }
+
+    void Profiler::Clear() {
+        history.clear();
+        updateStats(cpuStats, cpuScopes, false);
+        updateStats(gpuStats, gpuScopes, true);
+    }
+
+    // ---- Tracing ----
+
+    void Profiler::CaptureTrace(int frames, const std::string& path) {
+        if (Capturing() || frames <= 0 || path.empty())
+            return;
+        tracePath = path;
+        traceFrames = frames;
+        std::clog << "Capturing a trace of " << frames << " frames..." << std::endl;
+    }
+
+    void Profiler::TraceEvent(const std::string& name, const std::string& category, Clock::time_point start, Clock::time_point end) {
+        if (tracing(frameIndex))
+            trace.push_back({name, category, false, traceUs(start), traceUs(end) - traceUs(start)});
+    }
+
+    double Profiler::traceUs(Clock::time_point time) const {
+        return std::chrono::duration<double, std::micro>(time - traceStart).count();
+    }
+
+    namespace {
+        std::string escapeJson(const std::string& s) {
+            std::string escaped;
+            for (char c : s) {
+                switch (c) {
+                    case '"':  escaped += "\\\""; break;
+                    case '\\': escaped += "\\\\"; break;
+                    case '\b': escaped += "\\b"; break;
+                    case '\f': escaped += "\\f"; break;
+                    case '\n': escaped += "\\n"; break;
+                    case '\r': escaped += "\\r"; break;
+                    case '\t': escaped += "\\t"; break;
+                    default:
+                        if (static_cast<unsigned char>(c) < 0x20) {
+                            char code[7];
+                            std::snprintf(code, sizeof(code), "\\u%04x", static_cast<unsigned char>(c));
+                            escaped += code;
+                        } else {
+                            escaped += c;
+                        }
+                }
+            }
+            return escaped;
+        }
+    }
+
+    void Profiler::writeTrace() const {
+        // Trace event format: complete ("X") events per track, with the tracks named by metadata ("M") events
+        std::ofstream file(tracePath);
+        if (!file) {
+            std::clog << "Could not write trace to " << tracePath << std::endl;
+            return;
+        }
+        file << std::fixed << std::setprecision(3);
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n";
+        file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+        for (const TraceRecord& r : trace) {
+            file << ",\n{\"name\":\"" << escapeJson(r.name) << "\",\"cat\":\"" << escapeJson(r.category)
+                << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << (r.gpu ? 2 : 1) << ",\"ts\":" << r.startUs << ",\"dur\":" << r.durationUs << "}";
+        }
+        file << "\n]}\n";
+        std::clog << "Wrote a trace of " << traceLastFrame - traceFirstFrame + 1 << " frames to " << tracePath << std::endl;
+    }
+
+}
\ No newline at end of file
@@ -0,0 +1,153 @@
+#pragma once
+
+#include "core/globject.hpp"
+
+#include <chrono>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Renderer {
+
+    // Named CPU and GPU scopes, timed every frame and kept for the last few seconds of frames. GPU scopes are timed with
+    // GL_TIME_ELAPSED queries from a ring per scope, each read back only once the GPU is done with it, so nothing stalls;
+    // a result is filed under the frame that issued it. GPU scopes cannot nest, since GL allows one timer at a time.
+    // CPU scopes can.
+    // A capture records the same scopes of a few frames as a timeline instead, written as Chrome trace event JSON.
+    class Profiler {
+        public:
+            using Clock = std::chrono::steady_clock;
+
+            // Of one scope, over the frames in History() that recorded it
+            struct ScopeStats {
+                std::string name;
+                int samples = 0;
+                float lastMs = 0.f;
+                float averageMs = 0.f;
+                float p50Ms = 0.f;
+                float p95Ms = 0.f;
+                float p99Ms = 0.f;
+                float maxMs = 0.f;
+            };
+            // Milliseconds per scope, indexed as CpuScopes() and GpuScopes(); negative where a scope did not run or its result
+            // has not arrived yet
+            struct Frame {
+                int index = 0;
+                std::vector<float> cpuMs;
+                std::vector<float> gpuMs;
+            };
+            // Times a CPU scope for as long as it lives
+            class CpuScope {
+                public:
+                    CpuScope(const std::string& name) { Profiler::Instance().BeginCpu(name); }
+                    ~CpuScope() { Profiler::Instance().EndCpu(); }
+                    CpuScope(const CpuScope& other) = delete;
+                    CpuScope& operator=(const CpuScope& other) = delete;
+            };
+
+            static Profiler& Instance();
+            // Rule of five
+            ~Profiler() = default;
+            Profiler(const Profiler& other) = delete;
+            Profiler(Profiler&& other) = delete;
+            Profiler& operator=(const Profiler& other) = delete;
+            Profiler& operator=(Profiler&& other) = delete;
+
+            // Frames kept for statistics and the history
+            static constexpr int historyFrames = 240;
+            // Queries per GPU scope. A result is read the next time its query comes round, so this many frames late at most.
+            static constexpr int queriesPerScope = 3;
+
+            // ---- Recording ----
+            void BeginCpu(const std::string& name);
+            void EndCpu();
+            void BeginGpu(const std::string& name);
+            void EndGpu();
+            // Call once per frame: reads back finished GPU scopes and updates the statistics
+            void EndFrame();
+
+            // ---- Results ----
+            // Every scope seen so far, in the order first seen
+            const std::vector<std::string>& CpuScopes() const { return cpuScopes; }
+            const std::vector<std::string>& GpuScopes() const { return gpuScopes; }
+            const std::vector<ScopeStats>& CpuStats() const { return cpuStats; }
+            const std::vector<ScopeStats>& GpuStats() const { return gpuStats; }
+            // Null if no such scope has been seen
+            const ScopeStats* FindCpu(const std::string& name) const;
+            const ScopeStats* FindGpu(const std::string& name) const;
+            // Oldest first. The newest frames miss GPU results still in flight.
+            const std::deque<Frame>& History() const { return history; }
+            // Forgets every sample, keeping the scopes
+            void Clear();
+
+            // ---- Tracing ----
+            // Records every scope of the next frames, and once their GPU results are in, writes them to path for
+            // chrome://tracing or Perfetto. CPU scopes and events are one track, GPU scopes another, aligned at the start.
+            void CaptureTrace(int frames, const std::string& path);
+            // From CaptureTrace() until the file is written
+            bool Capturing() const { return !tracePath.empty(); }
+            // Something timed outside any scope, such as an asset load, on the CPU track of a capture. Ignored otherwise.
+            void TraceEvent(const std::string& name, const std::string& category, Clock::time_point start, Clock::time_point end);
+
+        private:
+            Profiler() = default;
+
+            struct PendingQuery {
+                std::shared_ptr<Core::Query> query;
+                std::shared_ptr<Core::Query> timestamp;     // At its start, only issued while tracing
+                int frame = -1;     // That issued it, or -1 if it has nothing to read back
+                bool stamped = false;
+            };
+            struct GpuScope {
+                PendingQuery queries[queriesPerScope];
+                int next = 0;
+            };
+            struct OpenCpuScope {
+                int scope;
+                Clock::time_point start;
+            };
+
+            std::vector<std::string> cpuScopes;
+            std::vector<std::string> gpuScopes;
+            std::map<std::string, int> cpuScopeIndices;
+            std::map<std::string, int> gpuScopeIndices;
+            std::vector<GpuScope> gpuQueries;       // Indexed as gpuScopes
+            std::vector<OpenCpuScope> openCpuScopes;
+            int openGpuScope = -1;
+
+            std::deque<Frame> history;              // Ends with the frame being recorded
+            int frameIndex = 0;
+            std::vector<ScopeStats> cpuStats;
+            std::vector<ScopeStats> gpuStats;
+
+            // Complete events, in microseconds since the capture started
+            struct TraceRecord {
+                std::string name;
+                std::string category;
+                bool gpu;
+                double startUs;
+                double durationUs;
+            };
+            std::vector<TraceRecord> trace;
+            std::string tracePath;
+            int traceFrames = 0;
+            int traceFirstFrame = -1;               // Frames recorded, inclusive; -1 until the capture starts
+            int traceLastFrame = -1;
+            Clock::time_point traceStart;
+            GLint64 gpuTraceStart = 0;              // GL_TIMESTAMP at traceStart, in ns
+            Clock::time_point frameStart;
+
+            Frame& currentFrame();
+            bool tracing(int frame) const { return traceFirstFrame >= 0 && frame >= traceFirstFrame && frame <= traceLastFrame; }
+            double traceUs(Clock::time_point time) const;
+            void resolve(PendingQuery& pending, int scope);
+            void writeTrace() const;
+            // Into the frame that issued it, if still kept
+            void record(int frame, int scope, float ms, bool gpu);
+            static int scopeIndex(const std::string& name, std::vector<std::string>& scopes, std::map<std::string, int>& indices);
+            void updateStats(std::vector<ScopeStats>& stats, const std::vector<std::string>& scopes, bool gpu) const;
+    };
+
+}
\ No newline at end of file
@@ -2,35 +2,33 @@
 
 #include "component/primitive.hpp"
 #include "context/application.hpp"
+#include "core/glstate.hpp"
 #include "asset/manager.hpp"
 #include "material/texture.hpp"
+#include "util/direction.hpp"
 
 #include <glm/gtc/type_ptr.hpp>
 
-#include <functional>
+#include <algorithm>
 #include <iostream>
-#include <queue>
 
 namespace Renderer {
 
     RendererBase::RendererBase() 
         : window(Context::Application::Instance().activeWindow)
     {
-        glEnable(GL_DEPTH_TEST);
-        glDepthFunc(GL_LEQUAL); // Default LEQUAL for skybox optimization, since depth buffer is cleared to 1.0 by default
+        Core::GlState::Instance().SetEnabled(GL_DEPTH_TEST, true);
+        Core::GlState::Instance().DepthFunc(GL_LEQUAL); // Default LEQUAL for skybox optimization, since depth buffer is cleared to 1.0 by default
 
-        glEnable(GL_CULL_FACE);
-        glCullFace(GL_BACK);
+        Core::GlState::Instance().SetEnabled(GL_CULL_FACE, true);
+        Core::GlState::Instance().CullFace(GL_BACK);
 
-        glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+        Core::GlState::Instance().SetEnabled(GL_TEXTURE_CUBE_MAP_SEAMLESS, true);
     }
 
     DeferredRenderer::DeferredRenderer() 
-        : gBuffer(window->Width(), window->Height()), 
-        output(window->Width(), window->Height()),
-        dirShadowModule(1024, 1024),
-        pointShadowModule(1024, 1024),
-        eventListener(Context::InputsAndEventsManager::CreateEventListener())
+        : dirShadowModule(shadowAtlas),
+        pointShadowModule(shadowAtlas)
     {
         if (!lightingPassProgram) {
             AssetManager& manager = AssetManager::Instance();
@@ -39,260 +37,394 @@ namespace Renderer {
             
             lightingPassProgram = std::make_shared<Core::Program>(vs, fs);
             lightingPassProgram->SetUniformBlockBindingScheme(Core::Program::UboScheme::Scheme1);
+            gDepthUniform = lightingPassProgram->GetUniform<int>("gDepth");
+            gNormalUniform = lightingPassProgram->GetUniform<int>("gNormal");
+            gAlbedoUniform = lightingPassProgram->GetUniform<int>("gAlbedo");
+            gMetRouOccUniform = lightingPassProgram->GetUniform<int>("gMetRouOcc");
+            invProjectionUniform = lightingPassProgram->GetUniform<glm::mat4>("inv_projection");
+            ssaoUniform = lightingPassProgram->GetUniform<int>("ssao");
+            ssaoMapUniform = lightingPassProgram->GetUniform<int>("ssaoMap");
+            irradianceMapUniform = lightingPassProgram->GetUniform<int>("irradianceMap");
+            prefilterMapUniform = lightingPassProgram->GetUniform<int>("prefilterMap");
+            brdfLutUniform = lightingPassProgram->GetUniform<int>("brdfLUT");
+            iblUniform = lightingPassProgram->GetUniform<float>("ibl");
+            shadowAtlasUniform = lightingPassProgram->GetUniform<int>("shadowAtlas");
+            pointlightDataUniform = lightingPassProgram->GetUniform<int>("pointlightData");
+            clusterGridUniform = lightingPassProgram->GetUniform<int>("clusterGrid");
+            clusterLightIndicesUniform = lightingPassProgram->GetUniform<int>("clusterLightIndices");
+            clusterTilesXUniform = lightingPassProgram->GetUniform<int>("clusterTilesX");
+            clusterTilesYUniform = lightingPassProgram->GetUniform<int>("clusterTilesY");
+            clusterSlicesUniform = lightingPassProgram->GetUniform<int>("clusterSlices");
+            clusterDepthScaleUniform = lightingPassProgram->GetUniform<float>("clusterDepthScale");
+            clusterDepthBiasUniform = lightingPassProgram->GetUniform<float>("clusterDepthBias");
         }
 
         initUniformBlocks();
-        initGbuffer();
-        initOutput();
-
-        std::function<void(int,int)> staticFunc = std::bind(&DeferredRenderer::framebufferSizeCallback, this, std::placeholders::_1, std::placeholders::_2);
-        eventListener->SetFramebufferSizeCallback(staticFunc);
+        for (auto& query : geometrySampleQueries)
+            query = std::make_shared<Core::Query>(GL_SAMPLES_PASSED);
     }
 
-    DeferredRenderer::~DeferredRenderer() {}
-    
     Core::Fbo* DeferredRenderer::Render(Scene::Scene& scene, Component::Camera& camera) {
         static Scene::Environment environment;
         return Render(scene, camera, environment);
     }
 
     Core::Fbo* DeferredRenderer::Render(Scene::Scene& scene, Component::Camera& camera, Scene::Environment& env) {
+        Profiler::Instance().BeginCpu("Scene update");
+        immediateDrawData.BeginImmediate();
+        scene.UpdateWorldTransforms();
         updateGlobalUniforms(scene, camera);
-        geometryPass(scene);
-        if (ssao)
-            ssaoPass(camera);
-        shadowMapPass(scene);
-        lightingPass(env);
-        forwardPass(camera, env);
-        return &output;
+        updateDrawData(scene);
+        Profiler::Instance().EndCpu();
+        // Releases the color held since the last Render() for the caller
+        graph.Reset();
+        addPasses(scene, camera, env);
+        graph.Execute();
+        stats.directionalShadows = dirShadowModule.Stats();
+        stats.pointShadows = pointShadowModule.Stats();
+        stats.shadowTilesRendered = dirShadowModule.TilesRendered() + pointShadowModule.TilesRendered();
+        stats.shadowAtlas = shadowAtlas.Stats();
+        uniformRing->EndFrame();
+        if (postProcessing)
+            return nullptr;
+        return &RenderTargetPool::Instance().Framebuffer({graph.Texture("color")});
+    }
+
+    void DeferredRenderer::addPasses(Scene::Scene& scene, Component::Camera& camera, Scene::Environment& env) {
+        const int width = window->Width(), height = window->Height();
+        graph.ImportTexture("shadowAtlas", shadowAtlas.depthMap);
+
+        // 12 bytes of color per pixel. View-space position is rebuilt from depth with the inverse projection.
+        graph.AddPass("Geometry", [&](RenderGraph::Builder& builder) {
+            builder.Create("gNormal", {width, height, GL_RG16, 1, GL_NEAREST});
+            builder.Create("gAlbedo", {width, height, GL_SRGB8_ALPHA8, 1, GL_NEAREST});
+            builder.Create("gMetRouOcc", {width, height, GL_RGBA8, 1, GL_NEAREST});
+            builder.Create("gDepth", {width, height, GL_DEPTH_COMPONENT24, 1, GL_NEAREST});
+        }, [&](const RenderGraph& graph) {
+            geometryPass(scene, camera, graph);
+        });
+
+        if (ssao) {
+            graph.AddPass("SSAO", [&](RenderGraph::Builder& builder) {
+                builder.Read("gDepth");
+                builder.Read("gNormal");
+                builder.Create("ssao", {width, height, GL_R8});
+            }, [&](const RenderGraph& graph) {
+                ssaoPass(camera, graph);
+            });
+        }
+
+        // Into the atlas, which outlives the frame for its cached tiles
+        graph.AddPass("Directional shadows", [&](RenderGraph::Builder& builder) {
+            builder.Write("shadowAtlas");
+        }, [&](const RenderGraph&) {
+            drawData.Bind();
+            dirShadowModule.Render(scene, scene.Lights().DirectionalLights());
+        });
+        graph.AddPass("Point shadows", [&](RenderGraph::Builder& builder) {
+            builder.Write("shadowAtlas");
+        }, [&](const RenderGraph&) {
+            drawData.Bind();
+            pointShadowModule.cubeMode = pointShadowMode;
+            pointShadowModule.Render(scene, scene.Lights().PointLights());
+        });
+
+        graph.AddPass("Lighting", [&](RenderGraph::Builder& builder) {
+            for (const char* gBuffer : {"gDepth", "gNormal", "gAlbedo", "gMetRouOcc"})
+                builder.Read(gBuffer);
+            if (ssao)
+                builder.Read("ssao");
+            builder.Read("shadowAtlas");
+            builder.Create("color", {width, height, GL_RGBA32F});
+        }, [&](const RenderGraph& graph) {
+            lightingPass(env, camera, graph);
+        });
+
+        // The G-buffer's own depth, so there is nothing to copy
+        graph.AddPass("Skybox", [&](RenderGraph::Builder& builder) {
+            builder.Write("color");
+            builder.Write("gDepth");
+        }, [&](const RenderGraph& graph) {
+            forwardPass(camera, env, graph);
+        });
+
+        if (postProcessing) {
+            graph.ImportFramebuffer("backbuffer", nullptr, width, height);
+            postProcessing->AddPasses(graph, "color", "backbuffer");
+        } else {
+            graph.Export("color");
+        }
     }
     
     void DeferredRenderer::initUniformBlocks() {
-        // Core::Program::UboScheme::Scheme1
-        // Should have some help from Program to enforce this sceheme
+        // Core::Program::UboScheme::Scheme1, all bound as ranges of the ring each frame
         // 0 - View, projection transforms  
-        uboVsMatrices   = std::make_shared<Core::Ubo>(0, 2*sizeof(glm::mat4));
         // 1 - Inverse view transform
-        uboFsMatrices   = std::make_shared<Core::Ubo>(1, 1*sizeof(glm::mat4));
         // 2 - Camera position, front (viewspace)
-        uboFsCamera     = std::make_shared<Core::Ubo>(2, 2*16);
-        // 3 - Directional light colors, direction, lightspace transform
-        uboFsDirlight   = std::make_shared<Core::Ubo>(3, 16 + 8 * (16+16 + sizeof(glm::mat4)));
-        // 4 - Point light count, colors, attenuations, positions, positions (worldspace)
-        uboFsPointlight = std::make_shared<Core::Ubo>(4, 16 + 32 * (4*16));
+        // 3 - Directional light colors, direction, lightspace transforms, atlas tiles
+        // 4 - Point light count; per-light data lives in tboPointlights
+        uniformRing = std::make_shared<Core::UboRing>();
+
+        // Point light colors, attenuations, positions, positions (worldspace), and the cluster grid and light index lists
+        tboPointlights      = std::make_shared<Core::Tbo>(GL_RGBA32F);
+        tboClusters         = std::make_shared<Core::Tbo>(GL_RG32UI);
+        tboClusterIndices   = std::make_shared<Core::Tbo>(GL_R32UI);
 
         // Set UBO scheme to default (may implement non-default schemes in the future)
         lightingPassProgram->SetUniformBlockBindingScheme(Core::Program::UboScheme::Scheme1);
     }
 
-    void DeferredRenderer::initGbuffer() {
-        auto position = std::make_shared<Core::Tex2D>(GL_TEXTURE_2D, GL_RGBA32F, gBuffer.width, gBuffer.height, GL_RGBA, GL_FLOAT, GL_CLAMP_TO_EDGE, GL_NEAREST);
-        auto normal = std::make_shared<Core::Tex2D>(GL_TEXTURE_2D, GL_RGBA32F, gBuffer.width, gBuffer.height, GL_RGBA, GL_FLOAT, GL_CLAMP_TO_EDGE, GL_NEAREST);
-        auto albedospec = std::make_shared<Core::Tex2D>(GL_TEXTURE_2D, GL_RGBA32F, gBuffer.width, gBuffer.height, GL_RGBA, GL_FLOAT, GL_CLAMP_TO_EDGE, GL_NEAREST);
-        auto metrou = std::make_shared<Core::Tex2D>(GL_TEXTURE_2D, GL_RGBA, gBuffer.width, gBuffer.height, GL_RGBA, GL_UNSIGNED_BYTE, GL_CLAMP_TO_EDGE, GL_NEAREST);
-        
-        gBuffer.Bind();
-        gBuffer.AttachColorTex(position, 0);
-        gBuffer.AttachColorTex(normal, 1);
-        gBuffer.AttachColorTex(albedospec, 2);
-        gBuffer.AttachColorTex(metrou, 3);
-        
-        gBuffer.AttachDepthRbo24();
-    
-        gBuffer.CheckStatus();
-    }
-
-    void DeferredRenderer::initOutput() {
-        auto color = std::make_shared<Core::Tex2D>(GL_TEXTURE_2D, GL_RGBA32F, output.width, output.height, GL_RGBA, GL_FLOAT, GL_CLAMP_TO_EDGE, GL_LINEAR);
-
-        output.Bind();
-        output.AttachColorTex(color);
-        output.AttachDepthRbo24();
-        output.CheckStatus();
-    }
-
-    void DeferredRenderer::parseLights(Scene::Scene& scene) {
-        // ---- Clear existing lists ----
-        directionalLightNodes.clear();
-        pointLightNodes.clear();
-        
-        // ---- Parse scene for Light nodes ----
-        std::queue<Scene::SceneNode*> node_queue;
-
-        node_queue.emplace(&scene);
-        while (!node_queue.empty()) {
-            Scene::SceneNode* curr = node_queue.front();
-            node_queue.pop();
-
-            if (curr->component) {
-                if (curr->component->IsLight()) {
-                    if (curr->component->type == Component::ComponentType::DirLight)
-                        directionalLightNodes.emplace_back(curr);
-                    else if (curr->component->type == Component::ComponentType::PointLight)
-                        pointLightNodes.emplace_back(curr); 
-                }
-            }
-
-            for (const auto& child : curr->children)
-                node_queue.emplace(child.get());
-        }
-    }
-
     void DeferredRenderer::updateGlobalUniforms(Scene::Scene& scene, Component::Camera& camera) {
+        uniformRing->BeginFrame();
+
         // 0 - View, projection transforms  
-        uboVsMatrices->UpdateData(0, sizeof(glm::mat4), glm::value_ptr(camera.View()));
-        uboVsMatrices->UpdateData(sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(camera.projection));
+        const size_t vsMatrices = uniformRing->Write(VertexMatricesBlock{camera.View(), camera.projection});
         // 1 - Inverse view transform
-        const glm::mat4 inv_view = glm::inverse(camera.View());
-        uboFsMatrices->UpdateData(0, sizeof(glm::mat4), glm::value_ptr(inv_view));
-        // 2 - Camera position, front (viewspace)
-        const glm::vec3 dummy_cam_pos = glm::vec3(0); // shaders work in view space
-        uboFsCamera->UpdateData(0, sizeof(glm::vec3), glm::value_ptr(dummy_cam_pos));
-        uboFsCamera->UpdateData(16, sizeof(glm::vec3), glm::value_ptr(camera.transform.Front()));
+        const size_t fsMatrices = uniformRing->Write(glm::inverse(camera.View()));
+        // 2 - Camera position, front (viewspace). Shaders work in view space, so the position is the origin.
+        const size_t cameraBlock = uniformRing->Write(CameraBlock{glm::vec4(0), glm::vec4(camera.transform.Front(), 0)});
+
+        // Lights derive their lightspace transforms from their world transforms
+        for (const auto& entry : scene.Lights().PointLights())
+            entry.light->Draw(entry.node->WorldMatrix());
+        // Shadow map tiles are sized by where the lights are, and cascades then snapped to their tile's texels
+        shadowAtlas.Allocate(scene.Lights(), camera.View(), camera.projection, maxDirectionalLights);
+        for (const auto& entry : scene.Lights().DirectionalLights()) {
+            entry.light->Draw(entry.node->WorldMatrix());
+            const std::vector<ShadowAtlas::Slot>* slots = shadowAtlas.Slots(entry.light);
+            entry.light->FitCascades(camera.View(), camera.projection, slots ? slots->front().tile.size : shadowAtlas.maxTileSize);
+        }
 
         // 3 - Directional light colors, direction, lightspace transform
-        // 4 - Point light count, colors, attenuations, positions, positions (worldspace)
-        parseLights(scene);
-        setDirectionalLightUniforms(camera);
-        setPointLightUniforms(camera);
+        // 4 - Point light count, colors, attenuations, positions, positions (worldspace), light clusters
+        setDirectionalLightUniforms(scene.Lights(), camera);
+        setPointLightUniforms(scene.Lights(), camera);
+
+        uniformRing->Flush();
+        uniformRing->BindRange(0, vsMatrices, sizeof(VertexMatricesBlock));
+        uniformRing->BindRange(1, fsMatrices, sizeof(glm::mat4));
+        uniformRing->BindRange(2, cameraBlock, sizeof(CameraBlock));
     }
 
-    void DeferredRenderer::setDirectionalLightUniforms(Component::Camera& camera) {
-        const float total_count = directionalLightNodes.size();
-        int shadow_count = 0;
-        
-        uboFsDirlight->UpdateData(0, sizeof(float), &total_count);
+    void DeferredRenderer::setDirectionalLightUniforms(const Scene::LightRegistry& lights, Component::Camera& camera) {
+        const auto& dirlights = lights.DirectionalLights();
+        const int total_count = std::min(static_cast<int>(dirlights.size()), maxDirectionalLights);
 
-        for (int i = 0; i < total_count; i++) {
-            const Component::DirectionalLight& dirlight = dynamic_cast<Component::DirectionalLight&>(*directionalLightNodes[i]->component);
+        // ---- Fill the block in place (std140: count, then per light color, direction, cascade splits, cascade matrices, cascade tiles) ----
+        // Sized for every slot the shader declares, since a bound range must cover the whole block
+        constexpr int lightStride = 3 + 5 * Component::DirectionalLight::maxCascades;
+        const size_t size = (1 + lightStride * maxDirectionalLights) * sizeof(glm::vec4);
+        const size_t offset = uniformRing->Allocate(size);
+        glm::vec4* data = static_cast<glm::vec4*>(uniformRing->Data(offset));
+        std::fill(data, data + 1 + lightStride * maxDirectionalLights, glm::vec4(0));
+        data[0].x = total_count;
 
-            unsigned int offset = 16 + i*96;
-            
-            // Color
-            const glm::vec4 color = glm::vec4(dirlight.color * dirlight.intensity, 0);
-            uboFsDirlight->UpdateData(offset, sizeof(glm::vec4), glm::value_ptr(color));
-            
-            // Direction and shadow map index as w component
-            glm::vec4 direction = glm::vec4( glm::mat3(glm::transpose(glm::inverse(camera.View()))) * directionalLightNodes[i]->transform.Front(), -1 );
-            if (dirlight.HasShadows()) {
-                direction.w = shadow_count++;
-                uboFsDirlight->UpdateData(offset + 32, sizeof(glm::mat4), glm::value_ptr(dirlight.LightspaceMatrix()));
+        const glm::mat3 normal_matrix = glm::mat3(glm::transpose(glm::inverse(camera.View())));
+        for (int i = 0; i < total_count; i++) {
+            const Component::DirectionalLight& dirlight = *dirlights[i].light;
+            glm::vec4* block = &data[1 + lightStride*i];
+
+            // Color and cascade count as w component
+            block[0] = glm::vec4(dirlight.color * dirlight.intensity, 0);
+            // Direction
+            const glm::vec3 direction_world = glm::normalize(glm::mat3(dirlights[i].node->WorldMatrix()) * Direction::front);
+            block[1] = glm::vec4(normal_matrix * direction_world, 0);
+            // Each cascade has an atlas tile, unless the light has none (as DirectionalShadowModule::Render)
+            if (const std::vector<ShadowAtlas::Slot>* slots = shadowAtlas.Slots(&dirlight)) {
+                constexpr int firstTile = 3 + 4 * Component::DirectionalLight::maxCascades;
+                block[0].w = dirlight.CascadeCount();
+                for (int c = 0; c < dirlight.CascadeCount(); c++) {
+                    block[2][c] = dirlight.CascadeSplits()[c];
+                    const glm::mat4& lightspace = dirlight.CascadeMatrices()[c];
+                    for (int col = 0; col < 4; col++)
+                        block[3 + 4*c + col] = lightspace[col];
+                    block[firstTile + c] = glm::vec4(shadowAtlas.Rect((*slots)[c].tile), 0);
+                }
             }
-            uboFsDirlight->UpdateData(offset + 16, sizeof(glm::vec4), glm::value_ptr(direction));
         }
+        uniformRing->BindRange(3, offset, size);
     }
 
-    void DeferredRenderer::setPointLightUniforms(Component::Camera& camera) {
-        const float total_count = pointLightNodes.size();
-        int shadow_count = 0;
-
-        uboFsPointlight->UpdateData(0, sizeof(float), &total_count);
+    void DeferredRenderer::setPointLightUniforms(const Scene::LightRegistry& lights, Component::Camera& camera) {
+        const auto& pointlights = lights.PointLights();
+        const float total_count = pointlights.size();
 
-        for (int i = 0; i < total_count; i++) {
-            const Component::PointLight& pointlight = dynamic_cast<Component::PointLight&>(*pointLightNodes[i]->component);
+        // ---- Pack light data (7 texels per light) ----
+        pointLightSpheres.clear();
+        pointLightData.clear();
+        for (const auto& entry : pointlights) {
+            const Component::PointLight& pointlight = *entry.light;
 
-            unsigned int offset = 16 + i*64;
-            
             // Color
-            const glm::vec4 color = glm::vec4(pointlight.color * pointlight.intensity, 0);
-            uboFsPointlight->UpdateData(offset, sizeof(glm::vec4), glm::value_ptr(color));
-
-            // Attenuation
-            const glm::vec4 attenuation = glm::vec4(pointlight.AttenuationConstant(), pointlight.AttenuationLinear(), pointlight.AttenuationQuadratic(), 0);
-            uboFsPointlight->UpdateData(offset + 16, sizeof(glm::vec4), glm::value_ptr(attenuation));
-            
-            // Position (viewspace)
-            glm::vec4 position_view = camera.View() * glm::vec4(pointLightNodes[i]->transform.position, 1);
-            position_view.w = pointlight.FarPlane();
-            uboFsPointlight->UpdateData(offset + 32, sizeof(glm::vec4), glm::value_ptr(position_view));
-            // Position (worldspace) and shadow map index as w component
-            glm::vec4 position_world = glm::vec4(pointLightNodes[i]->transform.position, -1);
-            if (pointlight.HasShadows()) {
-                position_world.w = shadow_count++;
+            pointLightData.emplace_back(pointlight.color * pointlight.intensity, 0);
+            // Attenuation and radius of influence
+            const float radius = pointlight.Radius();
+            pointLightData.emplace_back(pointlight.AttenuationConstant(), pointlight.AttenuationLinear(), pointlight.AttenuationQuadratic(), radius);
+            // Position (viewspace) and shadow map far plane as w component
+            const glm::vec3 position_world = entry.node->WorldMatrix()[3];
+            const glm::vec3 position_view = camera.View() * glm::vec4(position_world, 1);
+            pointLightData.emplace_back(position_view, pointlight.FarPlane());
+            // Position (worldspace) and atlas tile scale as w component, then the tile offset of each cube face, two per texel.
+            // Lights without tiles have a scale of 0.
+            const std::vector<ShadowAtlas::Slot>* slots = shadowAtlas.Slots(&pointlight);
+            pointLightData.emplace_back(position_world, slots ? shadowAtlas.Rect(slots->front().tile).z : 0.f);
+            for (int face = 0; face < 6; face += 2) {
+                const glm::vec2 first = slots ? glm::vec2(shadowAtlas.Rect((*slots)[face].tile)) : glm::vec2(0);
+                const glm::vec2 second = slots ? glm::vec2(shadowAtlas.Rect((*slots)[face + 1].tile)) : glm::vec2(0);
+                pointLightData.emplace_back(first, second);
             }
-            uboFsPointlight->UpdateData(offset + 48, sizeof(glm::vec4), glm::value_ptr(position_world));
+
+            pointLightSpheres.push_back({position_view, radius});
         }
+
+        // ---- Count goes in the frame ring every frame ----
+        const size_t countBlock = uniformRing->Write(glm::vec4(total_count, 0, 0, 0));
+        uniformRing->BindRange(4, countBlock, sizeof(glm::vec4));
+
+        // ---- Upload and re-cluster only if the lights or the projection changed ----
+        if (lights.Generation() == pointLightGeneration && pointLightData == pointLightDataUploaded && camera.projection == clusterProjection)
+            return;
+        tboPointlights->UpdateData(pointLightData.size() * sizeof(glm::vec4), pointLightData.data());
+        pointLightGeneration = lights.Generation();
+        pointLightDataUploaded = pointLightData;
+
+        // ---- Assign lights to clusters ----
+        clusterProjection = camera.projection;
+        lightClusters.SetProjection(camera.projection);
+        lightClusters.Build(pointLightSpheres);
+        tboClusters->UpdateData(lightClusters.Clusters().size() * sizeof(LightClusterGrid::Cluster), lightClusters.Clusters().data());
+        tboClusterIndices->UpdateData(lightClusters.LightIndices().size() * sizeof(unsigned int), lightClusters.LightIndices().data());
+    }
+
+    void DeferredRenderer::updateDrawData(Scene::Scene& scene) {
+        // Draw IDs are drawable indices, shared by the geometry and shadow passes
+        drawData.Clear();
+        for (const auto& drawable : scene.Drawables())
+            drawData.Add(drawable.worldMatrix, RenderQueue::MaterialFor(*drawable.mesh));
+        drawData.Upload();
     }
 
-    void DeferredRenderer::geometryPass(Scene::Scene& scene) {
+    void DeferredRenderer::geometryPass(Scene::Scene& scene, Component::Camera& camera, const RenderGraph& graph) {
+        Core::Fbo& gBuffer = RenderTargetPool::Instance().Framebuffer({graph.Texture("gNormal"), graph.Texture("gAlbedo"), graph.Texture("gMetRouOcc")}, graph.Texture("gDepth"));
         gBuffer.Bind();
         gBuffer.SetViewportDims();
         gBuffer.ClearColor();
         gBuffer.ClearDepth();
         // need logic for multiple materials - use visibility buffer later, use branching now
-        glEnable(GL_CULL_FACE);
-        glCullFace(GL_BACK);
-        scene.Draw();
-    }
+        Core::GlState::Instance().SetEnabled(GL_CULL_FACE, true);
+        Core::GlState::Instance().CullFace(GL_BACK);
+
+        // ---- Frustum culling ----
+        visibleDrawables.clear();
+        scene.DrawableBvh().Query(Bounds::Frustum(camera.projection * camera.View()), visibleDrawables);
+        stats.geometry.drawn = visibleDrawables.size();
+        stats.geometry.culled = scene.Drawables().size() - visibleDrawables.size();
+
+        // ---- Draw ----
+        // Sorted by program, material and VAO, then front to back. Depth is normalized by the far plane, recovered from the projection.
+        const float farPlane = camera.projection[3][2] / (camera.projection[2][2] + 1.f);
+        geometryQueue.Clear();
+        geometryQueue.Push(scene, visibleDrawables, RenderQueue::Pass::Geometry, true, camera.transform.position, farPlane);
+        geometryQueue.Sort();
+        drawData.Bind();
+        if (depthPrepass) {
+            // Same sorted list; with depth complete, only the nearest surface passes GL_EQUAL
+            depthPrepassModule.Render(scene, geometryQueue);
+            Core::GlState::Instance().DepthFunc(GL_EQUAL);
+            Core::GlState::Instance().DepthMask(false);
+        }
 
-    void DeferredRenderer::ssaoPass(Component::Camera& camera) {
-        ssaoModule.Render(*gBuffer.colorAtts[0], *gBuffer.colorAtts[1], camera.projection);
+        // Albedo is stored as sRGB, encoded on write
+        Core::GlState::Instance().SetEnabled(GL_FRAMEBUFFER_SRGB, true);
+
+        // ---- Count shaded fragments ----
+        Core::Query& query = *geometrySampleQueries[geometrySampleQuery];
+        if (query.ResultAvailable())
+            stats.geometrySamples = query.Result();
+        query.Bind();
+        geometryQueue.Submit(scene);
+        query.Unbind();
+        geometrySampleQuery = (geometrySampleQuery + 1) % 2;
+        stats.geometrySubmit = geometryQueue.Stats();
+
+        Core::GlState::Instance().SetEnabled(GL_FRAMEBUFFER_SRGB, false);
+        Core::GlState::Instance().DepthFunc(GL_LEQUAL);
+        Core::GlState::Instance().DepthMask(true);
     }
 
-    void DeferredRenderer::shadowMapPass(Scene::Scene& scene) {        
-        dirShadowModule.Render(scene, directionalLightNodes);
-        pointShadowModule.Render(scene, pointLightNodes);
+    void DeferredRenderer::ssaoPass(Component::Camera& camera, const RenderGraph& graph) {
+        ssaoModule.resolution = ssaoResolution;
+        ssaoModule.sampleCount = ssaoSamples;
+        ssaoModule.Render(*graph.Texture("gDepth"), *graph.Texture("gNormal"), camera.projection, graph.Texture("ssao"));
     }
 
-    void DeferredRenderer::lightingPass(Scene::Environment& env) {
+    void DeferredRenderer::lightingPass(Scene::Environment& env, Component::Camera& camera, const RenderGraph& graph) {
         // ---- Prep framebuffer ----
-        output.Bind();
-        output.SetViewportDims();
-        output.ClearColor();
-        output.ClearDepth();
+        // No depth attachment: the G-buffer's depth is read here, and only attached for the forward pass
+        Core::Fbo& lit = RenderTargetPool::Instance().Framebuffer({graph.Texture("color")});
+        lit.Bind();
+        lit.SetViewportDims();
+        lit.ClearColor();
         
         // ---- Set uniforms ---- 
         lightingPassProgram->Use();
-        lightingPassProgram->SetInt("gPosition", 0);
-        lightingPassProgram->SetInt("gNormal", 1);
-        lightingPassProgram->SetInt("gAlbedoSpec", 2);
-        lightingPassProgram->SetInt("gMetRouOcc", 3);
-        lightingPassProgram->SetInt("ssao", ssao);
-        lightingPassProgram->SetInt("ssaoMap", 4);
-        lightingPassProgram->SetInt("irradianceMap", 5);
-        lightingPassProgram->SetInt("prefilterMap", 6);
-        lightingPassProgram->SetInt("brdfLUT", 7);
-        lightingPassProgram->SetInt("shadowmap_2d_array_shadow", 8);
-        lightingPassProgram->SetInt("shadowmap_cube_array_shadow", 9);
+        lightingPassProgram->Set(gDepthUniform, 0);
+        lightingPassProgram->Set(gNormalUniform, 1);
+        lightingPassProgram->Set(gAlbedoUniform, 2);
+        lightingPassProgram->Set(gMetRouOccUniform, 3);
+        lightingPassProgram->Set(invProjectionUniform, glm::inverse(camera.projection));
+        lightingPassProgram->Set(ssaoUniform, ssao);
+        lightingPassProgram->Set(ssaoMapUniform, 4);
+        lightingPassProgram->Set(irradianceMapUniform, 5);
+        lightingPassProgram->Set(prefilterMapUniform, 6);
+        lightingPassProgram->Set(brdfLutUniform, 7);
+        lightingPassProgram->Set(shadowAtlasUniform, 8);
+        lightingPassProgram->Set(pointlightDataUniform, 10);
+        lightingPassProgram->Set(clusterGridUniform, 11);
+        lightingPassProgram->Set(clusterLightIndicesUniform, 12);
+        lightingPassProgram->Set(clusterTilesXUniform, lightClusters.tilesX);
+        lightingPassProgram->Set(clusterTilesYUniform, lightClusters.tilesY);
+        lightingPassProgram->Set(clusterSlicesUniform, lightClusters.depthSlices);
+        lightingPassProgram->Set(clusterDepthScaleUniform, lightClusters.DepthScale());
+        lightingPassProgram->Set(clusterDepthBiasUniform, lightClusters.DepthBias());
 
         // ---- Bind textures ---- 
         // G-buffer
-        for (int i = 0; i < gBuffer.colorAtts.size(); i++) {
-            gBuffer.colorAtts[i]->Bind(i);
-        }
+        graph.Texture("gDepth")->Bind(0);
+        graph.Texture("gNormal")->Bind(1);
+        graph.Texture("gAlbedo")->Bind(2);
+        graph.Texture("gMetRouOcc")->Bind(3);
         // SSAO
         if (ssao) {
-            ssaoModule.ssao->Bind(4);
+            graph.Texture("ssao")->Bind(4);
         }
         // IBL
         if (env.skybox) {
             env.irradiance->Bind(5);
             env.prefilter->Bind(6);
             env.brdfLut->Bind(7);
-            lightingPassProgram->SetFloat("ibl", env.iblIntensity);
+            lightingPassProgram->Set(iblUniform, env.iblIntensity);
         }
         // Shadow maps
-        dirShadowModule.depthMap->Bind(8);
-        pointShadowModule.depthMap->Bind(9);
+        graph.Texture("shadowAtlas")->Bind(8);
+        // Clustered point lights
+        tboPointlights->Bind(10);
+        tboClusters->Bind(11);
+        tboClusterIndices->Bind(12);
         
         // ---- Draw ----
+        Core::GlState::Instance().SetEnabled(GL_DEPTH_TEST, false);
         Component::Primitive::DrawQuad();
+        Core::GlState::Instance().SetEnabled(GL_DEPTH_TEST, true);
     }
 
-    void DeferredRenderer::forwardPass(Component::Camera& camera, Scene::Environment& env) {
-        // ---- Blit depth data from gBuffer to output ----
-        gBuffer.BlitTo(output, false, true);
-        
+    void DeferredRenderer::forwardPass(Component::Camera& camera, Scene::Environment& env, const RenderGraph& graph) {
         // ---- Prep framebuffer ----
+        Core::Fbo& output = RenderTargetPool::Instance().Framebuffer({graph.Texture("color")}, graph.Texture("gDepth"));
         output.Bind();
         output.SetViewportDims();
 
         // ---- Draw ----
         env.DrawSkybox(camera);
     }
-
-    void DeferredRenderer::framebufferSizeCallback(int width, int height) {
-        gBuffer.Resize(width, height);
-        output.Resize(width, height);
-    }
 }
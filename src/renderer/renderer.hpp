@@ -9,9 +9,15 @@
 #include "component/camera.hpp"
 #include "component/light.hpp"
 
+#include "renderer/cluster.hpp"
+#include "renderer/drawdata.hpp"
 #include "renderer/module.hpp"
+#include "renderer/postprocessing.hpp"
+#include "renderer/rendergraph.hpp"
+#include "renderer/renderqueue.hpp"
+#include "renderer/rendertargetpool.hpp"
+#include "renderer/shadowatlas.hpp"
 
-#include "context/inputsevents.hpp"
 #include "context/window.hpp"
 
 #include <vector>
@@ -33,51 +39,106 @@ namespace Renderer {
         
         public:
             DeferredRenderer();
-            ~DeferredRenderer();
 
             bool ssao = true;
+            SsaoModule::Resolution ssaoResolution = SsaoModule::Resolution::Full;
+            int ssaoSamples = 64;   // 8, 16, 32 or 64
+            PointShadowModule::CubeMode pointShadowMode = PointShadowModule::CubeMode::PerFace;
+            // Lays down depth with a depth-only draw first, so the G-buffer pass writes each pixel once
+            bool depthPrepass = false;
+            // Added to the frame's graph, from the lit color into the default framebuffer. If null, Render() returns the color.
+            PostProcessing::Chain* postProcessing = nullptr;
+
+            // Statistics from the last Render()
+            struct RenderStats {
+                CullStats geometry;
+                CullStats directionalShadows;
+                CullStats pointShadows;
+                int shadowTilesRendered = 0;    // Directional cascades and point light cube faces redrawn rather than cached
+                ShadowAtlas::AtlasStats shadowAtlas;
+                RenderQueue::SubmitStats geometrySubmit;
+                // Fragments that passed the depth test in the G-buffer pass; read back without stalling, so a frame or two late
+                GLuint64 geometrySamples = 0;
+            };
+            const RenderStats& Stats() const { return stats; }
+            // The last frame's passes, with their timings
+            const RenderGraph& Graph() const { return graph; }
             
+            // The returned framebuffer stays valid until the next Render(). Null when postProcessing has drawn the frame.
             Core::Fbo* Render(Scene::Scene& scene, Component::Camera& camera) override;
             Core::Fbo* Render(Scene::Scene& scene, Component::Camera& camera, Scene::Environment& env);
 
         private:  
-            Core::Fbo gBuffer;
-            Core::Fbo output;
+            // Declared afresh each Render(). Its targets come from the RenderTargetPool at the window's size and go back after
+            // their last use; the lit color, when returned, is held until the next Render(), since the caller reads it.
+            RenderGraph graph;
             
+            DepthPrepassModule depthPrepassModule;
             SsaoModule ssaoModule;
+            ShadowAtlas shadowAtlas;
             DirectionalShadowModule dirShadowModule;
             PointShadowModule pointShadowModule;
 
             inline static std::shared_ptr<Core::Program> lightingPassProgram;
+            inline static Core::Uniform<int> gDepthUniform, gNormalUniform, gAlbedoUniform, gMetRouOccUniform;
+            inline static Core::Uniform<int> ssaoUniform, ssaoMapUniform;
+            inline static Core::Uniform<int> irradianceMapUniform, prefilterMapUniform, brdfLutUniform;
+            inline static Core::Uniform<float> iblUniform;
+            inline static Core::Uniform<int> shadowAtlasUniform;
+            inline static Core::Uniform<int> pointlightDataUniform, clusterGridUniform, clusterLightIndicesUniform;
+            inline static Core::Uniform<int> clusterTilesXUniform, clusterTilesYUniform, clusterSlicesUniform;
+            inline static Core::Uniform<float> clusterDepthScaleUniform, clusterDepthBiasUniform;
+            inline static Core::Uniform<glm::mat4> invProjectionUniform;
+
+            // Every uniform block, rewritten each frame into the next region of one buffer
+            std::shared_ptr<Core::UboRing> uniformRing;
+            // std140 layouts of the fixed-size blocks
+            struct VertexMatricesBlock {
+                glm::mat4 view;
+                glm::mat4 projection;
+            };
+            struct CameraBlock {
+                glm::vec4 position;
+                glm::vec4 front;
+            };
+
+            static constexpr int maxDirectionalLights = 8;
+
+            // Clustered point lights
+            LightClusterGrid lightClusters;
+            std::shared_ptr<Core::Tbo> tboPointlights;
+            std::shared_ptr<Core::Tbo> tboClusters;
+            std::shared_ptr<Core::Tbo> tboClusterIndices;
+            std::vector<LightClusterGrid::LightSphere> pointLightSpheres;
+            std::vector<glm::vec4> pointLightData;
+            std::vector<glm::vec4> pointLightDataUploaded;
+            unsigned int pointLightGeneration = -1;
+            glm::mat4 clusterProjection = glm::mat4(0);
+
+            // Per-draw transforms and material constants, indexed by drawable
+            DrawDataBuffer drawData;
+            // Records of this renderer's DrawDataBuffer::DrawImmediate() draws, restarted every Render()
+            DrawDataBuffer immediateDrawData;
+            std::vector<unsigned int> visibleDrawables;
+            RenderQueue geometryQueue;
+            // GL_SAMPLES_PASSED around the G-buffer draws, alternated so each is read back two frames after it was issued
+            std::shared_ptr<Core::Query> geometrySampleQueries[2];
+            int geometrySampleQuery = 0;
+            RenderStats stats;
 
-            std::shared_ptr<Core::Ubo> uboVsMatrices;
-            std::shared_ptr<Core::Ubo> uboFsMatrices;
-            std::shared_ptr<Core::Ubo> uboFsCamera;
-            std::shared_ptr<Core::Ubo> uboFsDirlight;
-            std::shared_ptr<Core::Ubo> uboFsPointlight;
-
-            std::vector<Scene::SceneNode*> directionalLightNodes;
-            std::vector<Scene::SceneNode*> pointLightNodes;
-
-            std::shared_ptr<Context::EventListener> eventListener;
-            
             // Setup
             void initUniformBlocks();
-            void initGbuffer();
-            void initOutput();
             
             // Per frame
-            void parseLights(Scene::Scene& scene);
             void updateGlobalUniforms(Scene::Scene& scene, Component::Camera& camera);
-            void setDirectionalLightUniforms(Component::Camera& camera);
-            void setPointLightUniforms(Component::Camera& camera);
-            void geometryPass(Scene::Scene& scene);
-            void ssaoPass(Component::Camera& camera);
-            void shadowMapPass(Scene::Scene& scene);
-            void lightingPass(Scene::Environment& env);
-            void forwardPass(Component::Camera& camera, Scene::Environment& env);
-
-            void framebufferSizeCallback(int width, int height);
+            void setDirectionalLightUniforms(const Scene::LightRegistry& lights, Component::Camera& camera);
+            void setPointLightUniforms(const Scene::LightRegistry& lights, Component::Camera& camera);
+            void updateDrawData(Scene::Scene& scene);
+            void addPasses(Scene::Scene& scene, Component::Camera& camera, Scene::Environment& env);
+            void geometryPass(Scene::Scene& scene, Component::Camera& camera, const RenderGraph& graph);
+            void ssaoPass(Component::Camera& camera, const RenderGraph& graph);
+            void lightingPass(Scene::Environment& env, Component::Camera& camera, const RenderGraph& graph);
+            void forwardPass(Component::Camera& camera, Scene::Environment& env, const RenderGraph& graph);
     };
 
 }
\ No newline at end of file
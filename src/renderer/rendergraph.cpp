@@ -0,0 +1,317 @@
+#include "renderer/rendergraph.hpp"
+
+#include "core/glstate.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <queue>
+#include <stdexcept>
+
+namespace Renderer {
+
+    // ---- Builder ----
+
+    void RenderGraph::Builder::Read(const std::string& resource) {
+        graph.read(pass, resource);
+    }
+
+    void RenderGraph::Builder::Create(const std::string& resource, const RenderTargetPool::Desc& desc) {
+        graph.write(pass, resource, true, &desc);
+    }
+
+    void RenderGraph::Builder::Write(const std::string& resource) {
+        graph.write(pass, resource, false, nullptr);
+    }
+
+    void RenderGraph::Builder::SideEffect() {
+        graph.passes[pass].sideEffect = true;
+    }
+
+    // ---- Declaring a frame ----
+
+    RenderGraph::~RenderGraph() {
+        Reset();
+    }
+
+    void RenderGraph::Reset() {
+        // Only exported textures are still held; the rest went back to the pool after their last use
+        RenderTargetPool& pool = RenderTargetPool::Instance();
+        for (Resource& r : resources) {
+            if (!r.imported && r.texture)
+                pool.Release(std::static_pointer_cast<Core::Tex2D>(r.texture));
+        }
+        resources.clear();
+        resourceIndices.clear();
+        passes.clear();
+    }
+
+    int RenderGraph::resource(const std::string& name) {
+        auto [it, inserted] = resourceIndices.try_emplace(name, resources.size());
+        if (inserted) {
+            resources.emplace_back();
+            resources.back().name = name;
+        }
+        return it->second;
+    }
+
+    const RenderGraph::Resource& RenderGraph::find(const std::string& name) const {
+        auto it = resourceIndices.find(name);
+        if (it == resourceIndices.end())
+            throw std::runtime_error("Render graph has no resource named " + name);
+        return resources[it->second];
+    }
+
+    void RenderGraph::ImportTexture(const std::string& name, std::shared_ptr<Core::Tex> texture) {
+        Resource& r = resources[resource(name)];
+        if (r.declared)
+            throw std::runtime_error("Render graph resource " + name + " is declared twice");
+        r.declared = true;
+        r.imported = true;
+        r.desc.width = texture->width;
+        r.desc.height = texture->height;
+        r.desc.internalformat = texture->internalformat;
+        r.texture = std::move(texture);
+    }
+
+    void RenderGraph::ImportFramebuffer(const std::string& name, Core::Fbo* fbo, int width, int height) {
+        Resource& r = resources[resource(name)];
+        if (r.declared)
+            throw std::runtime_error("Render graph resource " + name + " is declared twice");
+        r.declared = true;
+        r.imported = true;
+        r.framebuffer = true;
+        r.fbo = fbo;
+        r.desc.width = width;
+        r.desc.height = height;
+    }
+
+    void RenderGraph::Export(const std::string& name) {
+        resources[resource(name)].exported = true;
+    }
+
+    void RenderGraph::AddPass(const std::string& name, const PassSetup& setup, const PassExecute& execute) {
+        for (const Pass& pass : passes) {
+            if (pass.name == name)
+                throw std::runtime_error("Render graph pass " + name + " is declared twice");
+        }
+        const int index = passes.size();
+        passes.emplace_back();
+        passes[index].name = name;
+        passes[index].execute = execute;
+        Builder builder(*this, index);
+        setup(builder);
+    }
+
+    const RenderTargetPool::Desc& RenderGraph::Describe(const std::string& name) const {
+        return find(name).desc;
+    }
+
+    void RenderGraph::read(int pass, const std::string& name) {
+        const int i = resource(name);
+        Resource& r = resources[i];
+        Pass& p = passes[pass];
+        if (std::find(p.writes.begin(), p.writes.end(), i) != p.writes.end())
+            throw std::runtime_error("Render graph pass " + p.name + " both samples and renders to " + name);
+        p.reads.push_back(i);
+        if (r.lastWriter >= 0) {
+            p.dependencies.push_back(r.lastWriter);
+            r.readersSinceWrite.push_back(pass);
+        } else {
+            // Not written yet: whatever the frame ends up writing
+            p.finalReads.push_back(i);
+        }
+    }
+
+    void RenderGraph::write(int pass, const std::string& name, bool create, const RenderTargetPool::Desc* desc) {
+        const int i = resource(name);
+        Resource& r = resources[i];
+        Pass& p = passes[pass];
+        if (std::find(p.reads.begin(), p.reads.end(), i) != p.reads.end())
+            throw std::runtime_error("Render graph pass " + p.name + " both samples and renders to " + name);
+        if (create) {
+            if (r.declared)
+                throw std::runtime_error("Render graph resource " + name + " is declared twice");
+            r.declared = true;
+            r.desc = *desc;
+        } else if (!r.declared) {
+            throw std::runtime_error("Render graph pass " + p.name + " writes " + name + " before it is created or imported");
+        }
+        // Drawing over the last writer's result depends on it; passes that read that result have to finish first
+        if (r.lastWriter >= 0)
+            p.dependencies.push_back(r.lastWriter);
+        for (int reader : r.readersSinceWrite) {
+            if (reader != pass)
+                p.after.push_back(reader);
+        }
+        r.lastWriter = pass;
+        r.readersSinceWrite.clear();
+        p.writes.push_back(i);
+    }
+
+    // ---- Executing ----
+
+    std::vector<int> RenderGraph::schedule() {
+        const int passCount = passes.size();
+
+        // ---- Bind reads of resources not yet written when they were declared ----
+        for (int p = 0; p < passCount; p++) {
+            for (int i : passes[p].finalReads) {
+                const Resource& r = resources[i];
+                if (!r.declared)
+                    throw std::runtime_error("Render graph pass " + passes[p].name + " reads " + r.name + ", which is never created or imported");
+                if (r.lastWriter == p)
+                    throw std::runtime_error("Render graph pass " + passes[p].name + " both samples and renders to " + r.name);
+                if (r.lastWriter >= 0)
+                    passes[p].dependencies.push_back(r.lastWriter);
+            }
+        }
+
+        // ---- Cull: keep what writes outside the graph, and everything that feeds it ----
+        std::vector<int> work;
+        for (int p = 0; p < passCount; p++) {
+            Pass& pass = passes[p];
+            pass.culled = !pass.sideEffect && std::none_of(pass.writes.begin(), pass.writes.end(), [&](int i) {
+                return resources[i].imported || resources[i].exported;
+            });
+            if (!pass.culled)
+                work.push_back(p);
+        }
+        while (!work.empty()) {
+            const int p = work.back();
+            work.pop_back();
+            for (int dependency : passes[p].dependencies) {
+                if (passes[dependency].culled) {
+                    passes[dependency].culled = false;
+                    work.push_back(dependency);
+                }
+            }
+        }
+
+        // ---- Order: topologically, and otherwise as declared ----
+        std::vector<std::vector<int>> successors(passes.size());
+        std::vector<int> pending(passes.size(), 0);
+        for (int p = 0; p < passCount; p++) {
+            if (passes[p].culled)
+                continue;
+            std::vector<int> predecessors = passes[p].dependencies;
+            predecessors.insert(predecessors.end(), passes[p].after.begin(), passes[p].after.end());
+            std::sort(predecessors.begin(), predecessors.end());
+            predecessors.erase(std::unique(predecessors.begin(), predecessors.end()), predecessors.end());
+            for (int predecessor : predecessors) {
+                if (!passes[predecessor].culled) {
+                    successors[predecessor].push_back(p);
+                    pending[p]++;
+                }
+            }
+        }
+        std::priority_queue<int, std::vector<int>, std::greater<int>> ready;
+        size_t kept = 0;
+        for (int p = 0; p < passCount; p++) {
+            if (!passes[p].culled) {
+                kept++;
+                if (pending[p] == 0)
+                    ready.push(p);
+            }
+        }
+        std::vector<int> order;
+        while (!ready.empty()) {
+            const int p = ready.top();
+            ready.pop();
+            order.push_back(p);
+            for (int successor : successors[p]) {
+                if (--pending[successor] == 0)
+                    ready.push(successor);
+            }
+        }
+        if (order.size() != kept)
+            throw std::runtime_error("Render graph has a dependency cycle");
+
+        // ---- Transient lifetimes, in execution order ----
+        for (int k = 0; k < static_cast<int>(order.size()); k++) {
+            const Pass& pass = passes[order[k]];
+            for (const auto* uses : {&pass.reads, &pass.writes}) {
+                for (int i : *uses) {
+                    Resource& r = resources[i];
+                    if (r.firstUse < 0)
+                        r.firstUse = k;
+                    r.lastUse = k;
+                }
+            }
+        }
+        return order;
+    }
+
+    void RenderGraph::Execute() {
+        const std::vector<int> order = schedule();
+        RenderTargetPool& pool = RenderTargetPool::Instance();
+        Profiler& profiler = Profiler::Instance();
+
+        stats.clear();
+        for (int k = 0; k < static_cast<int>(order.size()); k++) {
+            Pass& pass = passes[order[k]];
+            for (Resource& r : resources) {
+                if (!r.imported && r.firstUse == k)
+                    r.texture = pool.Acquire(r.desc);
+            }
+
+            const auto start = std::chrono::steady_clock::now();
+            profiler.BeginCpu(pass.name);
+            profiler.BeginGpu(pass.name);
+            pass.execute(*this);
+            profiler.EndGpu();
+            profiler.EndCpu();
+            const auto end = std::chrono::steady_clock::now();
+
+            PassStats passStats;
+            passStats.name = pass.name;
+            passStats.cpuMs = std::chrono::duration<float, std::milli>(end - start).count();
+            const Profiler::ScopeStats* gpu = profiler.FindGpu(pass.name);
+            passStats.gpuMs = gpu ? gpu->lastMs : 0.f;
+            stats.push_back(passStats);
+
+            for (Resource& r : resources) {
+                if (!r.imported && !r.exported && r.lastUse == k) {
+                    pool.Release(std::static_pointer_cast<Core::Tex2D>(r.texture));
+                    r.texture.reset();
+                }
+            }
+        }
+        for (const Pass& pass : passes) {
+            if (pass.culled) {
+                PassStats passStats;
+                passStats.name = pass.name;
+                passStats.culled = true;
+                stats.push_back(passStats);
+            }
+        }
+    }
+
+    float RenderGraph::GpuMs(const std::string& pass) const {
+        for (const PassStats& passStats : stats) {
+            if (passStats.name == pass)
+                return passStats.gpuMs;
+        }
+        return 0.f;
+    }
+
+    const std::shared_ptr<Core::Tex>& RenderGraph::Texture(const std::string& name) const {
+        const Resource& r = find(name);
+        if (!r.texture)
+            throw std::runtime_error("Render graph resource " + name + " has no texture outside the passes that use it");
+        return r.texture;
+    }
+
+    void RenderGraph::BindTarget(const std::string& name) const {
+        const Resource& r = find(name);
+        if (!r.framebuffer) {
+            RenderTargetPool::Instance().Framebuffer({Texture(name)}).Bind();
+        } else if (r.fbo) {
+            r.fbo->Bind();
+        } else {
+            Core::GlState::Instance().BindFramebuffer(GL_FRAMEBUFFER, 0);
+            Core::GlState::Instance().Viewport(0, 0, r.desc.width, r.desc.height);
+        }
+    }
+
+}
\ No newline at end of file
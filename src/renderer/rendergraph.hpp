@@ -0,0 +1,125 @@
+#pragma once
+
+#include "core/globject.hpp"
+#include "core/tex.hpp"
+#include "renderer/profiler.hpp"
+#include "renderer/rendertargetpool.hpp"
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Renderer {
+
+    // A frame as passes that declare the named resources they read and write, rather than a fixed sequence of calls.
+    // Execute() orders the passes by those dependencies, culls the ones whose results nothing kept reads, acquires each
+    // transient texture from the RenderTargetPool just before its first use and releases it after its last, and times every
+    // pass on the CPU and GPU as a Profiler scope of its name. Passes are declared afresh each frame, so options just change what gets declared.
+    // A read sees the resource as of the passes declared before it, or, if none has written it yet, as the frame leaves it.
+    // GL orders a render-to-texture before later reads of it by itself, so there are no barriers to issue; what the graph
+    // enforces instead is that no pass samples a texture it renders to.
+    class RenderGraph {
+        public:
+            // Handed to a pass's setup, to declare what it uses
+            class Builder {
+                public:
+                    // Sampled or otherwise read
+                    void Read(const std::string& resource);
+                    // A new transient texture that the pass renders to
+                    void Create(const std::string& resource, const RenderTargetPool::Desc& desc);
+                    // Rendered to on top of what it already holds
+                    void Write(const std::string& resource);
+                    // Kept even if nothing reads what it writes
+                    void SideEffect();
+
+                private:
+                    friend class RenderGraph;
+                    Builder(RenderGraph& graph, int pass) : graph(graph), pass(pass) {}
+                    RenderGraph& graph;
+                    const int pass;
+            };
+            using PassSetup = std::function<void(Builder&)>;
+            using PassExecute = std::function<void(const RenderGraph&)>;
+
+            // Of one pass in the last Execute()
+            struct PassStats {
+                std::string name;
+                bool culled = false;
+                float cpuMs = 0.f;
+                // The Profiler's latest, read back without stalling, so a few frames late
+                float gpuMs = 0.f;
+            };
+
+            RenderGraph() = default;
+            // Rule of five
+            ~RenderGraph();
+            RenderGraph(const RenderGraph& other) = delete;
+            RenderGraph(RenderGraph&& other) = delete;
+            RenderGraph& operator=(const RenderGraph& other) = delete;
+            RenderGraph& operator=(RenderGraph&& other) = delete;
+
+            // ---- Declaring a frame ----
+            // Forgets the last frame's passes and resources, releasing what was exported
+            void Reset();
+            // A texture that lives outside the graph, such as a persistent shadow map. Passes writing it are always kept.
+            void ImportTexture(const std::string& resource, std::shared_ptr<Core::Tex> texture);
+            // A framebuffer to render into, or the default one if null. Passes writing it are always kept.
+            void ImportFramebuffer(const std::string& resource, Core::Fbo* fbo, int width, int height);
+            // Keeps a transient texture, and the passes writing it, until the next Reset()
+            void Export(const std::string& resource);
+            // Declares the pass by calling setup right away; execute is called from Execute() if the pass is kept
+            void AddPass(const std::string& name, const PassSetup& setup, const PassExecute& execute);
+            // Size and format of a declared resource
+            const RenderTargetPool::Desc& Describe(const std::string& resource) const;
+
+            void Execute();
+            const std::vector<PassStats>& LastFrame() const { return stats; }
+            // GPU time of the named pass in the last Execute(), or 0 if it was culled or not declared
+            float GpuMs(const std::string& pass) const;
+
+            // ---- During Execute(), or after it for exported resources ----
+            const std::shared_ptr<Core::Tex>& Texture(const std::string& resource) const;
+            // Binds the resource as the only color target, with a viewport covering it
+            void BindTarget(const std::string& resource) const;
+
+        private:
+            struct Resource {
+                std::string name;
+                RenderTargetPool::Desc desc;
+                std::shared_ptr<Core::Tex> texture;     // Transient while acquired, or imported
+                bool declared = false;                  // Created or imported, not just read ahead of that
+                bool imported = false;
+                bool framebuffer = false;               // Imported framebuffer rather than a texture
+                Core::Fbo* fbo = nullptr;               // Null for the default framebuffer
+                bool exported = false;
+                int lastWriter = -1;                    // While declaring
+                std::vector<int> readersSinceWrite;     // While declaring
+                int firstUse = -1;                      // Indices into the execution order
+                int lastUse = -1;
+            };
+            struct Pass {
+                std::string name;
+                PassExecute execute;
+                std::vector<int> reads;
+                std::vector<int> writes;                // Created ones included
+                std::vector<int> dependencies;          // Passes whose results it reads
+                std::vector<int> after;                 // Passes that read what it overwrites; ordering only
+                std::vector<int> finalReads;            // Read as the frame leaves them; bound in Execute()
+                bool sideEffect = false;
+                bool culled = false;
+            };
+            std::vector<Resource> resources;
+            std::map<std::string, int> resourceIndices;
+            std::vector<Pass> passes;
+            std::vector<PassStats> stats;
+
+            int resource(const std::string& name);
+            const Resource& find(const std::string& name) const;
+            void read(int pass, const std::string& name);
+            void write(int pass, const std::string& name, bool create, const RenderTargetPool::Desc* desc);
+            std::vector<int> schedule();
+    };
+
+}
\ No newline at end of file
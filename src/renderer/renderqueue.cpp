@@ -0,0 +1,168 @@
+#include "renderer/renderqueue.hpp"
+
+#include "component/mesh.hpp"
+#include "material/material.hpp"
+#include "renderer/drawdata.hpp"
+#include "renderer/module.hpp"
+#include "scene/scene.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Renderer {
+
+    uint64_t RenderQueue::MakeKey(Pass pass, unsigned int program, unsigned int material, unsigned int vao, float depth) {
+        const uint64_t depthBits = static_cast<uint64_t>(std::clamp(depth, 0.f, 1.f) * 65535.f);
+        return (static_cast<uint64_t>(pass) & 0xF) << 60
+            | (static_cast<uint64_t>(program) & 0xFFF) << 48
+            | (static_cast<uint64_t>(material) & 0xFFFF) << 32
+            | (static_cast<uint64_t>(vao) & 0xFFFF) << 16
+            | depthBits;
+    }
+
+    Material::MaterialBase* RenderQueue::MaterialFor(const Component::Mesh& mesh) {
+        return mesh.material ? mesh.material.get() : Material::defaultMaterial.get();
+    }
+
+    void RenderQueue::Push(const Scene::Scene& scene, const std::vector<unsigned int>& visible, Pass pass, bool by_material, const glm::vec3& eye, float max_depth) {
+        const auto& drawables = scene.Drawables();
+        const auto& bounds = scene.DrawableBounds();
+        const float depthScale = max_depth > 0.f ? 1.f / max_depth : 0.f;
+        packets.reserve(packets.size() + visible.size());
+        for (unsigned int idx : visible) {
+            const Component::Mesh& mesh = *drawables[idx].mesh;
+            if (!mesh.vao)
+                continue;
+            unsigned int program = 0, material = 0;
+            Material::MaterialBase* meshMaterial = by_material ? MaterialFor(mesh) : nullptr;
+            if (meshMaterial) {
+                program = meshMaterial->GetProgram()->Handle();
+                material = meshMaterial->Id();
+            }
+            const glm::vec3 center(bounds.centerX[idx], bounds.centerY[idx], bounds.centerZ[idx]);
+            const float depth = glm::length(center - eye) * depthScale;
+            Push(MakeKey(pass, program, material, mesh.vao->Id(), depth), idx);
+        }
+    }
+
+    void RenderQueue::Sort() {
+        // LSD radix sort, one byte per pass. Stable, so equal keys keep their push order.
+        scratch.resize(packets.size());
+        for (int shift = 0; shift < 64; shift += 8) {
+            size_t counts[256] = {};
+            for (const auto& packet : packets)
+                counts[(packet.key >> shift) & 0xFF]++;
+            // Skip bytes that are the same in every key, which is most of them in a typical frame
+            if (std::find(std::begin(counts), std::end(counts), packets.size()) != std::end(counts))
+                continue;
+            size_t offset = 0;
+            for (auto& count : counts) {
+                const size_t c = count;
+                count = offset;
+                offset += c;
+            }
+            for (const auto& packet : packets)
+                scratch[counts[(packet.key >> shift) & 0xFF]++] = packet;
+            packets.swap(scratch);
+        }
+    }
+
+    void RenderQueue::Submit(const Scene::Scene& scene) {
+        const auto& drawables = scene.Drawables();
+        instanceDrawIds.clear();
+        runs.clear();
+        for (const auto& packet : packets) {
+            const Component::Mesh& mesh = *drawables[packet.drawable].mesh;
+            addInstance(mesh.vao.get(), MaterialFor(mesh), packet.drawable);
+        }
+        drawRuns();
+    }
+
+    void RenderQueue::Submit(const Scene::Scene& scene, RenderModule& module) {
+        const auto& drawables = scene.Drawables();
+        instanceDrawIds.clear();
+        runs.clear();
+        for (const auto& packet : packets) {
+            const Component::Mesh& mesh = *drawables[packet.drawable].mesh;
+            if (module.AllowDraw(mesh))
+                addInstance(mesh.vao.get(), nullptr, packet.drawable);
+        }
+        drawRuns();
+    }
+
+    void RenderQueue::addInstance(Core::Vao* vao, Material::MaterialBase* material, unsigned int drawable) {
+        // Compare the objects themselves rather than key bits, which may be truncated
+        if (runs.empty() || runs.back().vao != vao || runs.back().material != material)
+            runs.push_back({vao, material, static_cast<unsigned int>(instanceDrawIds.size()), 0});
+        runs.back().count++;
+        instanceDrawIds.push_back(drawable);
+    }
+
+    void RenderQueue::drawRuns() {
+        stats = SubmitStats();
+        DrawDataBuffer::RebindCurrent();
+        uploadInstances();
+
+        // ---- Indirect commands, one per run, for the runs in geometry arenas ----
+        const bool multiDraw = Core::GeometryArena::MultiDrawSupported();
+        if (multiDraw) {
+            Core::GeometryArena::ReserveInstances(instanceDrawIds.size());
+            commands.clear();
+            for (const auto& run : runs)
+                commands.push_back(run.vao->Arena() ? run.vao->MakeDrawCommand(run.count, run.first) : Core::GeometryArena::DrawCommand{});
+            if (!indirectBuffer)
+                indirectBuffer = std::make_shared<Core::Dibo>();
+            indirectBuffer->UpdateData(commands.size() * sizeof(Core::GeometryArena::DrawCommand), commands.data());
+        }
+
+        // ---- Draw ----
+        // Each run is one instanced draw. With multi-draw, consecutive arena runs that share a material are one call;
+        // without, they still share a VAO binding.
+        Core::Program* currentProgram = nullptr;
+        Material::MaterialBase* currentMaterial = nullptr;
+        GLuint currentVao = 0;
+        for (size_t first = 0, last; first < runs.size(); first = last) {
+            const Run& run = runs[first];
+            Core::GeometryArena* arena = run.vao->Arena();
+            last = first + 1;
+            if (multiDraw && arena) {
+                while (last < runs.size() && runs[last].vao->Arena() == arena && runs[last].material == run.material)
+                    last++;
+            }
+
+            if (run.material && run.material != currentMaterial) {
+                Core::Program* program = run.material->GetProgram().get();
+                if (program != currentProgram) {
+                    program->Use();
+                    currentProgram = program;
+                    stats.programChanges++;
+                }
+                run.material->Bind();
+                currentMaterial = run.material;
+                stats.materialChanges++;
+            }
+            if (run.vao->Handle() != currentVao) {
+                run.vao->Bind();
+                currentVao = run.vao->Handle();
+                stats.vaoChanges++;
+            }
+            if (multiDraw && arena) {
+                arena->MultiDrawIndirect(first, last - first);
+            } else {
+                DrawDataBuffer::SetFirstInstance(run.first);
+                run.vao->DrawInstancedBound(run.count);
+            }
+            stats.draws++;
+            for (size_t i = first; i < last; i++)
+                stats.instances += runs[i].count;
+        }
+    }
+
+    void RenderQueue::uploadInstances() {
+        if (!instanceTbo)
+            instanceTbo = std::make_shared<Core::Tbo>(GL_R32UI);
+        instanceTbo->UpdateData(instanceDrawIds.size() * sizeof(unsigned int), instanceDrawIds.data());
+        instanceTbo->Bind(DrawDataBuffer::instanceTexUnit);
+    }
+
+}
\ No newline at end of file
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "core/globject.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace Component {
+    class Mesh;
+}
+
+namespace Material {
+    class MaterialBase;
+}
+
+namespace Scene {
+    class Scene;
+}
+
+namespace Renderer {
+
+    class RenderModule;
+
+    // One draw: a sort key plus the index of the scene drawable (mesh and world matrix) it draws
+    struct DrawPacket {
+        uint64_t key;
+        unsigned int drawable;
+    };
+
+    // Collects a pass's draws as packets, sorts them by key, and submits them so that program, material and VAO
+    // changes only happen where the key changes. Adjacent packets that share a VAO (and material, if drawn with one)
+    // are drawn as instances of one call, and with GL 4.3, adjacent calls into one geometry arena as one multi-draw.
+    // Key layout, most significant first: pass (4 bits), program (12), material (16), VAO ID (16), depth (16).
+    class RenderQueue {
+        public:
+            enum class Pass : unsigned int {
+                Geometry,
+                DirectionalShadow,
+                PointShadow,
+            };
+
+            // State changes made by the last Submit()
+            struct SubmitStats {
+                int draws = 0;      // Draw calls
+                int instances = 0;  // Meshes drawn by them
+                int programChanges = 0;
+                int materialChanges = 0;
+                int vaoChanges = 0;
+            };
+
+            // depth is normalized to [0,1]; nearer draws sort first
+            static uint64_t MakeKey(Pass pass, unsigned int program, unsigned int material, unsigned int vao, float depth);
+            // Material a mesh is queued with: its own, or Material::defaultMaterial if it has none, so every run drawn with
+            // materials binds a program
+            static Material::MaterialBase* MaterialFor(const Component::Mesh& mesh);
+
+            void Clear() { packets.clear(); }
+            void Push(uint64_t key, unsigned int drawable) { packets.push_back({key, drawable}); }
+            // Appends a packet for each of scene.Drawables()[visible[i]], with depth measured from eye and normalized by max_depth.
+            // Passes that draw with their own program (by_material = false) are keyed by VAO alone.
+            void Push(const Scene::Scene& scene, const std::vector<unsigned int>& visible, Pass pass, bool by_material, const glm::vec3& eye, float max_depth);
+            void Sort();
+
+            // Both submits upload the packets' drawable indices as the instance list, so the DrawDataBuffer last bound must
+            // hold scene.Drawables() in order. It is rebound first, in case DrawDataBuffer::DrawImmediate() replaced it.
+            // Draws with each mesh's material
+            void Submit(const Scene::Scene& scene);
+            // Draws with a module's program, letting it filter meshes
+            void Submit(const Scene::Scene& scene, RenderModule& module);
+
+            const std::vector<DrawPacket>& Packets() const { return packets; }
+            const SubmitStats& Stats() const { return stats; }
+
+        private:
+            std::vector<DrawPacket> packets;
+            std::vector<DrawPacket> scratch;    // Radix sort ping-pong buffer
+            std::vector<unsigned int> instanceDrawIds;
+            std::shared_ptr<Core::Tbo> instanceTbo;
+            // Consecutive instances of one VAO and material, as a range of the instance list
+            struct Run {
+                Core::Vao* vao;
+                Material::MaterialBase* material;
+                unsigned int first;
+                unsigned int count;
+            };
+            std::vector<Run> runs;
+            std::vector<Core::GeometryArena::DrawCommand> commands;    // Per run
+            std::shared_ptr<Core::Dibo> indirectBuffer;
+
+            void addInstance(Core::Vao* vao, Material::MaterialBase* material, unsigned int drawable);
+            void drawRuns();
+            void uploadInstances();
+            SubmitStats stats;
+    };
+
+}
\ No newline at end of file
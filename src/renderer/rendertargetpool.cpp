@@ -0,0 +1,188 @@
+#include "renderer/rendertargetpool.hpp"
+
+#include "core/glstate.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+
+namespace Renderer {
+
+    namespace {
+        // Pixel transfer format and type for allocating storage of a sized internal format
+        struct FormatInfo {
+            GLenum format;
+            GLenum type;
+            double bytes;
+        };
+
+        FormatInfo formatInfo(GLint internal_format) {
+            switch (internal_format) {
+                case GL_RGBA32F:                return {GL_RGBA, GL_FLOAT, 16};
+                case GL_RGBA16F:                return {GL_RGBA, GL_FLOAT, 8};
+                case GL_RGBA8:                  return {GL_RGBA, GL_UNSIGNED_BYTE, 4};
+                case GL_SRGB8_ALPHA8:           return {GL_RGBA, GL_UNSIGNED_BYTE, 4};
+                case GL_R11F_G11F_B10F:         return {GL_RGB, GL_FLOAT, 4};
+                case GL_RG16:                   return {GL_RG, GL_UNSIGNED_SHORT, 4};
+                case GL_RG16F:                  return {GL_RG, GL_FLOAT, 4};
+                case GL_R16F:                   return {GL_RED, GL_FLOAT, 2};
+                case GL_R8:                     return {GL_RED, GL_UNSIGNED_BYTE, 1};
+                case GL_DEPTH_COMPONENT16:      return {GL_DEPTH_COMPONENT, GL_FLOAT, 2};
+                case GL_DEPTH_COMPONENT24:      return {GL_DEPTH_COMPONENT, GL_FLOAT, 4};
+                case GL_DEPTH_COMPONENT32F:     return {GL_DEPTH_COMPONENT, GL_FLOAT, 4};
+                default:
+                    throw std::runtime_error("Render target pool does not support internal format " + std::to_string(internal_format));
+            }
+        }
+    }
+
+    bool RenderTargetPool::Desc::operator<(const Desc& other) const {
+        return std::tie(width, height, internalformat, samples) < std::tie(other.width, other.height, other.internalformat, other.samples);
+    }
+
+    RenderTargetPool& RenderTargetPool::Instance() {
+        static RenderTargetPool instance;
+        return instance;
+    }
+
+    double RenderTargetPool::BytesPerPixel(GLint internal_format) {
+        return formatInfo(internal_format).bytes;
+    }
+
+    RenderTargetPool::Desc RenderTargetPool::describe(const Core::Tex2D& texture) {
+        Desc desc;
+        desc.width = texture.width;
+        desc.height = texture.height;
+        desc.internalformat = texture.internalformat;
+        return desc;
+    }
+
+    std::shared_ptr<Core::Tex2D> RenderTargetPool::Acquire(int width, int height, GLint internal_format, GLint filter) {
+        Desc desc;
+        desc.width = width;
+        desc.height = height;
+        desc.internalformat = internal_format;
+        desc.filter = filter;
+        return Acquire(desc);
+    }
+
+    std::shared_ptr<Core::Tex2D> RenderTargetPool::Acquire(const Desc& desc) {
+        if (desc.samples != 1)
+            throw std::runtime_error("Render target pool only supports single-sampled targets");
+        const FormatInfo info = formatInfo(desc.internalformat);
+        frame.unpooledBytes += info.bytes * desc.width * desc.height;
+
+        auto [first, last] = entries.equal_range(desc);
+        auto it = pooling ? std::find_if(first, last, [](const auto& pair) { return !pair.second.acquired; }) : last;
+        if (it != last) {
+            frame.reused++;
+        } else {
+            frame.created++;
+            Entry entry;
+            entry.texture = std::make_shared<Core::Tex2D>(GL_TEXTURE_2D, desc.internalformat, desc.width, desc.height, info.format, info.type, GL_CLAMP_TO_EDGE, desc.filter, false, info.type == GL_FLOAT);
+            entry.filter = desc.filter;
+            it = entries.emplace(desc, std::move(entry));
+            liveBytes += info.bytes * desc.width * desc.height;
+            frame.peakTextures = std::max(frame.peakTextures, static_cast<int>(entries.size()));
+            frame.peakBytes = std::max(frame.peakBytes, liveBytes);
+        }
+
+        Entry& entry = it->second;
+        entry.acquired = true;
+        entry.lastUsedFrame = frameIndex;
+        if (entry.filter != desc.filter) {
+            // Tex2D::minfilter only records what the texture was created with
+            entry.texture->Bind();
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, desc.filter);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, desc.filter);
+            entry.filter = desc.filter;
+        }
+        return entry.texture;
+    }
+
+    void RenderTargetPool::Release(const std::shared_ptr<Core::Tex2D>& texture) {
+        if (!texture)
+            return;
+        auto [first, last] = entries.equal_range(describe(*texture));
+        for (auto it = first; it != last; ++it) {
+            if (it->second.texture == texture) {
+                it->second.acquired = false;
+                it->second.lastUsedFrame = frameIndex;
+                return;
+            }
+        }
+    }
+
+    Core::Fbo& RenderTargetPool::Framebuffer(const std::vector<std::shared_ptr<Core::Tex>>& colors, const std::shared_ptr<Core::Tex>& depth) {
+        std::vector<GLuint> key;
+        for (const auto& color : colors)
+            key.push_back(color->Handle());
+        key.push_back(depth ? depth->Handle() : 0);
+
+        FramebufferEntry& entry = framebuffers[key];
+        entry.lastUsedFrame = frameIndex;
+        if (entry.fbo)
+            return *entry.fbo;
+
+        const Core::Tex& first = colors.empty() ? *depth : *colors[0];
+        entry.fbo = std::make_unique<Core::Fbo>(first.width, first.height);
+        entry.fbo->Bind();
+        bool cubeMap = false;
+        for (const auto& color : colors) {
+            entry.fbo->AttachColorTex(color);
+            cubeMap |= color->target == GL_TEXTURE_CUBE_MAP;
+        }
+        if (colors.empty())
+            glDrawBuffer(GL_NONE);
+        if (depth)
+            entry.fbo->AttachDepthTex(depth);
+        // Incomplete until a cube face is attached
+        if (!cubeMap)
+            entry.fbo->CheckStatus();
+        return *entry.fbo;
+    }
+
+    void RenderTargetPool::forgetFramebuffers(GLuint texture) {
+        for (auto it = framebuffers.begin(); it != framebuffers.end();) {
+            if (std::find(it->first.begin(), it->first.end(), texture) != it->first.end())
+                it = framebuffers.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    std::multimap<RenderTargetPool::Desc, RenderTargetPool::Entry>::iterator RenderTargetPool::erase(std::multimap<Desc, Entry>::iterator it) {
+        forgetFramebuffers(it->second.texture->Handle());
+        liveBytes -= BytesPerPixel(it->first.internalformat) * it->first.width * it->first.height;
+        return entries.erase(it);
+    }
+
+    void RenderTargetPool::EndFrame() {
+        // Framebuffers first, since they hold their attachments
+        for (auto it = framebuffers.begin(); it != framebuffers.end();) {
+            if (frameIndex - it->second.lastUsedFrame >= maxIdleFrames)
+                it = framebuffers.erase(it);
+            else
+                ++it;
+        }
+        for (auto it = entries.begin(); it != entries.end();) {
+            if (!it->second.acquired && (!pooling || frameIndex - it->second.lastUsedFrame >= maxIdleFrames)) {
+                it = erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        frame.textures = entries.size();
+        for (const auto& [desc, entry] : entries)
+            frame.bytes += BytesPerPixel(desc.internalformat) * desc.width * desc.height;
+        frame.framebuffers = framebuffers.size();
+        lastFrame = frame;
+        frame = PoolStats();
+        frame.peakTextures = entries.size();
+        frame.peakBytes = liveBytes;
+        frameIndex++;
+    }
+
+}
\ No newline at end of file
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "core/globject.hpp"
+#include "core/tex.hpp"
+
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace Renderer {
+
+    // Transient render targets, shared by every pass of every frame. A pass acquires a texture before it first writes it and
+    // releases it after its last read; from then on, a later pass asking for the same size and format is handed the same
+    // texture, so targets whose lifetimes within a frame do not overlap share memory. GL 4.1 cannot alias memory between
+    // formats, so only matching targets share. Textures nobody has acquired for a few frames are freed, which is all a
+    // window resize costs: the next frame simply asks for the new size.
+    // Framebuffers are cached by their attachments, so passes do not create or re-attach their own.
+    class RenderTargetPool {
+        public:
+            // What a target is keyed on. Filtering is not part of the key: it is set on the texture at each Acquire().
+            struct Desc {
+                int width = 0;
+                int height = 0;
+                GLint internalformat = GL_RGBA8;   // Sized
+                int samples = 1;                    // Only single-sampled targets are supported so far
+                GLint filter = GL_LINEAR;
+
+                bool operator<(const Desc& other) const;
+            };
+            struct PoolStats {
+                int textures = 0;           // Alive at the end of the frame, acquired or not
+                double bytes = 0.0;         // Their estimated size
+                double unpooledBytes = 0.0; // Estimated size had every Acquire() of the frame been a target of its own
+                int created = 0;            // Textures allocated during the frame
+                int reused = 0;             // Acquires served by an existing texture
+                int framebuffers = 0;       // Cached at the end of the frame
+                int peakTextures = 0;       // Most alive at once during the frame
+                double peakBytes = 0.0;     // Most estimated bytes alive at once during the frame
+            };
+
+            static RenderTargetPool& Instance();
+            // Rule of five
+            ~RenderTargetPool() = default;
+            RenderTargetPool(const RenderTargetPool& other) = delete;
+            RenderTargetPool(RenderTargetPool&& other) = delete;
+            RenderTargetPool& operator=(const RenderTargetPool& other) = delete;
+            RenderTargetPool& operator=(RenderTargetPool&& other) = delete;
+
+            // Off, every Acquire() allocates a texture of its own, freed at the end of the frame. For comparison.
+            bool pooling = true;
+
+            // A texture no one else holds. Its contents are undefined: clear or overwrite them.
+            std::shared_ptr<Core::Tex2D> Acquire(const Desc& desc);
+            std::shared_ptr<Core::Tex2D> Acquire(int width, int height, GLint internal_format, GLint filter = GL_LINEAR);
+            // After the last read. The caller may keep the pointer, but not use it once another pass could have acquired it.
+            // Releasing null or an already released texture does nothing.
+            void Release(const std::shared_ptr<Core::Tex2D>& texture);
+            // Framebuffer with exactly these attachments, created on first use and sized to the first of them. It keeps them
+            // alive until it goes unused for a few frames. Cube maps are attached without a face, for the caller to pick.
+            Core::Fbo& Framebuffer(const std::vector<std::shared_ptr<Core::Tex>>& colors, const std::shared_ptr<Core::Tex>& depth = nullptr);
+
+            // Call once per frame: frees what has been idle too long and starts new statistics
+            void EndFrame();
+            const PoolStats& LastFrame() const { return lastFrame; }
+
+            // Estimated VRAM per texel of a sized internal format
+            static double BytesPerPixel(GLint internal_format);
+
+        private:
+            RenderTargetPool() = default;
+
+            static constexpr int maxIdleFrames = 3;
+
+            struct Entry {
+                std::shared_ptr<Core::Tex2D> texture;
+                GLint filter;
+                bool acquired = false;
+                int lastUsedFrame = 0;
+            };
+            struct FramebufferEntry {
+                std::unique_ptr<Core::Fbo> fbo;
+                int lastUsedFrame = 0;
+            };
+
+            std::multimap<Desc, Entry> entries;
+            // By attachment handles, colors in order and depth (or 0) last
+            std::map<std::vector<GLuint>, FramebufferEntry> framebuffers;
+            int frameIndex = 0;
+            double liveBytes = 0.0;
+
+            PoolStats frame;
+            PoolStats lastFrame;
+
+            static Desc describe(const Core::Tex2D& texture);
+            void forgetFramebuffers(GLuint texture);
+            // Frees an entry's texture, and any framebuffer it is attached to
+            std::multimap<Desc, Entry>::iterator erase(std::multimap<Desc, Entry>::iterator it);
+    };
+
+}
\ No newline at end of file
@@ -0,0 +1,231 @@
+#include "renderer/shadowatlas.hpp"
+
+#include "component/light.hpp"
+#include "core/glstate.hpp"
+#include "scene/scenenode.hpp"
+#include "util/bounds.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace Renderer {
+
+    namespace {
+        // Directional lights reach the whole screen, so they outrank any point light (whose importance is at most 1)
+        constexpr float directionalImportance = 2.f;
+
+        bool isPowerOfTwo(int n) {
+            return n > 0 && (n & (n - 1)) == 0;
+        }
+    }
+
+    bool ShadowAtlas::Slot::StaticStale(const glm::mat4& lightspace, unsigned int static_version) const {
+        return cachedTile != tile || cachedLightspace != lightspace || cachedStaticVersion != static_version;
+    }
+
+    void ShadowAtlas::Slot::CacheStatic(const glm::mat4& lightspace, unsigned int static_version) {
+        cachedTile = tile;
+        cachedLightspace = lightspace;
+        cachedStaticVersion = static_version;
+    }
+
+    ShadowAtlas::ShadowAtlas(int size, int max_tile_size, int min_tile_size)
+        : size(size),
+        maxTileSize(max_tile_size),
+        minTileSize(min_tile_size),
+        depthMap(std::make_shared<Core::Tex2D>(GL_TEXTURE_2D, GL_DEPTH_COMPONENT24, size, size, GL_DEPTH_COMPONENT, GL_FLOAT, GL_CLAMP_TO_EDGE, GL_LINEAR, true)),
+        fbo(size, size),
+        staticFbo(size, size),
+        staticDepthMap(std::make_shared<Core::Tex2D>(GL_TEXTURE_2D, GL_DEPTH_COMPONENT24, size, size, GL_DEPTH_COMPONENT, GL_FLOAT, GL_CLAMP_TO_EDGE, GL_LINEAR, true))
+    {
+        if (!isPowerOfTwo(size) || !isPowerOfTwo(max_tile_size) || !isPowerOfTwo(min_tile_size) || min_tile_size > max_tile_size || max_tile_size > size) {
+            throw std::runtime_error("Shadow atlas and tile sizes must be powers of two, with min_tile_size <= max_tile_size <= size!");
+        }
+        for (int s = size; s >= min_tile_size; s /= 2)
+            freeNodes.emplace_back();
+
+        fbo.Bind();
+        fbo.AttachDepthTex(depthMap);
+        glDrawBuffer(GL_NONE);  // No colorbuffer
+        glReadBuffer(GL_NONE);  // No colorbuffer
+        fbo.CheckStatus();
+        staticFbo.Bind();
+        staticFbo.AttachDepthTex(staticDepthMap);
+        glDrawBuffer(GL_NONE);  // No colorbuffer
+        glReadBuffer(GL_NONE);  // No colorbuffer
+        staticFbo.CheckStatus();
+    }
+
+    void ShadowAtlas::Allocate(const Scene::LightRegistry& lights, const glm::mat4& view, const glm::mat4& projection, int max_directional_lights) {
+        requests.clear();
+        stats = AtlasStats();
+
+        // ---- Requests ----
+        // A tile per cascade, at full size
+        const auto& dirlights = lights.DirectionalLights();
+        for (int i = 0; i < static_cast<int>(dirlights.size()) && i < max_directional_lights; i++) {
+            const Component::DirectionalLight& dirlight = *dirlights[i].light;
+            if (dirlight.HasShadows())
+                requests.push_back({&dirlight, dirlight.CascadeCount(), maxTileSize, maxTileSize, directionalImportance});
+        }
+        // A tile per cube face, sized by how much of the screen the light's sphere of influence covers. That shrinks with
+        // distance, and is zero for a light whose sphere is out of view, since nothing it lights can be seen.
+        const Bounds::Frustum frustum(projection * view);
+        for (const auto& entry : lights.PointLights()) {
+            const Component::PointLight& pointlight = *entry.light;
+            if (!pointlight.HasShadows())
+                continue;
+            const glm::vec3 position = entry.node->WorldMatrix()[3];
+            const float radius = std::min(pointlight.FarPlane(), pointlight.Radius());
+            if (!frustum.Intersects(Bounds::Aabb{position - radius, position + radius}))
+                continue;
+            // Projected radius in NDC: the tangent of the sphere's angular radius, scaled by the projection
+            const float distance = glm::length(glm::vec3(view * glm::vec4(position, 1)));
+            float coverage = 1.f;
+            if (distance > radius)
+                coverage = std::min(1.f, radius * projection[1][1] / std::sqrt(distance * distance - radius * radius));
+            const int tileSize = pointTileSize(coverage);
+            requests.push_back({&pointlight, 6, tileSize, tileSize, coverage});
+        }
+        stats.lights = requests.size();
+        fitRequests();
+
+        // ---- Pack ----
+        // Largest tiles first, which a quadtree always fits if their total area does. Ties keep request order, so the same
+        // lights get the same tiles from frame to frame and their caches stay valid.
+        std::stable_sort(requests.begin(), requests.end(), [](const Request& a, const Request& b) { return a.tileSize > b.tileSize; });
+        for (auto& level : freeNodes)
+            level.clear();
+        freeNodes[0].emplace_back(0, 0);
+
+        // Slots carry over, so each tile is compared against what was last rendered into it
+        std::unordered_map<const Component::Light*, std::vector<Slot>> previous;
+        previous.swap(slots);
+        long long allocated = 0;
+        for (const Request& request : requests) {
+            std::vector<Slot> lightSlots;
+            auto it = previous.find(request.light);
+            if (it != previous.end())
+                lightSlots = std::move(it->second);
+            lightSlots.resize(request.tileCount);
+
+            bool fits = true;
+            for (Slot& slot : lightSlots)
+                fits = fits && allocateTile(request.tileSize, slot.tile);
+            if (!fits) {
+                stats.dropped++;
+                continue;
+            }
+            if (request.tileSize < request.requestedSize)
+                stats.downsized++;
+            allocated += static_cast<long long>(request.tileCount) * request.tileSize * request.tileSize;
+            slots[request.light] = std::move(lightSlots);
+        }
+        stats.occupancy = static_cast<float>(allocated) / (static_cast<float>(size) * size);
+    }
+
+    std::vector<ShadowAtlas::Slot>* ShadowAtlas::Slots(const Component::Light* light) {
+        auto it = slots.find(light);
+        return it == slots.end() ? nullptr : &it->second;
+    }
+
+    glm::vec3 ShadowAtlas::Rect(const Tile& tile) const {
+        return glm::vec3(tile.x, tile.y, tile.size) / static_cast<float>(size);
+    }
+
+    void ShadowAtlas::BeginStatic(const Tile& tile) {
+        Core::GlState::Instance().BindFramebuffer(GL_FRAMEBUFFER, staticFbo.Handle());
+        setViewport(tile);
+        // Clears ignore the viewport; only the scissor box keeps them to the tile
+        Core::GlState::Instance().SetEnabled(GL_SCISSOR_TEST, true);
+        Core::GlState::Instance().Scissor(tile.x, tile.y, tile.size, tile.size);
+        staticFbo.ClearDepth();
+        Core::GlState::Instance().SetEnabled(GL_SCISSOR_TEST, false);
+    }
+
+    void ShadowAtlas::BeginDynamic(const Tile& tile) {
+        Core::GlState::Instance().BindFramebuffer(GL_READ_FRAMEBUFFER, staticFbo.Handle());
+        Core::GlState::Instance().BindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo.Handle());
+        glBlitFramebuffer(tile.x, tile.y, tile.x + tile.size, tile.y + tile.size, tile.x, tile.y, tile.x + tile.size, tile.y + tile.size, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        Core::GlState::Instance().BindFramebuffer(GL_FRAMEBUFFER, fbo.Handle());
+        setViewport(tile);
+    }
+
+    void ShadowAtlas::SetViewports(const std::vector<Slot>& slots) {
+        // Setting index 0 sets every index, so the rest follow it
+        setViewport(slots[0].tile);
+        for (size_t i = 1; i < slots.size(); i++) {
+            const Tile& tile = slots[i].tile;
+            Core::GlState::Instance().ViewportIndexed(i, tile.x, tile.y, tile.size, tile.size);
+        }
+    }
+
+    int ShadowAtlas::pointTileSize(float coverage) const {
+        int tileSize = minTileSize;
+        while (tileSize < maxTileSize && tileSize < coverage * maxTileSize)
+            tileSize *= 2;
+        return tileSize;
+    }
+
+    void ShadowAtlas::fitRequests() {
+        auto area = [](const Request& request) {
+            return static_cast<long long>(request.tileCount) * request.tileSize * request.tileSize;
+        };
+        long long total = 0;
+        for (const Request& request : requests)
+            total += area(request);
+        const long long capacity = static_cast<long long>(size) * size;
+
+        while (total > capacity) {
+            // Halve the tiles that have the most texels per unit of importance
+            Request* shrink = nullptr;
+            for (Request& request : requests) {
+                if (request.tileSize > minTileSize && (!shrink || request.tileSize / request.importance > shrink->tileSize / shrink->importance))
+                    shrink = &request;
+            }
+            if (shrink) {
+                total -= area(*shrink) - area(*shrink) / 4;
+                shrink->tileSize /= 2;
+                continue;
+            }
+            // Everything is as small as it goes: drop the least important light
+            auto least = std::min_element(requests.begin(), requests.end(), [](const Request& a, const Request& b) { return a.importance < b.importance; });
+            total -= area(*least);
+            requests.erase(least);
+            stats.dropped++;
+        }
+    }
+
+    bool ShadowAtlas::allocateTile(int tile_size, Tile& tile) {
+        int level = 0;
+        for (int s = size; s > tile_size; s /= 2)
+            level++;
+
+        // Split the nearest free node above down to this level
+        int from = level;
+        while (from >= 0 && freeNodes[from].empty())
+            from--;
+        if (from < 0)
+            return false;
+        for (; from < level; from++) {
+            const glm::ivec2 node = freeNodes[from].back();
+            freeNodes[from].pop_back();
+            const int half = (size >> from) / 2;
+            // Pushed in reverse, so the lowest corner is taken first
+            freeNodes[from + 1].push_back(node + glm::ivec2(half, half));
+            freeNodes[from + 1].push_back(node + glm::ivec2(0, half));
+            freeNodes[from + 1].push_back(node + glm::ivec2(half, 0));
+            freeNodes[from + 1].push_back(node);
+        }
+        const glm::ivec2 node = freeNodes[level].back();
+        freeNodes[level].pop_back();
+        tile = {node.x, node.y, tile_size};
+        return true;
+    }
+
+    void ShadowAtlas::setViewport(const Tile& tile) {
+        Core::GlState::Instance().Viewport(tile.x, tile.y, tile.size, tile.size);
+    }
+
+}
\ No newline at end of file
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "core/globject.hpp"
+#include "core/tex.hpp"
+#include "scene/lightregistry.hpp"
+
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace Component {
+    class Light;
+}
+
+namespace Renderer {
+
+    // One depth texture that every shadow map is a square tile of, directional light cascades and point light cube faces alike.
+    // Each frame, Allocate() sizes every shadowed light's tiles by how much of the screen the light can reach and packs them
+    // with a quadtree. When they do not all fit, tiles are halved where they buy the least, and only then are the least
+    // important lights dropped, so memory stays fixed however many lights cast shadows.
+    class ShadowAtlas {
+        public:
+            // In texels, with a power-of-two size
+            struct Tile {
+                int x = 0;
+                int y = 0;
+                int size = 0;
+
+                bool operator==(const Tile& other) const { return x == other.x && y == other.y && size == other.size; }
+                bool operator!=(const Tile& other) const { return !(*this == other); }
+            };
+            // A tile and what it was last rendered with. Static casters are kept in a separate copy of the atlas, re-rendered
+            // only when this changes; dynamic casters are drawn over a fresh copy of it each frame.
+            struct Slot {
+                Tile tile;
+                Tile cachedTile;
+                glm::mat4 cachedLightspace = glm::mat4(0);
+                unsigned int cachedStaticVersion = ~0u;
+                bool hadDynamic = true;     // Holds dynamic casters, which have to be erased even if none are drawn now
+
+                bool StaticStale(const glm::mat4& lightspace, unsigned int static_version) const;
+                void CacheStatic(const glm::mat4& lightspace, unsigned int static_version);
+            };
+            struct AtlasStats {
+                int lights = 0;         // Shadowed lights that could be seen, and so asked for tiles
+                int downsized = 0;      // Given smaller tiles than they asked for, for lack of room
+                int dropped = 0;        // Given none
+                float occupancy = 0.f;  // Fraction of the atlas allocated
+            };
+
+            ShadowAtlas(int size = 4096, int max_tile_size = 1024, int min_tile_size = 64);
+            // Rule of five
+            ~ShadowAtlas() = default;
+            ShadowAtlas(const ShadowAtlas& other) = delete;
+            ShadowAtlas(ShadowAtlas&& other) = delete;
+            ShadowAtlas& operator=(const ShadowAtlas& other) = delete;
+            ShadowAtlas& operator=(ShadowAtlas&& other) = delete;
+
+            const int size, maxTileSize, minTileSize;
+            const std::shared_ptr<Core::Tex2D> depthMap;
+
+            // Plans this frame's tiles. Point lights must have been drawn, for their positions. Only the first
+            // max_directional_lights directional lights are given tiles.
+            void Allocate(const Scene::LightRegistry& lights, const glm::mat4& view, const glm::mat4& projection, int max_directional_lights);
+            // One slot per cascade or cube face, or nullptr if the light has no tiles this frame
+            std::vector<Slot>* Slots(const Component::Light* light);
+            // Offset and scale of a tile in texture coordinates
+            glm::vec3 Rect(const Tile& tile) const;
+            const AtlasStats& Stats() const { return stats; }
+
+            // ---- Drawing into tiles ----
+            // Binds the static copy of the atlas, restricted to the tile, and clears the tile
+            void BeginStatic(const Tile& tile);
+            // Copies the tile from the static copy into the atlas, then binds the atlas, restricted to the tile
+            void BeginDynamic(const Tile& tile);
+            // One viewport per slot, for a geometry shader to pick with gl_ViewportIndex. Call after the Begin*() of every slot.
+            static void SetViewports(const std::vector<Slot>& slots);
+
+        private:
+            // A light's wish for tiles, shrunk by Allocate() until every wish fits
+            struct Request {
+                const Component::Light* light;
+                int tileCount;
+                int tileSize;
+                int requestedSize;
+                float importance;
+            };
+
+            Core::Fbo fbo;
+            Core::Fbo staticFbo;
+            const std::shared_ptr<Core::Tex2D> staticDepthMap;     // Static casters only, layout as depthMap
+            std::unordered_map<const Component::Light*, std::vector<Slot>> slots;
+            std::vector<Request> requests;
+            // Quadtree free nodes per level; level 0 is the whole atlas, each level below a quarter of the one above
+            std::vector<std::vector<glm::ivec2>> freeNodes;
+            AtlasStats stats;
+
+            // Tile size wanted by a point light whose sphere of influence covers the given fraction of the screen height
+            int pointTileSize(float coverage) const;
+            void fitRequests();
+            bool allocateTile(int tile_size, Tile& tile);
+            static void setViewport(const Tile& tile);
+    };
+
+}
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 
 #include "environment.hpp"
+#include "lightregistry.hpp"
 #include "scene.hpp"
 #include "scenenode.hpp"
\ No newline at end of file
@@ -0,0 +1,264 @@
+#include "scene/bvh.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace Scene {
+
+    namespace {
+        constexpr int numBins = 12;
+        constexpr int maxLeafSize = 4;
+        constexpr float traversalCost = 1.f;    // Relative to one primitive test
+        constexpr float refitDegradation = 2.f; // Rebuild once the root has grown this much since the last build
+        constexpr int maxSahDepth = 32;         // Below this, split at the median so the depth (and traversal stack) stays bounded
+        constexpr int stackSize = 96;
+    }
+
+    void Bvh::Build(const Bounds::AabbArray& boxes) {
+        const int n = boxes.Size();
+        nodes.clear();
+        primitiveIndices.clear();
+        primitiveBounds.resize(n);
+        centroids.resize(n);
+        for (int i = 0; i < n; i++) {
+            primitiveBounds[i] = boxes.At(i);
+            centroids[i] = primitiveBounds[i].Center();
+            // Empty boxes can never be hit, so they stay out of the tree
+            if (primitiveBounds[i].IsValid())
+                primitiveIndices.push_back(i);
+        }
+        if (!primitiveIndices.empty()) {
+            nodes.reserve(2 * primitiveIndices.size() / maxLeafSize + 1);
+            buildRecursive(0, primitiveIndices.size(), 0);
+        }
+        builtRootArea = nodes.empty() ? 0.f : nodes[0].bounds.SurfaceArea();
+        centroids.clear();
+        gatherLeafBoxes();
+    }
+
+    void Bvh::gatherLeafBoxes() {
+        leafBoxes.Clear();
+        leafBoxes.Reserve(primitiveIndices.size());
+        for (unsigned int p : primitiveIndices)
+            leafBoxes.PushBack(primitiveBounds[p]);
+    }
+
+    void Bvh::buildRecursive(int first, int count, int depth) {
+        const int index = nodes.size();
+        nodes.push_back(Node{Bounds::Aabb(), first, count});
+
+        Bounds::Aabb bounds, centroidBounds;
+        for (int i = first; i < first + count; i++) {
+            bounds.Expand(primitiveBounds[primitiveIndices[i]]);
+            centroidBounds.Expand(centroids[primitiveIndices[i]]);
+        }
+        nodes[index].bounds = bounds;
+        if (count <= maxLeafSize)
+            return;
+
+        // Binned SAH: bin centroids along each axis, then evaluate every split plane between bins
+        int bestAxis = -1, bestSplit = 0;
+        float bestCost = count; // Cost of leaving this node as a leaf
+        const float parentArea = std::max(bounds.SurfaceArea(), std::numeric_limits<float>::min());
+        for (int axis = 0; axis < 3 && depth < maxSahDepth; axis++) {
+            const float lo = centroidBounds.min[axis];
+            const float extent = centroidBounds.max[axis] - lo;
+            if (extent <= 0.f)
+                continue;
+            const float scale = numBins / extent;
+
+            Bounds::Aabb binBounds[numBins];
+            int binCounts[numBins] = {};
+            for (int i = first; i < first + count; i++) {
+                const unsigned int p = primitiveIndices[i];
+                const int bin = std::min(int((centroids[p][axis] - lo) * scale), numBins - 1);
+                binBounds[bin].Expand(primitiveBounds[p]);
+                binCounts[bin]++;
+            }
+
+            // Sweep from the right to accumulate right-side areas, then from the left to evaluate
+            float rightAreas[numBins];
+            int rightCounts[numBins];
+            Bounds::Aabb accumulated;
+            int accumulatedCount = 0;
+            for (int b = numBins - 1; b > 0; b--) {
+                accumulated.Expand(binBounds[b]);
+                accumulatedCount += binCounts[b];
+                rightAreas[b] = accumulated.SurfaceArea();
+                rightCounts[b] = accumulatedCount;
+            }
+            accumulated = Bounds::Aabb();
+            accumulatedCount = 0;
+            for (int b = 1; b < numBins; b++) {
+                accumulated.Expand(binBounds[b - 1]);
+                accumulatedCount += binCounts[b - 1];
+                if (accumulatedCount == 0 || rightCounts[b] == 0)
+                    continue;
+                const float cost = traversalCost + (accumulated.SurfaceArea() * accumulatedCount + rightAreas[b] * rightCounts[b]) / parentArea;
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = b;
+                }
+            }
+        }
+
+        int leftCount;
+        if (bestAxis >= 0) {
+            const float lo = centroidBounds.min[bestAxis];
+            const float scale = numBins / (centroidBounds.max[bestAxis] - lo);
+            auto middle = std::partition(primitiveIndices.begin() + first, primitiveIndices.begin() + first + count,
+                [&](unsigned int p) {
+                    return std::min(int((centroids[p][bestAxis] - lo) * scale), numBins - 1) < bestSplit;
+                });
+            leftCount = middle - (primitiveIndices.begin() + first);
+        } else {
+            // SAH prefers a leaf (or was skipped). Accept it, unless the leaf would be large (e.g. many coincident centroids); then split at the median.
+            if (count <= 4 * maxLeafSize && depth < maxSahDepth)
+                return;
+            const glm::vec3 extent = centroidBounds.max - centroidBounds.min;
+            const int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+            leftCount = count / 2;
+            std::nth_element(primitiveIndices.begin() + first, primitiveIndices.begin() + first + leftCount, primitiveIndices.begin() + first + count,
+                [&](unsigned int a, unsigned int b) { return centroids[a][axis] < centroids[b][axis]; });
+        }
+
+        buildRecursive(first, leftCount, depth + 1);
+        nodes[index].right = nodes.size();
+        buildRecursive(first + leftCount, count - leftCount, depth + 1);
+    }
+
+    void Bvh::Refit(const Bounds::AabbArray& boxes) {
+        if (boxes.Size() != primitiveBounds.size()) {
+            Build(boxes);
+            return;
+        }
+        for (size_t i = 0; i < primitiveBounds.size(); i++) {
+            const Bounds::Aabb box = boxes.At(i);
+            if (box.IsValid() != primitiveBounds[i].IsValid()) {
+                Build(boxes);
+                return;
+            }
+            primitiveBounds[i] = box;
+        }
+        // Children follow their parents, so a reverse sweep visits every child before its parent
+        for (int i = nodes.size() - 1; i >= 0; i--) {
+            Node& node = nodes[i];
+            node.bounds = Bounds::Aabb();
+            if (node.IsLeaf()) {
+                for (int j = node.first; j < node.first + node.count; j++)
+                    node.bounds.Expand(primitiveBounds[primitiveIndices[j]]);
+            } else {
+                node.bounds.Expand(nodes[i + 1].bounds);
+                node.bounds.Expand(nodes[node.right].bounds);
+            }
+        }
+        if (!nodes.empty() && nodes[0].bounds.SurfaceArea() > refitDegradation * builtRootArea)
+            Build(boxes);
+        else
+            gatherLeafBoxes();
+    }
+
+    void Bvh::appendSubtree(const Node& node, std::vector<unsigned int>& result) const {
+        result.insert(result.end(), primitiveIndices.begin() + node.first, primitiveIndices.begin() + node.first + node.count);
+    }
+
+    void Bvh::remapLeafHits(std::vector<unsigned int>& result, size_t begin) const {
+        for (size_t i = begin; i < result.size(); i++)
+            result[i] = primitiveIndices[result[i]];
+    }
+
+    void Bvh::Query(const Bounds::Frustum& frustum, std::vector<unsigned int>& result) const {
+        if (nodes.empty())
+            return;
+        int stack[stackSize];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            const Node& node = nodes[stack[--top]];
+            if (!frustum.Intersects(node.bounds))
+                continue;
+            if (frustum.Contains(node.bounds)) {
+                appendSubtree(node, result);
+            } else if (node.IsLeaf()) {
+                const size_t begin = result.size();
+                frustum.Cull(leafBoxes, node.first, node.count, result);
+                remapLeafHits(result, begin);
+            } else {
+                stack[top++] = node.right;
+                stack[top++] = &node - nodes.data() + 1;
+            }
+        }
+    }
+
+    void Bvh::Query(const Bounds::Sphere& sphere, std::vector<unsigned int>& result) const {
+        if (nodes.empty())
+            return;
+        const float radius2 = sphere.radius * sphere.radius;
+        int stack[stackSize];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            const Node& node = nodes[stack[--top]];
+            if (!node.bounds.IsValid() || !sphere.Intersects(node.bounds))
+                continue;
+            // Whole subtree is inside if the farthest corner is
+            const glm::vec3 farthest = glm::max(glm::abs(sphere.center - node.bounds.min), glm::abs(sphere.center - node.bounds.max));
+            if (glm::dot(farthest, farthest) <= radius2) {
+                appendSubtree(node, result);
+            } else if (node.IsLeaf()) {
+                const size_t begin = result.size();
+                Bounds::Cull(sphere, leafBoxes, node.first, node.count, result);
+                remapLeafHits(result, begin);
+            } else {
+                stack[top++] = node.right;
+                stack[top++] = &node - nodes.data() + 1;
+            }
+        }
+    }
+
+    int Bvh::Raycast(const glm::vec3& origin, const glm::vec3& direction, float* t) const {
+        if (nodes.empty())
+            return -1;
+        const glm::vec3 inverseDirection = 1.f / direction;
+        float nearest = std::numeric_limits<float>::max();
+        int hit = -1;
+        int stack[stackSize];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            const Node& node = nodes[stack[--top]];
+            float entry;
+            if (!node.bounds.IsValid() || !node.bounds.IntersectsRay(origin, inverseDirection, nearest, entry))
+                continue;
+            if (node.IsLeaf()) {
+                for (int i = node.first; i < node.first + node.count; i++) {
+                    const Bounds::Aabb& box = primitiveBounds[primitiveIndices[i]];
+                    if (box.IsValid() && box.IntersectsRay(origin, inverseDirection, nearest, entry) && entry < nearest) {
+                        nearest = entry;
+                        hit = primitiveIndices[i];
+                    }
+                }
+                continue;
+            }
+            // Visit the nearer child first so the farther one is more likely to be pruned
+            const int left = &node - nodes.data() + 1;
+            float leftEntry = std::numeric_limits<float>::max(), rightEntry = std::numeric_limits<float>::max();
+            const bool leftHit = nodes[left].bounds.IsValid() && nodes[left].bounds.IntersectsRay(origin, inverseDirection, nearest, leftEntry);
+            const bool rightHit = nodes[node.right].bounds.IsValid() && nodes[node.right].bounds.IntersectsRay(origin, inverseDirection, nearest, rightEntry);
+            if (leftHit && rightHit) {
+                stack[top++] = leftEntry < rightEntry ? node.right : left;
+                stack[top++] = leftEntry < rightEntry ? left : node.right;
+            } else if (leftHit) {
+                stack[top++] = left;
+            } else if (rightHit) {
+                stack[top++] = node.right;
+            }
+        }
+        if (hit >= 0 && t)
+            *t = nearest;
+        return hit;
+    }
+
+}
\ No newline at end of file
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "util/bounds.hpp"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace Scene {
+
+    // Bounding volume hierarchy over a set of boxes (primitives), built top-down with the surface area heuristic.
+    // Queries return primitive indices, i.e. positions in the AabbArray the hierarchy was built from.
+    class Bvh {
+        public:
+            // Rebuilds the hierarchy from scratch
+            void Build(const Bounds::AabbArray& boxes);
+            // Updates node bounds bottom-up after primitives moved, keeping the topology. Rebuilds instead if the
+            // refitted tree has degraded too far from the one originally built.
+            void Refit(const Bounds::AabbArray& boxes);
+
+            size_t PrimitiveCount() const { return primitiveBounds.size(); }
+            size_t NodeCount() const { return nodes.size(); }
+
+            // Append the index of every primitive overlapping the query volume
+            void Query(const Bounds::Frustum& frustum, std::vector<unsigned int>& result) const;
+            void Query(const Bounds::Sphere& sphere, std::vector<unsigned int>& result) const;
+            // Index of the nearest primitive whose box the ray hits, or -1. Writes the hit distance (in units of direction) to t.
+            int Raycast(const glm::vec3& origin, const glm::vec3& direction, float* t = nullptr) const;
+
+        private:
+            struct Node {
+                Bounds::Aabb bounds;
+                int first;      // Range of primitiveIndices covered by this subtree
+                int count;
+                int right = 0;  // Index of the right child, or 0 for a leaf. The left child is always the next node.
+
+                bool IsLeaf() const { return right == 0; }
+            };
+            std::vector<Node> nodes;                    // Depth-first order, so children always follow their parent
+            std::vector<unsigned int> primitiveIndices; // Primitives reordered so every subtree covers a contiguous range
+            std::vector<Bounds::Aabb> primitiveBounds;
+            Bounds::AabbArray leafBoxes;                // primitiveBounds in primitiveIndices order, for batched leaf tests
+            std::vector<glm::vec3> centroids;           // Scratch, build only
+            float builtRootArea = 0.f;
+
+            void buildRecursive(int first, int count, int depth);
+            void gatherLeafBoxes();
+            void appendSubtree(const Node& node, std::vector<unsigned int>& result) const;
+            // Maps positions in primitiveIndices, appended to result from index begin on, to primitive indices
+            void remapLeafHits(std::vector<unsigned int>& result, size_t begin) const;
+    };
+
+}
\ No newline at end of file
@@ -3,7 +3,9 @@
 #include "asset/manager.hpp"
 #include "component/primitive.hpp"
 #include "core/globject.hpp"
+#include "core/glstate.hpp"
 #include "interface/widget.hpp"
+#include "renderer/rendertargetpool.hpp"
 
 #include <glm/glm.hpp>
 
@@ -161,13 +163,9 @@ namespace Scene {
 
     std::shared_ptr<Core::Tex2D> Environment::equirectToCubemap(std::shared_ptr<Core::Tex2D> equirect, int width, int height) {
         
-        Core::Fbo fbo(width, height);
-        auto cubemap = std::make_shared<Core::Tex2D>(GL_TEXTURE_CUBE_MAP, GL_RGB32F, fbo.width, fbo.height, GL_RGB, GL_FLOAT, GL_CLAMP_TO_EDGE, GL_LINEAR_MIPMAP_LINEAR, false, equirect->isHdr);
-
-        fbo.Bind();
-        fbo.AttachColorTex(cubemap);
-        fbo.AttachDepthRbo24();
-        fbo.CheckStatus();
+        // Every face is covered once from inside the cube, so no depth buffer is needed
+        auto cubemap = std::make_shared<Core::Tex2D>(GL_TEXTURE_CUBE_MAP, GL_RGB32F, width, height, GL_RGB, GL_FLOAT, GL_CLAMP_TO_EDGE, GL_LINEAR_MIPMAP_LINEAR, false, equirect->isHdr);
+        Core::Fbo& fbo = Renderer::RenderTargetPool::Instance().Framebuffer({cubemap});
 
         const glm::mat4 projection = glm::perspective(glm::half_pi<float>(), 1.0f, 0.1f, 10.0f);
         const glm::mat4 views[] = {
@@ -190,11 +188,10 @@ namespace Scene {
         for (int i = 0; i < 6; i++) {
             fbo.AttachColorTexCubeFace(0, i);
             fbo.ClearColor();
-            fbo.ClearDepth();
             equirectProgram->SetMat4("view", views[i]);
-            glCullFace(GL_FRONT);
+            Core::GlState::Instance().CullFace(GL_FRONT);
             cube.vao->Draw();
-            glCullFace(GL_BACK);
+            Core::GlState::Instance().CullFace(GL_BACK);
         }
 
         cubemap->Bind();
@@ -205,13 +202,8 @@ namespace Scene {
 
     void Environment::cubemapToIrradiance(int width, int height) {
        
-        Core::Fbo fbo(width, height);
-        irradiance = std::make_shared<Core::Tex2D>(GL_TEXTURE_CUBE_MAP, GL_RGB32F, fbo.width, fbo.height, GL_RGB, GL_FLOAT, GL_CLAMP_TO_EDGE, GL_LINEAR, false, true);
-
-        fbo.Bind();
-        fbo.AttachColorTex(irradiance);
-        fbo.AttachDepthRbo24();
-        fbo.CheckStatus();
+        irradiance = std::make_shared<Core::Tex2D>(GL_TEXTURE_CUBE_MAP, GL_RGB32F, width, height, GL_RGB, GL_FLOAT, GL_CLAMP_TO_EDGE, GL_LINEAR, false, true);
+        Core::Fbo& fbo = Renderer::RenderTargetPool::Instance().Framebuffer({irradiance});
     
         const glm::mat4 projection = glm::perspective(glm::half_pi<float>(), 1.0f, 0.1f, 10.0f);
         const glm::mat4 views[] = {
@@ -235,25 +227,19 @@ namespace Scene {
         for (int i = 0; i < 6; i++) {
             fbo.AttachColorTexCubeFace(0, i);
             fbo.ClearColor();
-            fbo.ClearDepth();
             irradianceProgram->SetMat4("view", views[i]);
-            glCullFace(GL_FRONT);
+            Core::GlState::Instance().CullFace(GL_FRONT);
             cube.vao->Draw();
-            glCullFace(GL_BACK);
+            Core::GlState::Instance().CullFace(GL_BACK);
         }
     }
 
     void Environment::cubemapToPrefilter(int width, int height, int envres) {
 
-        Core::Fbo fbo(width, height);
-        prefilter = std::make_shared<Core::Tex2D>(GL_TEXTURE_CUBE_MAP, GL_RGB32F, fbo.width, fbo.height, GL_RGB, GL_FLOAT, GL_CLAMP_TO_EDGE, GL_LINEAR_MIPMAP_LINEAR, false, true);
+        prefilter = std::make_shared<Core::Tex2D>(GL_TEXTURE_CUBE_MAP, GL_RGB32F, width, height, GL_RGB, GL_FLOAT, GL_CLAMP_TO_EDGE, GL_LINEAR_MIPMAP_LINEAR, false, true);
         prefilter->Bind();
         prefilter->GenerateMipMap();    // Allocate memory for the upcoming mipmap levels to be rendered to
-        
-        fbo.Bind();
-        fbo.AttachColorTex(prefilter);
-        fbo.AttachDepthRbo24();
-        fbo.CheckStatus();
+        Core::Fbo& fbo = Renderer::RenderTargetPool::Instance().Framebuffer({prefilter});
         
         const glm::mat4 projection = glm::perspective(glm::half_pi<float>(), 1.0f, 0.1f, 10.0f);
         const glm::mat4 views[] = {
@@ -280,21 +266,17 @@ namespace Scene {
             int mipWidth = static_cast<int>(fbo.width * std::pow(0.5, mip));
             int mipHeight = static_cast<int>(fbo.height * std::pow(0.5, mip));
             
-            fbo.depthRboAtt->Bind();
-            glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, mipWidth, mipHeight);
-            glViewport(0, 0, mipWidth, mipHeight);
+            Core::GlState::Instance().Viewport(0, 0, mipWidth, mipHeight);
             float roughness = static_cast<float>(mip) / static_cast<float>(maxMipLevels - 1);
             prefilterProgram->SetFloat("roughness", roughness);
             
-            fbo.CheckStatus();
             for (int i = 0; i < 6; i++) {
-                fbo.AttachColorTexCubeFace(0, i, mip);  // Can't call Bind() because it clears the depth rbo?
+                fbo.AttachColorTexCubeFace(0, i, mip);
                 fbo.ClearColor();
-                fbo.ClearDepth();
                 prefilterProgram->SetMat4("view", views[i]);
-                glCullFace(GL_FRONT);
+                Core::GlState::Instance().CullFace(GL_FRONT);
                 cube.vao->Draw();
-                glCullFace(GL_BACK);
+                Core::GlState::Instance().CullFace(GL_BACK);
             }
         }
 
@@ -303,18 +285,11 @@ namespace Scene {
 
     void Environment::generateBrdfLut(int width, int height) {
 
-        Core::Fbo fbo(width, height);
-        brdfLut = std::make_shared<Core::Tex2D>(GL_TEXTURE_2D, GL_RG16F, fbo.width, fbo.height, GL_RG, GL_FLOAT, GL_CLAMP_TO_EDGE, GL_LINEAR, false, true);
-        
+        brdfLut = std::make_shared<Core::Tex2D>(GL_TEXTURE_2D, GL_RG16F, width, height, GL_RG, GL_FLOAT, GL_CLAMP_TO_EDGE, GL_LINEAR, false, true);
+        Core::Fbo& fbo = Renderer::RenderTargetPool::Instance().Framebuffer({brdfLut});
         fbo.Bind();
-        fbo.AttachColorTex(brdfLut);
-        fbo.AttachDepthRbo24();
-        
-        fbo.CheckStatus();
-
         fbo.SetViewportDims();
         fbo.ClearColor();
-        fbo.ClearDepth();
         
         brdfLutProgram->Use();
         Component::Primitive::DrawQuad();
@@ -0,0 +1,54 @@
+#include "scene/lightregistry.hpp"
+
+#include "scene/scenenode.hpp"
+#include "component/light.hpp"
+
+#include <algorithm>
+
+namespace Scene {
+
+    void LightRegistry::Register(SceneNode& node) {
+        if (!node.GetComponent())
+            return;
+        // Component type is fixed at construction, so it can stand in for RTTI here
+        switch (node.GetComponent()->type) {
+            case Component::ComponentType::DirLight:
+                directionalLights.push_back({&node, static_cast<Component::DirectionalLight*>(node.GetComponent().get())});
+                generation++;
+                break;
+            case Component::ComponentType::PointLight:
+                pointLights.push_back({&node, static_cast<Component::PointLight*>(node.GetComponent().get())});
+                generation++;
+                break;
+            default:
+                break;
+        }
+    }
+
+    void LightRegistry::Unregister(SceneNode& node) {
+        if (!node.GetComponent())
+            return;
+        // Erase rather than swap-and-pop so shadow map indices, which follow registry order, stay stable
+        switch (node.GetComponent()->type) {
+            case Component::ComponentType::DirLight: {
+                auto it = std::find_if(directionalLights.begin(), directionalLights.end(), [&](const auto& entry){ return entry.node == &node; });
+                if (it != directionalLights.end()) {
+                    directionalLights.erase(it);
+                    generation++;
+                }
+                break;
+            }
+            case Component::ComponentType::PointLight: {
+                auto it = std::find_if(pointLights.begin(), pointLights.end(), [&](const auto& entry){ return entry.node == &node; });
+                if (it != pointLights.end()) {
+                    pointLights.erase(it);
+                    generation++;
+                }
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+}
\ No newline at end of file
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vector>
+
+namespace Component {
+    class DirectionalLight;
+    class PointLight;
+}
+
+namespace Scene {
+
+    class SceneNode;
+
+    // Contiguous, typed lists of the lights attached to a scene. Kept up to date by SceneNode as nodes are attached,
+    // detached, or have their component replaced, so the renderer never has to traverse the scene graph to find lights.
+    class LightRegistry {
+        public:
+            template<typename T>
+            struct Entry {
+                SceneNode* node;
+                T* light;
+            };
+            using DirectionalLightEntry = Entry<Component::DirectionalLight>;
+            using PointLightEntry = Entry<Component::PointLight>;
+
+            const std::vector<DirectionalLightEntry>& DirectionalLights() const { return directionalLights; }
+            const std::vector<PointLightEntry>& PointLights() const { return pointLights; }
+            // Incremented whenever a light is added or removed
+            unsigned int Generation() const { return generation; }
+
+            void Register(SceneNode& node);
+            void Unregister(SceneNode& node);
+
+        private:
+            std::vector<DirectionalLightEntry> directionalLights;
+            std::vector<PointLightEntry> pointLights;
+            unsigned int generation = 0;
+    };
+
+}
\ No newline at end of file
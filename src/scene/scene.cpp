@@ -1,7 +1,140 @@
 #include "scene/scene.hpp"
 
+#include "component/mesh.hpp"
+#include "component/model.hpp"
+
+#include <limits>
+
 namespace Scene {
 
-    // placeholder for Scene class
+    namespace {
+        // The transformed box grows by up to sqrt(3) under rotation, while the sphere does not, so for rounded or rotated
+        // meshes the sphere's box is the tighter bound. Their overlap is tighter than either.
+        Bounds::Aabb worldBounds(const Component::Mesh& mesh, const glm::mat4& world) {
+            const Bounds::Aabb box = mesh.BoundingBox().Transformed(world);
+            if (!box.IsValid())
+                return box;
+            return box.Clipped(mesh.BoundingSphere().Transformed(world).Box());
+        }
+    }
+
+    void Scene::UpdateWorldTransforms() {
+        if (hierarchyChanged) {
+            linearize();
+            hierarchyChanged = false;
+        }
+
+        frame++;
+        bool anyChanged = false;
+        for (size_t i = 0; i < nodes.size(); i++) {
+            Transform& transform = nodes[i]->transform;
+            const glm::mat4& local = transform.Matrix();   // Applies any pending update, which bumps the version
+            const int parent = parentIndices[i];
+            const bool changed = transform.Version() != localVersions[i] || (parent >= 0 && worldChanged[parent]);
+            worldChanged[i] = changed;
+            anyChanged |= changed;
+            if (changed) {
+                lastMoved[i] = frame;
+                localVersions[i] = transform.Version();
+                localMatrices[i] = local;
+                worldMatrices[i] = parent >= 0 ? worldMatrices[parent] * local : local;
+            }
+        }
+
+        updateDrawables(anyChanged);
+    }
+
+    void Scene::Draw() {
+        if (hierarchyChanged)   // Never walk a stale node list
+            UpdateWorldTransforms();
+        for (size_t i = 0; i < nodes.size(); i++) {
+            if (nodes[i]->GetComponent())
+                nodes[i]->GetComponent()->Draw(worldMatrices[i]);
+        }
+    }
+    void Scene::Draw(Material::MaterialBase& material) {
+        if (hierarchyChanged)   // Never walk a stale node list
+            UpdateWorldTransforms();
+        for (size_t i = 0; i < nodes.size(); i++) {
+            if (nodes[i]->GetComponent())
+                nodes[i]->GetComponent()->Draw(material, worldMatrices[i]);
+        }
+    }
+    void Scene::Draw(Renderer::RenderModule& module) {
+        if (hierarchyChanged)   // Never walk a stale node list
+            UpdateWorldTransforms();
+        for (size_t i = 0; i < nodes.size(); i++) {
+            if (nodes[i]->GetComponent())
+                nodes[i]->GetComponent()->Draw(module, worldMatrices[i]);
+        }
+    }
+
+    SceneNode* Scene::Pick(const glm::vec3& origin, const glm::vec3& direction) const {
+        const int hit = bvh.Raycast(origin, direction);
+        return hit >= 0 ? drawables[hit].node : nullptr;
+    }
+
+    void Scene::updateDrawables(bool moved) {
+        drawables.clear();
+        drawableBounds.Clear();
+        for (size_t i = 0; i < nodes.size(); i++) {
+            Component::ComponentBase* component = nodes[i]->GetComponent().get();
+            if (!component || !component->IsMesh())
+                continue;
+            const bool dynamic = frame - lastMoved[i] < settleFrames;
+            if (component->type == Component::ComponentType::Model) {
+                for (const auto& instance : static_cast<Component::Model*>(component)->MeshInstances(worldMatrices[i])) {
+                    drawables.push_back({instance.mesh.get(), nodes[i], instance.worldMatrix, dynamic});
+                    drawableBounds.PushBack(worldBounds(*instance.mesh, instance.worldMatrix));
+                }
+            } else {
+                Component::Mesh* mesh = static_cast<Component::Mesh*>(component);
+                drawables.push_back({mesh, nodes[i], worldMatrices[i], dynamic});
+                drawableBounds.PushBack(worldBounds(*mesh, worldMatrices[i]));
+            }
+        }
+
+        // Static drawables do not move, so comparing which drawables are static casters is enough to catch any change to them
+        staticCastersScratch.clear();
+        for (const auto& drawable : drawables)
+            staticCastersScratch.emplace_back(drawable.mesh, !drawable.dynamic && drawable.mesh->castShadows);
+        if (staticCastersScratch != staticCasters) {
+            staticCasters.swap(staticCastersScratch);
+            staticVersion++;
+        }
+
+        // Moving objects only need a refit. Models can also change their mesh count on their own (asset reload), hence the size check.
+        if (drawablesChanged || bvh.PrimitiveCount() != drawables.size()) {
+            bvh.Build(drawableBounds);
+            drawablesChanged = false;
+        } else if (moved) {
+            bvh.Refit(drawableBounds);
+        }
+    }
+
+    void Scene::linearize() {
+        nodes.clear();
+        parentIndices.clear();
+
+        // Iterative pre-order traversal; children are pushed in reverse so they are visited in order
+        std::vector<std::pair<SceneNode*, int>> stack = {{this, -1}};
+        while (!stack.empty()) {
+            auto [node, parent] = stack.back();
+            stack.pop_back();
+            node->sceneIndex = nodes.size();
+            nodes.push_back(node);
+            parentIndices.push_back(parent);
+            for (auto it = node->children.rbegin(); it != node->children.rend(); it++)
+                stack.emplace_back(it->get(), node->sceneIndex);
+        }
+
+        // Force a full recompute
+        localMatrices.resize(nodes.size());
+        worldMatrices.resize(nodes.size());
+        localVersions.assign(nodes.size(), std::numeric_limits<unsigned int>::max());
+        worldChanged.assign(nodes.size(), true);
+        lastMoved.resize(nodes.size());     // Set by the forced recompute
+        drawablesChanged = true;
+    }
 
 }
\ No newline at end of file
@@ -1,12 +1,80 @@
 #pragma once
 
+#include "scene/bvh.hpp"
+#include "scene/lightregistry.hpp"
 #include "scene/scenenode.hpp"
+#include "util/bounds.hpp"
+
+namespace Component {
+    class Mesh;
+}
 
 namespace Scene {
 
+    // A single mesh to draw, with everything a pass needs to cull and draw it
+    struct Drawable {
+        Component::Mesh* mesh;
+        SceneNode* node;
+        glm::mat4 worldMatrix;
+        bool dynamic;       // Moved within the last Scene::settleFrames updates
+    };
+
     class Scene : public SceneNode {
         public:
-            Scene() : SceneNode("Root") {}
+            Scene() : SceneNode("Root") { scene = this; }
+
+            const LightRegistry& Lights() const { return lights; }
+
+            // Brings every node's world matrix up to date, recomputing only nodes whose transform or ancestor changed.
+            // Call once per frame before any pass reads WorldMatrix() or draws the scene.
+            void UpdateWorldTransforms();
+
+            // Draw every component with its cached world matrix, in depth-first order
+            void Draw();
+            void Draw(Material::MaterialBase& material);
+            void Draw(Renderer::RenderModule& module);
+
+            // Every mesh in the scene (model meshes flattened), rebuilt by UpdateWorldTransforms()
+            const std::vector<Drawable>& Drawables() const { return drawables; }
+            // Worldspace bounds, parallel to Drawables()
+            const Bounds::AabbArray& DrawableBounds() const { return drawableBounds; }
+            // Hierarchy over DrawableBounds(); query results index into Drawables()
+            const Bvh& DrawableBvh() const { return bvh; }
+
+            // Drawables that have not moved for this many updates count as static
+            static constexpr unsigned int settleFrames = 30;
+            // Changes whenever the static shadow casters might have: one is added, removed, starts or stops casting, or starts
+            // moving (and so becomes dynamic). Caches of static casters are valid while it stays the same.
+            unsigned int StaticVersion() const { return staticVersion; }
+
+            // Node owning the nearest drawable whose bounds the ray hits, or nullptr
+            SceneNode* Pick(const glm::vec3& origin, const glm::vec3& direction) const;
+
+        private:
+            LightRegistry lights;
+
+            // Depth-first linearization of the hierarchy; parents always precede their children
+            bool hierarchyChanged = true;
+            std::vector<SceneNode*> nodes;
+            std::vector<int> parentIndices;
+            std::vector<glm::mat4> localMatrices;
+            std::vector<glm::mat4> worldMatrices;
+            std::vector<unsigned int> localVersions;
+            std::vector<char> worldChanged;     // Scratch, per update
+            std::vector<unsigned int> lastMoved;    // Update in which each node's world matrix last changed
+            unsigned int frame = 0;
+
+            std::vector<Drawable> drawables;
+            Bounds::AabbArray drawableBounds;
+            Bvh bvh;
+            bool drawablesChanged = true;       // Set when the set of drawables may have changed, so the hierarchy is rebuilt rather than refit
+            std::vector<std::pair<Component::Mesh*, bool>> staticCasters, staticCastersScratch;    // Per drawable: mesh, static and casting
+            unsigned int staticVersion = 0;
+
+            void linearize();
+            void updateDrawables(bool moved);
+
+            friend class SceneNode;
     };
 
 }
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "scene/scenenode.hpp"
 
+#include "scene/scene.hpp"
+
 #include "component/all.hpp"
 #include "interface/widget.hpp"
 
@@ -28,17 +30,55 @@ namespace Scene {
         // std::clog << "destroying SceneNode " << name << std::endl;
     }
 
+    void SceneNode::SetComponent(std::shared_ptr<Component::ComponentBase> comp) {
+        if (scene)
+            scene->lights.Unregister(*this);
+        component = std::move(comp);
+        if (scene) {
+            scene->lights.Register(*this);
+            scene->drawablesChanged = true;
+        }
+    }
+
     std::shared_ptr<SceneNode> SceneNode::AddChild(std::shared_ptr<SceneNode> node) {
         auto child = children.emplace_back(std::move(node));
         child->parent = this;
+        child->setScene(scene);
         return child;
     }
     
     void SceneNode::RemoveChild(std::shared_ptr<SceneNode> node) {
         auto it = std::find(children.begin(), children.end(), node);
+        if (it == children.end())
+            return;
+        (*it)->setScene(nullptr);
+        (*it)->parent = nullptr;
         children.erase(it);
     }
 
+    const glm::mat4& SceneNode::WorldMatrix() const {
+        if (!scene || sceneIndex < 0)
+            throw std::runtime_error("SceneNode " + name + " has no world transform; it is not attached to an updated scene!");
+        return scene->worldMatrices[sceneIndex];
+    }
+
+    void SceneNode::setScene(Scene* new_scene) {
+        if (scene == new_scene)
+            return;
+        if (scene) {
+            scene->lights.Unregister(*this);
+            scene->hierarchyChanged = true;
+        }
+        scene = new_scene;
+        sceneIndex = -1;
+        if (scene) {
+            scene->lights.Register(*this);
+            scene->hierarchyChanged = true;
+        }
+        for (auto& child : children)
+            child->setScene(new_scene);
+    }
+
     void SceneNode::Draw(const glm::mat4& parent_transform) {
         const glm::mat4 model_matrix = parent_transform * transform.Matrix();
         if (component)
@@ -156,7 +196,7 @@ namespace Scene {
                 if (showComponentCreationWidget) {
                     std::shared_ptr<Component::ComponentBase> comp;
                     if (componentCreationWidget.Display(&comp)) {
-                        component = comp;
+                        SetComponent(comp);
                         showComponentCreationWidget = false;
                     }
                 }
@@ -164,7 +204,7 @@ namespace Scene {
                 if (ImGui::TreeNodeEx(("[" + component->typeName + "]").c_str(), ImGuiTreeNodeFlags_Bullet | ImGuiTreeNodeFlags_DefaultOpen)) {
                     component->DisplayWidget();
                     if (ImGui::Button("Remove Component")) {
-                        component.reset();
+                        SetComponent(nullptr);
                     }
                     ImGui::TreePop();
                 }
@@ -9,6 +9,8 @@
 
 namespace Scene {
 
+    class Scene;
+
     class SceneNode {
         public:
             SceneNode();
@@ -19,20 +21,26 @@ namespace Scene {
                
             std::string name = "SceneNode";
             Transform transform;
-            std::shared_ptr<Component::ComponentBase> component;
             SceneNode* parent = nullptr;
             std::vector<std::shared_ptr<SceneNode>> children;
             bool bypassLighting = false;
             bool visible = true;
 
+            const std::shared_ptr<Component::ComponentBase>& GetComponent() const { return component; }
+            // Keeps the scene's light registry in sync, which is why the component cannot be assigned directly
+            void SetComponent(std::shared_ptr<Component::ComponentBase> comp);
             std::shared_ptr<SceneNode> AddChild(std::shared_ptr<SceneNode> node);
             template<typename... Args>
             std::shared_ptr<SceneNode> EmplaceChild(Args&& ...args) {
                 auto child = children.emplace_back(std::make_shared<SceneNode>(args...));
                 child->parent = this;
+                child->setScene(scene);
                 return child;
             }
             void RemoveChild(std::shared_ptr<SceneNode> node);
+
+            // Cached world transform, as of the owning scene's last UpdateWorldTransforms()
+            const glm::mat4& WorldMatrix() const;
             
             void Draw(const glm::mat4& parent_transform = glm::identity<glm::mat4>());
             void Draw(Material::MaterialBase& m, const glm::mat4& parent_transform = glm::identity<glm::mat4>());
@@ -44,6 +52,17 @@ namespace Scene {
             Interface::ComponentCreationWidget componentCreationWidget;
             bool editingName = false, linkScale = false, showComponentCreationWidget = false, activatedThisFrame = false;
             bool DisplayWidget();
+
+        protected:
+            Scene* scene = nullptr;     // Scene this node is attached to, if any
+            int sceneIndex = -1;        // Position in the scene's depth-first node order
+
+        private:
+            std::shared_ptr<Component::ComponentBase> component;
+
+            void setScene(Scene* new_scene);
+
+            friend class Scene;
     };
 
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "bounds.hpp"
 #include "color.hpp"
 #include "direction.hpp"
 #include "file.hpp"
@@ -0,0 +1,247 @@
+#include "util/bounds.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace Bounds {
+
+    // ======== Aabb ========
+
+    float Aabb::SurfaceArea() const {
+        if (!IsValid())
+            return 0.f;
+        const glm::vec3 d = max - min;
+        return 2.f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+
+    void Aabb::Expand(const glm::vec3& point) {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+    void Aabb::Expand(const Aabb& other) {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+
+    Aabb Aabb::Transformed(const glm::mat4& matrix) const {
+        if (!IsValid())
+            return *this;
+        // Arvo: transform the center, and project the extents onto each world axis
+        const glm::vec3 center = glm::vec3(matrix * glm::vec4(Center(), 1));
+        const glm::mat3 linear = glm::mat3(matrix);
+        const glm::mat3 absLinear(glm::abs(linear[0]), glm::abs(linear[1]), glm::abs(linear[2]));
+        const glm::vec3 extents = absLinear * Extents();
+        return Aabb{center - extents, center + extents};
+    }
+
+    Aabb Aabb::Clipped(const Aabb& other) const {
+        return Aabb{glm::max(min, other.min), glm::min(max, other.max)};
+    }
+
+    bool Aabb::Intersects(const Aabb& other) const {
+        return min.x <= other.max.x && max.x >= other.min.x
+            && min.y <= other.max.y && max.y >= other.min.y
+            && min.z <= other.max.z && max.z >= other.min.z;
+    }
+
+    bool Aabb::IntersectsRay(const glm::vec3& origin, const glm::vec3& inverse_direction, float t_max, float& t) const {
+        const glm::vec3 t0 = (min - origin) * inverse_direction;
+        const glm::vec3 t1 = (max - origin) * inverse_direction;
+        const glm::vec3 tNear = glm::min(t0, t1);
+        const glm::vec3 tFar = glm::max(t0, t1);
+        const float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.f));
+        const float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, t_max));
+        if (enter > exit)
+            return false;
+        t = enter;
+        return true;
+    }
+
+    Aabb Aabb::FromPoints(const float* data, int count, int stride_floats, int ncomps) {
+        Aabb result;
+        for (int i = 0; i < count; i++) {
+            const float* p = data + i * stride_floats;
+            result.Expand(glm::vec3(p[0], p[1], ncomps > 2 ? p[2] : 0.f));
+        }
+        return result;
+    }
+
+    // ======== Sphere ========
+
+    bool Sphere::Intersects(const Aabb& box) const {
+        const glm::vec3 d = center - glm::clamp(center, box.min, box.max);
+        return glm::dot(d, d) <= radius * radius;
+    }
+
+    Sphere Sphere::Transformed(const glm::mat4& matrix) const {
+        const float scale = std::max(std::max(glm::length(glm::vec3(matrix[0])), glm::length(glm::vec3(matrix[1]))), glm::length(glm::vec3(matrix[2])));
+        return Sphere{glm::vec3(matrix * glm::vec4(center, 1)), radius * scale};
+    }
+
+    Sphere Sphere::FromPoints(const float* data, int count, int stride_floats, int ncomps, const Aabb& bounds) {
+        Sphere result{bounds.Center(), 0.f};
+        float radius2 = 0.f;
+        for (int i = 0; i < count; i++) {
+            const float* p = data + i * stride_floats;
+            const glm::vec3 d = glm::vec3(p[0], p[1], ncomps > 2 ? p[2] : 0.f) - result.center;
+            radius2 = std::max(radius2, glm::dot(d, d));
+        }
+        result.radius = std::sqrt(radius2);
+        return result;
+    }
+
+    // ======== AabbArray ========
+
+    void AabbArray::Clear() {
+        centerX.clear(); centerY.clear(); centerZ.clear();
+        extentX.clear(); extentY.clear(); extentZ.clear();
+    }
+
+    void AabbArray::Reserve(size_t n) {
+        centerX.reserve(n); centerY.reserve(n); centerZ.reserve(n);
+        extentX.reserve(n); extentY.reserve(n); extentZ.reserve(n);
+    }
+
+    void AabbArray::PushBack(const Aabb& box) {
+        // Invalid (empty) boxes get a negative extent so they fail every test
+        const glm::vec3 center = box.IsValid() ? box.Center() : glm::vec3(0);
+        const glm::vec3 extents = box.IsValid() ? box.Extents() : glm::vec3(-std::numeric_limits<float>::max());
+        centerX.push_back(center.x); centerY.push_back(center.y); centerZ.push_back(center.z);
+        extentX.push_back(extents.x); extentY.push_back(extents.y); extentZ.push_back(extents.z);
+    }
+
+    Aabb AabbArray::At(size_t i) const {
+        const glm::vec3 center(centerX[i], centerY[i], centerZ[i]);
+        const glm::vec3 extents(extentX[i], extentY[i], extentZ[i]);
+        return Aabb{center - extents, center + extents};
+    }
+
+    // ======== Frustum ========
+
+    Frustum::Frustum(const glm::mat4& m) {
+        // Gribb-Hartmann: each plane is the last row of the matrix plus or minus one of the others
+        const glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+        const glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+        const glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+        const glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+        planes[0] = row3 + row0;    // Left
+        planes[1] = row3 - row0;    // Right
+        planes[2] = row3 + row1;    // Bottom
+        planes[3] = row3 - row1;    // Top
+        planes[4] = row3 + row2;    // Near
+        planes[5] = row3 - row2;    // Far
+        for (auto& plane : planes)
+            plane /= glm::length(glm::vec3(plane));
+    }
+
+    bool Frustum::Intersects(const Aabb& box) const {
+        if (!box.IsValid())
+            return false;
+        const glm::vec3 center = box.Center();
+        const glm::vec3 extents = box.Extents();
+        for (const auto& plane : planes) {
+            const float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+            const float radius = glm::dot(glm::abs(glm::vec3(plane)), extents);
+            if (distance + radius < 0.f)
+                return false;
+        }
+        return true;
+    }
+
+    bool Frustum::Contains(const Aabb& box) const {
+        if (!box.IsValid())
+            return false;
+        const glm::vec3 center = box.Center();
+        const glm::vec3 extents = box.Extents();
+        for (const auto& plane : planes) {
+            const float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+            const float radius = glm::dot(glm::abs(glm::vec3(plane)), extents);
+            if (distance - radius < 0.f)
+                return false;
+        }
+        return true;
+    }
+
+    void Frustum::Cull(const AabbArray& boxes, size_t first, size_t count, std::vector<unsigned int>& visible) const {
+        const size_t n = first + count;
+        size_t i = first;
+
+    #if defined(__ARM_NEON) || defined(__SSE2__)
+        // Four boxes at a time; a box is outside if it is fully behind any one plane
+        for (; i + 4 <= n; i += 4) {
+        #if defined(__ARM_NEON)
+            const float32x4_t cx = vld1q_f32(&boxes.centerX[i]), cy = vld1q_f32(&boxes.centerY[i]), cz = vld1q_f32(&boxes.centerZ[i]);
+            const float32x4_t ex = vld1q_f32(&boxes.extentX[i]), ey = vld1q_f32(&boxes.extentY[i]), ez = vld1q_f32(&boxes.extentZ[i]);
+            uint32x4_t outside = vdupq_n_u32(0);
+            for (const auto& p : planes) {
+                float32x4_t d = vdupq_n_f32(p.w);
+                d = vmlaq_f32(d, cx, vdupq_n_f32(p.x));
+                d = vmlaq_f32(d, cy, vdupq_n_f32(p.y));
+                d = vmlaq_f32(d, cz, vdupq_n_f32(p.z));
+                d = vmlaq_f32(d, ex, vdupq_n_f32(std::fabs(p.x)));
+                d = vmlaq_f32(d, ey, vdupq_n_f32(std::fabs(p.y)));
+                d = vmlaq_f32(d, ez, vdupq_n_f32(std::fabs(p.z)));
+                outside = vorrq_u32(outside, vcltq_f32(d, vdupq_n_f32(0.f)));
+            }
+            uint32_t mask[4];
+            vst1q_u32(mask, outside);
+            for (int j = 0; j < 4; j++) {
+                if (!mask[j])
+                    visible.push_back(i + j);
+            }
+        #else
+            const __m128 cx = _mm_loadu_ps(&boxes.centerX[i]), cy = _mm_loadu_ps(&boxes.centerY[i]), cz = _mm_loadu_ps(&boxes.centerZ[i]);
+            const __m128 ex = _mm_loadu_ps(&boxes.extentX[i]), ey = _mm_loadu_ps(&boxes.extentY[i]), ez = _mm_loadu_ps(&boxes.extentZ[i]);
+            __m128 outside = _mm_setzero_ps();
+            for (const auto& p : planes) {
+                __m128 d = _mm_set1_ps(p.w);
+                d = _mm_add_ps(d, _mm_mul_ps(cx, _mm_set1_ps(p.x)));
+                d = _mm_add_ps(d, _mm_mul_ps(cy, _mm_set1_ps(p.y)));
+                d = _mm_add_ps(d, _mm_mul_ps(cz, _mm_set1_ps(p.z)));
+                d = _mm_add_ps(d, _mm_mul_ps(ex, _mm_set1_ps(std::fabs(p.x))));
+                d = _mm_add_ps(d, _mm_mul_ps(ey, _mm_set1_ps(std::fabs(p.y))));
+                d = _mm_add_ps(d, _mm_mul_ps(ez, _mm_set1_ps(std::fabs(p.z))));
+                outside = _mm_or_ps(outside, _mm_cmplt_ps(d, _mm_setzero_ps()));
+            }
+            const int mask = _mm_movemask_ps(outside);
+            for (int j = 0; j < 4; j++) {
+                if (!(mask & (1 << j)))
+                    visible.push_back(i + j);
+            }
+        #endif
+        }
+    #endif
+
+        // Remainder (or everything, without SIMD support)
+        for (; i < n; i++) {
+            bool outside = false;
+            for (const auto& p : planes) {
+                const float d = p.w + p.x * boxes.centerX[i] + p.y * boxes.centerY[i] + p.z * boxes.centerZ[i]
+                    + std::fabs(p.x) * boxes.extentX[i] + std::fabs(p.y) * boxes.extentY[i] + std::fabs(p.z) * boxes.extentZ[i];
+                outside |= d < 0.f;
+            }
+            if (!outside)
+                visible.push_back(i);
+        }
+    }
+
+    void Cull(const Sphere& sphere, const AabbArray& boxes, size_t first, size_t count, std::vector<unsigned int>& visible) {
+        const float radius2 = sphere.radius * sphere.radius;
+        for (size_t i = first; i < first + count; i++) {
+            // Distance from sphere center to the box, per axis
+            const float dx = std::max(std::fabs(sphere.center.x - boxes.centerX[i]) - boxes.extentX[i], 0.f);
+            const float dy = std::max(std::fabs(sphere.center.y - boxes.centerY[i]) - boxes.extentY[i], 0.f);
+            const float dz = std::max(std::fabs(sphere.center.z - boxes.centerZ[i]) - boxes.extentZ[i], 0.f);
+            if (dx*dx + dy*dy + dz*dz <= radius2 && boxes.extentX[i] >= 0.f)
+                visible.push_back(i);
+        }
+    }
+
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace Bounds {
+
+    struct Aabb {
+        glm::vec3 min = glm::vec3(INFINITY);
+        glm::vec3 max = glm::vec3(-INFINITY);
+
+        bool IsValid() const { return min.x <= max.x && min.y <= max.y && min.z <= max.z; }
+        glm::vec3 Center() const { return 0.5f * (min + max); }
+        glm::vec3 Extents() const { return 0.5f * (max - min); }
+        float SurfaceArea() const;
+
+        void Expand(const glm::vec3& point);
+        void Expand(const Aabb& other);
+        // Bounds of this box after an affine transform
+        Aabb Transformed(const glm::mat4& matrix) const;
+        // Overlap of the two boxes; invalid if they are disjoint
+        Aabb Clipped(const Aabb& other) const;
+        bool Intersects(const Aabb& other) const;
+        // Slab test against a ray, given the reciprocal of its direction. On a hit within [0, t_max], writes the entry distance to t.
+        bool IntersectsRay(const glm::vec3& origin, const glm::vec3& inverse_direction, float t_max, float& t) const;
+
+        // Bounds of the first ncomps (2 or 3) floats of every stride_floats-long vertex
+        static Aabb FromPoints(const float* data, int count, int stride_floats, int ncomps = 3);
+    };
+
+    struct Sphere {
+        glm::vec3 center = glm::vec3(0);
+        float radius = 0.f;
+
+        bool Intersects(const Aabb& box) const;
+        // Bounds of this sphere after an affine transform, scaled by the largest axis scale
+        Sphere Transformed(const glm::mat4& matrix) const;
+        Aabb Box() const { return Aabb{center - glm::vec3(radius), center + glm::vec3(radius)}; }
+        // Tighter than the box's circumsphere when the points are not box-shaped
+        static Sphere FromPoints(const float* data, int count, int stride_floats, int ncomps, const Aabb& bounds);
+    };
+
+    // Boxes stored as structure-of-arrays (centers and extents) so batched culling tests can run four boxes per instruction
+    class AabbArray {
+        public:
+            size_t Size() const { return centerX.size(); }
+            void Clear();
+            void Reserve(size_t n);
+            void PushBack(const Aabb& box);
+            Aabb At(size_t i) const;
+
+            std::vector<float> centerX, centerY, centerZ;
+            std::vector<float> extentX, extentY, extentZ;
+    };
+
+    class Frustum {
+        public:
+            // Extracts the six clip planes of a view-projection (or lightspace) matrix
+            Frustum(const glm::mat4& view_projection);
+
+            const glm::vec4& Plane(int i) const { return planes[i]; }
+
+            bool Intersects(const Aabb& box) const;
+            // True if the box is entirely on the inner side of every plane
+            bool Contains(const Aabb& box) const;
+            // Appends the index of every box in [first, first + count) that is not fully outside any plane. Conservative: boxes
+            // near frustum corners may pass.
+            void Cull(const AabbArray& boxes, size_t first, size_t count, std::vector<unsigned int>& visible) const;
+
+        private:
+            glm::vec4 planes[6];    // xyz inward-facing normal, w distance
+    };
+
+    // Appends the index of every box in [first, first + count) that overlaps the sphere
+    void Cull(const Sphere& sphere, const AabbArray& boxes, size_t first, size_t count, std::vector<unsigned int>& visible);
+
+}
\ No newline at end of file
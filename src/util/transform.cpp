@@ -11,7 +11,7 @@ Transform::Transform(const glm::mat4& matrix)
     : matrix(matrix),
     position(matrix[3]),
     rotationQuat(matrix),
-    rotationEuler(glm::degrees(glm::eulerAngles(rotationQuat))),
+    rotationEuler(glm::degrees(glm::eulerAngles(glm::quat_cast(matrix)))),   // Initialized before rotationQuat, so not from it
     scale(ExtractScale(matrix))
 {
     updateFrontRightUp();
@@ -92,6 +92,8 @@ void Transform::Scale(float xscale, float yscale, float zscale) {
 }
 
 void Transform::Update() {
+    if (position != lastPosition || rotationQuat != lastRotationQuat || rotationEuler != lastRotationEuler || scale != lastScale)
+        version++;
     if (position != lastPosition) {
         matrix[3] = glm::vec4(position, 1);
         lastPosition = position;
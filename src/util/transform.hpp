@@ -22,6 +22,7 @@ class Transform {
         const glm::vec3& Right() const { return right; }
         const glm::vec3& Up() const { return up; }
         glm::vec3 EulerAngles() const { return glm::degrees(rotationEuler); }
+        unsigned int Version() const { return version; }   // Incremented whenever the matrix changes
         
         void Translate(const glm::vec3& translation);
         void Translate(float dx, float dy, float dz);
@@ -46,6 +47,7 @@ class Transform {
         glm::vec3 up = Direction::up;
         
         bool isUpdateRequired = false;
+        unsigned int version = 0;
         glm::vec3 lastPosition = glm::vec3(0,0,0);
         glm::vec3 lastRotationEuler = glm::vec3(0,0,0);
         glm::quat lastRotationQuat = glm::identity<glm::quat>();
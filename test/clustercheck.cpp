@@ -0,0 +1,81 @@
+#include "renderer/cluster.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Checks LightClusterGrid::Build() against BuildBruteForce() on random lights, for a few projections and grid sizes.
+// CPU only, so it runs headless: `make check`.
+
+namespace {
+
+    struct Case {
+        float fovDegrees, aspect, near, far;
+        int tilesX, tilesY, depthSlices;
+        int lightCount;
+    };
+
+    // Lights scattered around and beyond the frustum, some straddling the near and far planes
+    std::vector<Renderer::LightClusterGrid::LightSphere> randomLights(std::mt19937& rng, const Case& c) {
+        std::uniform_real_distribution<float> xy(-c.far * 0.5f, c.far * 0.5f);
+        std::uniform_real_distribution<float> z(-c.far * 1.1f, c.near * 2.f);
+        std::uniform_real_distribution<float> radius(0.05f, c.far * 0.2f);
+        std::vector<Renderer::LightClusterGrid::LightSphere> lights(c.lightCount);
+        for (auto& light : lights)
+            light = {glm::vec3(xy(rng), xy(rng), z(rng)), radius(rng)};
+        return lights;
+    }
+
+    bool equal(const Renderer::LightClusterGrid& a, const Renderer::LightClusterGrid& b) {
+        if (a.LightIndices() != b.LightIndices())
+            return false;
+        for (int i = 0; i < a.ClusterCount(); i++) {
+            if (a.Clusters()[i].offset != b.Clusters()[i].offset || a.Clusters()[i].count != b.Clusters()[i].count)
+                return false;
+        }
+        return true;
+    }
+
+}
+
+int main() {
+    const Case cases[] = {
+        {60.f, 16.f / 9.f, 0.1f, 100.f, 16, 9, 24, 256},
+        {90.f, 1.f, 0.5f, 500.f, 8, 8, 32, 1024},
+        {45.f, 3.f / 2.f, 0.01f, 50.f, 32, 18, 16, 64},
+        {75.f, 21.f / 9.f, 1.f, 1000.f, 24, 10, 48, 2048},
+    };
+    constexpr int trials = 8;
+
+    std::mt19937 rng(1234);
+    int failures = 0;
+    size_t assignments = 0;
+    for (const Case& c : cases) {
+        Renderer::LightClusterGrid clustered(c.tilesX, c.tilesY, c.depthSlices);
+        Renderer::LightClusterGrid bruteForce(c.tilesX, c.tilesY, c.depthSlices);
+        const glm::mat4 projection = glm::perspective(glm::radians(c.fovDegrees), c.aspect, c.near, c.far);
+        clustered.SetProjection(projection);
+        bruteForce.SetProjection(projection);
+        for (int trial = 0; trial < trials; trial++) {
+            const auto lights = randomLights(rng, c);
+            clustered.Build(lights);
+            bruteForce.BuildBruteForce(lights);
+            assignments += bruteForce.LightIndices().size();
+            if (!equal(clustered, bruteForce)) {
+                std::cerr << "Mismatch: " << c.tilesX << "x" << c.tilesY << "x" << c.depthSlices << " grid, fov " << c.fovDegrees
+                    << ", near " << c.near << ", far " << c.far << ", trial " << trial << ": " << clustered.LightIndices().size()
+                    << " assignments clustered, " << bruteForce.LightIndices().size() << " brute force" << std::endl;
+                failures++;
+            }
+        }
+    }
+
+    if (failures > 0) {
+        std::cerr << failures << " of " << std::size(cases) * trials << " cluster builds differ from brute force" << std::endl;
+        return 1;
+    }
+    std::clog << "All " << std::size(cases) * trials << " cluster builds match brute force (" << assignments << " light-cluster assignments)" << std::endl;
+    return 0;
+}
\ No newline at end of file